@@ -59,6 +59,7 @@
 EXTERN_CVAR (vid_fullscreen)
 EXTERN_CVAR (vid_defwidth)
 EXTERN_CVAR (vid_defheight)
+EXTERN_CVAR (vid_pipeline)
 
 
 // ****************************************************************************
@@ -996,6 +997,91 @@ ISDL20VideoCapabilities::ISDL20VideoCapabilities() :
 
 // ****************************************************************************
 
+// ============================================================================
+//
+// Presentation timing
+//
+// [Odamex] Keeps a short history of how long each frame took, how long the
+// main thread was blocked uploading and presenting it, and how long it took
+// from the start of the frame (when input is gathered) until it was presented.
+//
+// ============================================================================
+
+static const size_t NUM_PRESENT_SAMPLES = 128;
+
+struct presentsample_t
+{
+	uint64_t	frametime;
+	uint64_t	blocktime;
+	uint64_t	latency;
+};
+
+static presentsample_t present_samples[NUM_PRESENT_SAMPLES];
+static size_t present_sample_count = 0;
+static size_t present_sample_index = 0;
+static size_t present_latency_index = 0;
+static uint64_t last_present_finish = 0;
+
+//
+// I_AddPresentSample
+//
+// Records the time the main thread spent in finishRefresh for a frame.
+//
+static void I_AddPresentSample(uint64_t blockstart, uint64_t blockend)
+{
+	presentsample_t* sample = &present_samples[present_sample_index];
+	sample->frametime = last_present_finish ? blockend - last_present_finish : 0;
+	sample->blocktime = blockend - blockstart;
+	last_present_finish = blockend;
+
+	present_sample_index = (present_sample_index + 1) % NUM_PRESENT_SAMPLES;
+	present_sample_count = MIN(present_sample_count + 1, NUM_PRESENT_SAMPLES);
+}
+
+//
+// I_AddPresentLatency
+//
+// Records the time from the start of a frame until it was presented. With
+// pipelining this lags the other samples by the number of frames in flight.
+//
+static void I_AddPresentLatency(uint64_t starttime, uint64_t presenttime)
+{
+	present_samples[present_latency_index].latency = presenttime - starttime;
+	present_latency_index = (present_latency_index + 1) % NUM_PRESENT_SAMPLES;
+}
+
+static void I_PrintPresentTiming(const char* name, size_t offset)
+{
+	uint64_t total = 0, worst = 0;
+	for (size_t i = 0; i < present_sample_count; i++)
+	{
+		uint64_t value = *(const uint64_t*)((const uint8_t*)&present_samples[i] + offset);
+		total += value;
+		worst = MAX(worst, value);
+	}
+
+	Printf(PRINT_HIGH, "%-10s avg %7.3f ms  max %7.3f ms\n", name,
+			double(total) / double(present_sample_count) / 1e6, double(worst) / 1e6);
+}
+
+BEGIN_COMMAND(vid_presentstats)
+{
+	if (present_sample_count == 0)
+	{
+		Printf(PRINT_HIGH, "No frames have been presented yet.\n");
+		return;
+	}
+
+	Printf(PRINT_HIGH, "Last %u frames, %d buffered for presentation:\n",
+			(unsigned)present_sample_count, vid_pipeline.asInt());
+	I_PrintPresentTiming("frame", offsetof(presentsample_t, frametime));
+	I_PrintPresentTiming("present", offsetof(presentsample_t, blocktime));
+	I_PrintPresentTiming("latency", offsetof(presentsample_t, latency));
+}
+END_COMMAND(vid_presentstats)
+
+
+
 // ============================================================================
 //
 // ISDL20TextureWindowSurfaceManager implementation
@@ -1013,7 +1099,11 @@ ISDL20TextureWindowSurfaceManager::ISDL20TextureWindowSurfaceManager(
 		mWindow(window),
 		mSDLRenderer(NULL), mSDLTexture(NULL),
 		mSurface(NULL), m8bppTo32BppSurface(NULL),
-        mWidth(width), mHeight(height)
+        mWidth(width), mHeight(height),
+		mFrameHead(0), mFrameCount(0), mFramesInFlight(0),
+		mPresentThread(NULL), mPresentMutex(NULL), mPresentCond(NULL),
+		mPresentQuit(false),
+		mFrameStartTime(0)
 {
 	assert(mWindow != NULL);
     assert(mWindow->mSDLWindow != NULL);
@@ -1057,8 +1147,47 @@ ISDL20TextureWindowSurfaceManager::ISDL20TextureWindowSurfaceManager(
 		I_FatalError("I_InitVideo: unable to create SDL2 texture: %s\n", SDL_GetError());
 
 	mSurface = new IWindowSurface(width, height, &mFormat);
-    if (mSurface->getBitsPerPixel() ==8)
-        m8bppTo32BppSurface = new IWindowSurface(width, height, mWindow->getPixelFormat());
+	if (mSurface->getBitsPerPixel() == 8)
+	{
+		m8bppTo32BppSurface = new IWindowSurface(width, height, mWindow->getPixelFormat());
+	}
+
+	// [Odamex] Set up the textures for pipelined presentation. Each frame
+	// in flight needs its own texture, plus one for the frame being submitted.
+	mFramesInFlight = clamp(vid_pipeline.asInt(), 0, 2);
+	if (mFramesInFlight > 0)
+	{
+		mFrames.resize(mFramesInFlight + 1);
+		for (size_t i = 0; i < mFrames.size(); i++)
+		{
+			PresentFrame* frame = &mFrames[i];
+			frame->texture = SDL_CreateTexture(mSDLRenderer, sdl_mode.format, texture_flags, mWidth, mHeight);
+			frame->pixels = NULL;
+			frame->pitch = 0;
+			frame->snapshot = NULL;
+			frame->ready = false;
+			frame->starttime = 0;
+
+			if (frame->texture == NULL)
+			{
+				DPrintf("I_InitVideo: unable to create SDL2 texture for pipelining: %s\n", SDL_GetError());
+				mFramesInFlight = 0;
+				break;
+			}
+
+			if (mSurface->getBitsPerPixel() == 8)
+				frame->snapshot = new IWindowSurface(width, height, &mFormat);
+		}
+
+		// Converting 8bpp frames is done by the present thread. 32bpp frames
+		// are copied straight into the texture so they don't need it.
+		if (mFramesInFlight > 0 && mSurface->getBitsPerPixel() == 8 && I_ThreadsAvailable())
+		{
+			mPresentMutex = I_CreateMutex();
+			mPresentCond = I_CreateCondVar();
+			mPresentThread = I_CreateThread(PresentThreadFunc, this);
+		}
+	}
 }
 
 
@@ -1067,6 +1196,31 @@ ISDL20TextureWindowSurfaceManager::ISDL20TextureWindowSurfaceManager(
 //
 ISDL20TextureWindowSurfaceManager::~ISDL20TextureWindowSurfaceManager()
 {
+	if (mPresentThread)
+	{
+		{
+			OScopedLock lock(mPresentMutex);
+			mPresentQuit = true;
+			I_BroadcastCondVar(mPresentCond);
+		}
+		I_WaitThread(mPresentThread);
+	}
+
+	I_DestroyCondVar(mPresentCond);
+	I_DestroyMutex(mPresentMutex);
+
+	// frames still in flight are dropped
+	for (size_t i = 0; i < mFrames.size(); i++)
+	{
+		if (mFrames[i].texture)
+		{
+			if (mFrames[i].pixels)
+				SDL_UnlockTexture(mFrames[i].texture);
+			SDL_DestroyTexture(mFrames[i].texture);
+		}
+		delete mFrames[i].snapshot;
+	}
+
     delete m8bppTo32BppSurface;
 	delete mSurface;
 
@@ -1095,26 +1249,190 @@ void ISDL20TextureWindowSurfaceManager::unlockSurface()
 // ISDL20TextureWindowSurfaceManager::startRefresh
 //
 void ISDL20TextureWindowSurfaceManager::startRefresh()
-{ }
+{
+	mFrameStartTime = I_GetTime();
+}
 
 
 //
 // ISDL20TextureWindowSurfaceManager::finishRefresh
 //
+// [Odamex] When vid_pipeline is set, the finished frame is handed off and
+// the oldest frame in flight is presented instead, so the conversion of one
+// frame overlaps with waiting for the previous one to be presented (and the
+// rendering of the next).
+//
 void ISDL20TextureWindowSurfaceManager::finishRefresh()
 {
-    if (mSurface->getBitsPerPixel() == 8)
-    {
-        m8bppTo32BppSurface->blit(mSurface, 0, 0, mSurface->getWidth(), mSurface->getHeight(),
-                0, 0, m8bppTo32BppSurface->getWidth(), m8bppTo32BppSurface->getHeight());
-	    SDL_UpdateTexture(mSDLTexture, NULL, m8bppTo32BppSurface->getBuffer(), m8bppTo32BppSurface->getPitch());
-    }
-    else
-    {
-	   SDL_UpdateTexture(mSDLTexture, NULL, mSurface->getBuffer(), mSurface->getPitch());
-    }
+	if (mFramesInFlight > 0)
+	{
+		uint64_t blockstart = I_GetTime();
+
+		submitFrame();
+		while (mFrameCount > mFramesInFlight)
+			presentFrame();
+
+		I_AddPresentSample(blockstart, I_GetTime());
+		return;
+	}
+
+	uint64_t blockstart = I_GetTime();
+
+	if (mSurface->getBitsPerPixel() == 8)
+	{
+		m8bppTo32BppSurface->blit(mSurface, 0, 0, mSurface->getWidth(), mSurface->getHeight(),
+				0, 0, m8bppTo32BppSurface->getWidth(), m8bppTo32BppSurface->getHeight());
+		SDL_UpdateTexture(mSDLTexture, NULL, m8bppTo32BppSurface->getBuffer(), m8bppTo32BppSurface->getPitch());
+	}
+	else
+	{
+		SDL_UpdateTexture(mSDLTexture, NULL, mSurface->getBuffer(), mSurface->getPitch());
+	}
 	SDL_RenderCopy(mSDLRenderer, mSDLTexture, NULL, NULL);
 	SDL_RenderPresent(mSDLRenderer);
+
+	uint64_t presenttime = I_GetTime();
+	I_AddPresentSample(blockstart, presenttime);
+	I_AddPresentLatency(mFrameStartTime, presenttime);
+}
+
+
+//
+// ISDL20TextureWindowSurfaceManager::submitFrame
+//
+// Copies the primary surface into the next free frame's texture. 8bpp
+// surfaces are snapshotted along with their palette and queued for the
+// present thread to convert.
+//
+void ISDL20TextureWindowSurfaceManager::submitFrame()
+{
+	assert(mFrameCount < mFrames.size());
+	PresentFrame* frame = &mFrames[(mFrameHead + mFrameCount) % mFrames.size()];
+	mFrameCount++;
+
+	frame->starttime = mFrameStartTime;
+	frame->ready = false;
+
+	if (SDL_LockTexture(frame->texture, NULL, &frame->pixels, &frame->pitch) != 0)
+	{
+		frame->pixels = NULL;
+		frame->ready = true;
+		return;
+	}
+
+	const int bytes_per_row = mWidth * mSurface->getBytesPerPixel();
+
+	if (mSurface->getBitsPerPixel() == 8)
+	{
+		IWindowSurface* snapshot = frame->snapshot;
+		for (int y = 0; y < mHeight; y++)
+			memcpy(snapshot->getBuffer(0, y), mSurface->getBuffer(0, y), bytes_per_row);
+
+		const argb_t* palette = mSurface->getPalette();
+		if (palette)
+			memcpy(frame->palette, palette, sizeof(frame->palette));
+		snapshot->setPalette(palette ? frame->palette : NULL);
+
+		if (mPresentThread)
+		{
+			OScopedLock lock(mPresentMutex);
+			mConvertQueue.push_back(frame);
+			I_BroadcastCondVar(mPresentCond);
+			return;
+		}
+
+		convertFrame(frame);
+	}
+	else
+	{
+		for (int y = 0; y < mHeight; y++)
+			memcpy((uint8_t*)frame->pixels + y * frame->pitch, mSurface->getBuffer(0, y), bytes_per_row);
+	}
+
+	frame->ready = true;
+}
+
+
+//
+// ISDL20TextureWindowSurfaceManager::presentFrame
+//
+// Waits for the oldest frame in flight to be converted, then uploads and
+// presents it.
+//
+void ISDL20TextureWindowSurfaceManager::presentFrame()
+{
+	assert(mFrameCount > 0);
+	PresentFrame* frame = &mFrames[mFrameHead];
+
+	if (mPresentThread)
+	{
+		OScopedLock lock(mPresentMutex);
+		while (!frame->ready)
+			I_WaitCondVar(mPresentCond, mPresentMutex);
+	}
+
+	if (frame->pixels)
+	{
+		SDL_UnlockTexture(frame->texture);
+		frame->pixels = NULL;
+	}
+
+	SDL_RenderCopy(mSDLRenderer, frame->texture, NULL, NULL);
+	SDL_RenderPresent(mSDLRenderer);
+
+	I_AddPresentLatency(frame->starttime, I_GetTime());
+
+	mFrameHead = (mFrameHead + 1) % mFrames.size();
+	mFrameCount--;
+}
+
+
+//
+// ISDL20TextureWindowSurfaceManager::convertFrame
+//
+// Converts an 8bpp snapshot into the 32bpp pixels of its locked texture.
+// This only touches memory owned by the frame, so it is safe to call from
+// the present thread.
+//
+void ISDL20TextureWindowSurfaceManager::convertFrame(PresentFrame* frame)
+{
+	if (frame->pixels == NULL || frame->snapshot->getPalette() == NULL)
+		return;
+
+	IWindowSurface dest(mWidth, mHeight, mWindow->getPixelFormat(), frame->pixels, frame->pitch);
+	dest.blit(frame->snapshot, 0, 0, mWidth, mHeight, 0, 0, mWidth, mHeight);
+}
+
+
+//
+// ISDL20TextureWindowSurfaceManager::PresentThreadFunc
+//
+int ISDL20TextureWindowSurfaceManager::PresentThreadFunc(void* data)
+{
+	ISDL20TextureWindowSurfaceManager* manager = static_cast<ISDL20TextureWindowSurfaceManager*>(data);
+
+	I_LockMutex(manager->mPresentMutex);
+	while (true)
+	{
+		while (manager->mConvertQueue.empty() && !manager->mPresentQuit)
+			I_WaitCondVar(manager->mPresentCond, manager->mPresentMutex);
+
+		if (manager->mPresentQuit)
+			break;
+
+		PresentFrame* frame = manager->mConvertQueue.front();
+		manager->mConvertQueue.erase(manager->mConvertQueue.begin());
+
+		I_UnlockMutex(manager->mPresentMutex);
+		manager->convertFrame(frame);
+		I_LockMutex(manager->mPresentMutex);
+
+		frame->ready = true;
+		I_BroadcastCondVar(manager->mPresentCond);
+	}
+	I_UnlockMutex(manager->mPresentMutex);
+
+	return 0;
 }
 
 
@@ -1344,6 +1662,8 @@ void ISDL20Window::getEvents()
 void ISDL20Window::startRefresh()
 {
 	getEvents();
+
+	mSurfaceManager->startRefresh();
 }
 
 
@@ -27,6 +27,7 @@
 
 #include "i_sdl.h"
 #include "i_video.h"
+#include "i_thread.h"
 
 #ifdef SDL12
 // ============================================================================
@@ -333,6 +334,30 @@ public:
 	virtual void finishRefresh();
 
 private:
+	// [Odamex] A frame waiting to be presented when pipelining is enabled.
+	// The primary surface is copied into its locked streaming texture (via
+	// an 8bpp snapshot that is converted on the present thread) and it is
+	// presented once later frames have been submitted.
+	struct PresentFrame
+	{
+		SDL_Texture*		texture;
+		void*				pixels;
+		int					pitch;
+
+		IWindowSurface*		snapshot;
+		argb_t				palette[256];
+
+		bool				ready;
+
+		uint64_t			starttime;
+	};
+
+	void submitFrame();
+	void presentFrame();
+	void convertFrame(PresentFrame* frame);
+
+	static int PresentThreadFunc(void* data);
+
 	ISDL20Window*			mWindow;
 	SDL_Renderer*			mSDLRenderer;
 	SDL_Texture*			mSDLTexture;
@@ -344,6 +369,20 @@ private:
 	uint16_t				mHeight;
 
 	PixelFormat				mFormat;
+
+	// pipelined presentation
+	std::vector<PresentFrame>	mFrames;
+	size_t					mFrameHead;
+	size_t					mFrameCount;
+	size_t					mFramesInFlight;
+
+	thread_t*				mPresentThread;
+	mutex_t*				mPresentMutex;
+	condvar_t*				mPresentCond;
+	std::vector<PresentFrame*>	mConvertQueue;
+	bool					mPresentQuit;
+
+	uint64_t				mFrameStartTime;
 };
 
 
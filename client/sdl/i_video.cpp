@@ -40,6 +40,7 @@
 #include "m_fileio.h"
 
 #include "w_wad.h"
+#include "r_draw.h"
 
 // [Russell] - Just for windows, display the icon in the system menu and
 // alt-tab display
@@ -216,28 +217,62 @@ inline argb_t ConvertPixel(argb_t value, const argb_t* palette)
 {	return value;	}
 
 
+//
+// Converts or copies a single row for BlitLoop. The 32bpp destinations use
+// the vectorized row functions chosen by r_optimize.
+//
+template <typename SOURCE_PIXEL_T, typename DEST_PIXEL_T>
+static inline void BlitRow(DEST_PIXEL_T* dest, const SOURCE_PIXEL_T* source, int destw,
+					fixed_t xstep, const argb_t* palette)
+{
+	if (sizeof(DEST_PIXEL_T) == sizeof(SOURCE_PIXEL_T) && xstep == FRACUNIT)
+	{
+		memcpy(dest, source, destw * sizeof(SOURCE_PIXEL_T));
+	}
+	else
+	{
+		fixed_t xfrac = 0;
+		for (int x = 0; x < destw; x++)
+		{
+			dest[x] = ConvertPixel<SOURCE_PIXEL_T, DEST_PIXEL_T>(source[xfrac >> FRACBITS], palette);
+			xfrac += xstep;
+		}
+	}
+}
+
+template <>
+inline void BlitRow(argb_t* dest, const palindex_t* source, int destw,
+					fixed_t xstep, const argb_t* palette)
+{
+	r_blitrowPD(dest, source, palette, destw, xstep);
+}
+
+template <>
+inline void BlitRow(argb_t* dest, const argb_t* source, int destw,
+					fixed_t xstep, const argb_t* palette)
+{
+	r_blitrowDD(dest, source, destw, xstep);
+}
+
+
 template <typename SOURCE_PIXEL_T, typename DEST_PIXEL_T>
 static void BlitLoop(DEST_PIXEL_T* dest, const SOURCE_PIXEL_T* source,
 					int destpitchpixels, int srcpitchpixels, int destw, int desth,
 					fixed_t xstep, fixed_t ystep, const argb_t* palette)
 {
+	// [Odamex] when stretching vertically, rows that repeat the previous
+	// source row are copied from the previous destination row
+	const SOURCE_PIXEL_T* lastsource = NULL;
+
 	fixed_t yfrac = 0;
 	for (int y = 0; y < desth; y++)
 	{
-		if (sizeof(DEST_PIXEL_T) == sizeof(SOURCE_PIXEL_T) && xstep == FRACUNIT)
-		{
-			memcpy(dest, source, destw * sizeof(SOURCE_PIXEL_T));
-		}
+		if (source == lastsource)
+			memcpy(dest, dest - destpitchpixels, destw * sizeof(DEST_PIXEL_T));
 		else
-		{
-			fixed_t xfrac = 0;
-			for (int x = 0; x < destw; x++)
-			{
-				dest[x] = ConvertPixel<SOURCE_PIXEL_T, DEST_PIXEL_T>(source[xfrac >> FRACBITS], palette);
-				xfrac += xstep;
-			}
-		}
+			BlitRow(dest, source, destw, xstep, palette);
 
+		lastsource = source;
 		dest += destpitchpixels;
 		yfrac += ystep;
 
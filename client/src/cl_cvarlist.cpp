@@ -367,6 +367,9 @@ CVAR(				cl_autoscreenshot, "0", "Automatically capture a screenshot at the end
 CVAR(				cl_splitnetdemos, "0", "Create separate netdemos for each map",
 					CVARTYPE_BOOL, CVAR_CLIENTARCHIVE)
 
+CVAR(				cl_netdemosnapshotspacing, "20", "Number of seconds between snapshots in recorded netdemos",
+					CVARTYPE_WORD, CVAR_CLIENTARCHIVE | CVAR_NOENABLEDISABLE)
+
 // Mouse settings
 // --------------
 
@@ -575,6 +578,12 @@ CVAR(			r_flashhom, "0", "Draws flashing colors where there is HOM",
 CVAR(			r_drawflat, "0", "Disables all texturing of walls, floors and ceilings",
 				CVARTYPE_BOOL, CVAR_NULL)
 
+CVAR(			r_batchcolumns, "0", "Draws adjacent wall and sprite columns four at a time",
+				CVARTYPE_BOOL, CVAR_CLIENTARCHIVE)
+
+CVAR_RANGE_FUNC_DECL(r_drawthreads, "1", "Number of threads used to draw the view (0 - one per CPU)",
+				CVARTYPE_BYTE, CVAR_CLIENTARCHIVE | CVAR_NOENABLEDISABLE, 0.0f, 32.0f)
+
 #if 0
 CVAR(			r_drawhitboxes, "0", "Draws a box outlining every actor's hitboxes",
 				CVARTYPE_BOOL, CVAR_NULL)
@@ -648,6 +657,9 @@ CVAR_FUNC_DECL(	vid_maxfps, "35", "Maximum framerate (0 indicates unlimited fram
 CVAR_FUNC_DECL(	vid_vsync, "0", "Enable/Disable vertical refresh sync (vsync)",
 				CVARTYPE_BOOL, CVAR_CLIENTARCHIVE)
 
+CVAR_FUNC_DECL(	vid_pipeline, "0", "Number of frames to buffer while presenting (0 presents each frame immediately)",
+				CVARTYPE_BYTE, CVAR_CLIENTARCHIVE | CVAR_NOENABLEDISABLE)
+
 #ifdef GCONSOLE
 CVAR_FUNC_DECL(	vid_fullscreen, "1", "Full screen video mode",
 				CVARTYPE_BOOL, CVAR_CLIENTARCHIVE)
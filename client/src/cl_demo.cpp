@@ -38,9 +38,12 @@
 #include "st_stuff.h"
 #include "p_mobj.h"
 #include "g_level.h"
+#include "i_thread.h"
+#include "minilzo.h"
 
 EXTERN_CVAR(sv_maxclients)
 EXTERN_CVAR(sv_maxplayers)
+EXTERN_CVAR(cl_netdemosnapshotspacing)
 
 extern std::string server_host;
 extern std::string digest;
@@ -51,7 +54,7 @@ argb_t CL_GetPlayerColor(player_t*);
 
 NetDemo::NetDemo() :
 	state(st_stopped), oldstate(st_stopped), filename(""),
-	demofp(NULL)
+	demofp(NULL), blockpos(0), blocktic(0), nextblockoffset(0), prefetch(NULL)
 {
     memset(&header, 0, sizeof(header));
 }
@@ -79,6 +82,12 @@ void NetDemo::copy(NetDemo &to, const NetDemo &from)
 	to.captured			= from.captured;
 	to.snapshot_index	= from.snapshot_index;
 	to.map_index		= from.map_index;
+	to.block_index		= from.block_index;
+	to.blockbuf			= from.blockbuf;
+	to.blockpos			= from.blockpos;
+	to.blocktic			= from.blocktic;
+	to.nextblockoffset	= from.nextblockoffset;
+	to.prefetch			= NULL;
 	memcpy(&to.header, &from.header, sizeof(header));
 }
 
@@ -117,6 +126,8 @@ void NetDemo::cleanUp()
 		stopRecording();	// Try to write any unwritten data
 	}
 	
+	stopPrefetch();
+
 	// close all files
 	if (demofp)
 	{
@@ -126,6 +137,9 @@ void NetDemo::cleanUp()
 	
 	snapshot_index.clear();
 	map_index.clear();
+	block_index.clear();
+	blockbuf.clear();
+	blockpos = 0;
 	state = oldstate = NetDemo::st_stopped;
 }
 
@@ -170,50 +184,9 @@ bool NetDemo::writeHeader()
 {
 	strncpy(header.identifier, "ODAD", 4);
 	header.version = NETDEMOVER;
-	header.compression = 0;
-	header.snapshot_spacing = NetDemo::SNAPSHOT_SPACING;
-
-	netdemo_header_t tmpheader;
-	memcpy(&tmpheader, &header, sizeof(header));
-
-	// convert from native byte ordering to little-endian
-	tmpheader.snapshot_index_size	= LESHORT(tmpheader.snapshot_index_size);
-	tmpheader.snapshot_index_offset	= LELONG(tmpheader.snapshot_index_offset);
-	tmpheader.map_index_size		= LESHORT(tmpheader.map_index_size);
-	tmpheader.map_index_offset		= LELONG(tmpheader.map_index_offset);
-	tmpheader.snapshot_spacing		= LESHORT(tmpheader.snapshot_spacing);
-	tmpheader.starting_gametic		= LELONG(tmpheader.starting_gametic);
-	tmpheader.ending_gametic		= LELONG(tmpheader.ending_gametic);
-	
-	fseek(demofp, 0, SEEK_SET);
-	size_t cnt = 0;
-	cnt += sizeof(tmpheader.identifier) *
-		fwrite(&tmpheader.identifier, sizeof(tmpheader.identifier), 1, demofp);
-	cnt += sizeof(tmpheader.version) *
-		fwrite(&tmpheader.version, sizeof(tmpheader.version), 1, demofp);
-	cnt += sizeof(tmpheader.compression) *
-		fwrite(&tmpheader.compression, sizeof(tmpheader.compression), 1, demofp);
-	cnt += sizeof(tmpheader.snapshot_index_size) *
-		fwrite(&tmpheader.snapshot_index_size, sizeof(tmpheader.snapshot_index_size), 1, demofp);
-	cnt += sizeof(tmpheader.snapshot_index_offset)*
-		fwrite(&tmpheader.snapshot_index_offset, sizeof(tmpheader.snapshot_index_offset), 1, demofp);
-	cnt += sizeof(tmpheader.map_index_size) *
-		fwrite(&tmpheader.map_index_size, sizeof(tmpheader.map_index_size), 1, demofp);
-	cnt += sizeof(tmpheader.map_index_offset)*
-		fwrite(&tmpheader.map_index_offset, sizeof(tmpheader.map_index_offset), 1, demofp);
-	cnt += sizeof(tmpheader.snapshot_spacing) *
-		fwrite(&tmpheader.snapshot_spacing, sizeof(tmpheader.snapshot_spacing), 1, demofp);
-	cnt += sizeof(tmpheader.starting_gametic) *
-		fwrite(&tmpheader.starting_gametic, sizeof(tmpheader.starting_gametic), 1, demofp);
-	cnt += sizeof(tmpheader.ending_gametic) *
-		fwrite(&tmpheader.ending_gametic, sizeof(tmpheader.ending_gametic), 1, demofp);
-	cnt += sizeof(tmpheader.reserved) *
-		fwrite(&tmpheader.reserved, sizeof(tmpheader.reserved), 1, demofp);
-	
-	if (cnt < NetDemo::HEADER_SIZE)
-		return false;
+	header.compression = NETDEMO_COMP_LZO_BLOCKS;
 
-	return true;
+	return D_WriteNetDemoHeader(demofp, header);
 }
 
 
@@ -226,168 +199,66 @@ bool NetDemo::writeHeader()
 
 bool NetDemo::readHeader()
 {
-	fseek(demofp, 0, SEEK_SET);
-	
-	size_t cnt = 0;
-	cnt += sizeof(header.identifier) *
-		fread(&header.identifier, sizeof(header.identifier), 1, demofp);
-	cnt += sizeof(header.version) *
-		fread(&header.version, sizeof(header.version), 1, demofp);
-	cnt += sizeof(header.compression) *
-		fread(&header.compression, sizeof(header.compression), 1, demofp);
-	cnt += sizeof(header.snapshot_index_size) *
-		fread(&header.snapshot_index_size, sizeof(header.snapshot_index_size), 1, demofp);
-	cnt += sizeof(header.snapshot_index_offset)*
-		fread(&header.snapshot_index_offset, sizeof(header.snapshot_index_offset), 1, demofp);
-	cnt += sizeof(header.map_index_size) *
-		fread(&header.map_index_size, sizeof(header.map_index_size), 1, demofp);
-	cnt += sizeof(header.map_index_offset)*
-		fread(&header.map_index_offset, sizeof(header.map_index_offset), 1, demofp);
-	cnt += sizeof(header.snapshot_spacing) *
-		fread(&header.snapshot_spacing, sizeof(header.snapshot_spacing), 1, demofp);
-	cnt += sizeof(header.starting_gametic) *
-		fread(&header.starting_gametic, sizeof(header.starting_gametic), 1, demofp);
-	cnt += sizeof(header.ending_gametic) *
-		fread(&header.ending_gametic, sizeof(header.ending_gametic), 1, demofp);
-	cnt += sizeof(header.reserved) *
-		fread(&header.reserved, sizeof(header.reserved), 1, demofp);
-	
-	if (cnt < NetDemo::HEADER_SIZE)
-		return false;
-
-	// convert from little-endian to native byte ordering
-	header.snapshot_index_size 		= LESHORT(header.snapshot_index_size);
-	header.snapshot_index_offset 	= LELONG(header.snapshot_index_offset);
-	header.map_index_size 			= LESHORT(header.map_index_size);
-	header.map_index_offset 		= LELONG(header.map_index_offset);
-	header.snapshot_spacing 		= LESHORT(header.snapshot_spacing);
-	header.starting_gametic 		= LELONG(header.starting_gametic);
-	header.ending_gametic			= LELONG(header.ending_gametic);
-	
-	return true;
+	return D_ReadNetDemoHeader(demofp, header);
 }
 
 
 //
-// writeSnapshotIndex()
+// writeIndex()
 //
-//   Writes the snapshot index to the netdemo file, converting it to
+//   Writes an index to the netdemo file at the given offset, converting it to
 //   little-endian format from whatever the client's architecture uses.  Assumes
 //   that demofp has been opened correctly elsewhere.  Does not close the file.
 
-bool NetDemo::writeSnapshotIndex()
+bool NetDemo::writeIndex(const std::vector<netdemo_index_entry_t> &index, uint32_t offset)
 {
-	fseek(demofp, header.snapshot_index_offset, SEEK_SET);
-
-
-
-	for (size_t i = 0; i < snapshot_index.size(); i++)
-	{
-		netdemo_index_entry_t entry;
-		// convert to little-endian
-		entry.ticnum = LELONG(snapshot_index[i].ticnum);
-		entry.offset = LELONG(snapshot_index[i].offset);
-		
-		size_t cnt = 0;
-		cnt += sizeof(entry.ticnum) *
-			fwrite(&entry.ticnum, sizeof(entry.ticnum), 1, demofp);
-		cnt += sizeof(entry.offset) *
-			fwrite(&entry.offset, sizeof(entry.offset), 1, demofp);
-		
-		if (cnt < NetDemo::INDEX_ENTRY_SIZE)
-			return false;
-	}
-
-	return true;
+	return D_WriteNetDemoIndex(demofp, index, offset);
 }
 
 
 //
-// readSnapshotIndex()
+// readIndex()
 //
-//   Reads the snapshot index from the netdemo file, converting it from
-//   little-endian format to whatever the client's architecture uses.  Assumes
-//   that demofp has been opened correctly elsewhere.  Does not close the file.
+//   Reads an index of size entries from the netdemo file at the given offset,
+//   converting it from little-endian format to whatever the client's
+//   architecture uses.  Assumes that demofp has been opened correctly
+//   elsewhere.  Does not close the file.
 
-bool NetDemo::readSnapshotIndex()
+bool NetDemo::readIndex(std::vector<netdemo_index_entry_t> &index, uint32_t offset, size_t size)
 {
-	fseek(demofp, header.snapshot_index_offset, SEEK_SET);
-
-	for (int i = 0; i < header.snapshot_index_size; i++)
-	{
-		netdemo_index_entry_t entry;
-		
-		size_t cnt = 0;
-		cnt += sizeof(entry.ticnum) *
-			fread(&entry.ticnum, sizeof(entry.ticnum), 1, demofp);
-		cnt += sizeof(entry.offset) *
-			fread(&entry.offset, sizeof(entry.offset), 1, demofp);
-		
-		if (cnt < INDEX_ENTRY_SIZE)
-			return false;
-
-		// convert from little-endian to native
-		entry.ticnum = LELONG(entry.ticnum);	
-		entry.offset = LELONG(entry.offset);
+	return D_ReadNetDemoIndex(demofp, index, offset, size);
+}
 
-		snapshot_index.push_back(entry);
-	}
 
-	return true;
+bool NetDemo::writeSnapshotIndex()
+{
+	return writeIndex(snapshot_index, header.snapshot_index_offset);
 }
 
+bool NetDemo::readSnapshotIndex()
+{
+	return readIndex(snapshot_index, header.snapshot_index_offset, header.snapshot_index_size);
+}
 
 bool NetDemo::writeMapIndex()
 {
-	fseek(demofp, header.map_index_offset, SEEK_SET);
-
-	for (size_t i = 0; i < map_index.size(); i++)
-	{
-		netdemo_index_entry_t entry;
-		// convert to little-endian
-		entry.ticnum = LELONG(map_index[i].ticnum);
-		entry.offset = LELONG(map_index[i].offset);
-		
-		size_t cnt = 0;
-		cnt += sizeof(entry.ticnum) *
-			fwrite(&entry.ticnum, sizeof(entry.ticnum), 1, demofp);
-		cnt += sizeof(entry.offset) *
-			fwrite(&entry.offset, sizeof(entry.offset), 1, demofp);
-		
-		if (cnt < NetDemo::INDEX_ENTRY_SIZE)
-			return false;
-	}
-
-	return true;
+	return writeIndex(map_index, header.map_index_offset);
 }
 
 bool NetDemo::readMapIndex()
 {
-	fseek(demofp, header.map_index_offset, SEEK_SET);
-
-	for (int i = 0; i < header.map_index_size; i++)
-	{
-		netdemo_index_entry_t entry;
-		
-		size_t cnt = 0;
-		cnt += sizeof(entry.ticnum) *
-			fread(&entry.ticnum, sizeof(entry.ticnum), 1, demofp);
-		cnt += sizeof(entry.offset) *
-			fread(&entry.offset, sizeof(entry.offset), 1, demofp);
-		
-		if (cnt < INDEX_ENTRY_SIZE)
-			return false;
-
-		// convert from little-endian to native
-		entry.ticnum = LELONG(entry.ticnum);	
-		entry.offset = LELONG(entry.offset);
-
-		map_index.push_back(entry);
-	}
+	return readIndex(map_index, header.map_index_offset, header.map_index_size);
+}
 
-	return true;
+bool NetDemo::writeBlockIndex()
+{
+	return writeIndex(block_index, header.block_index_offset);
 }
 
+bool NetDemo::readBlockIndex()
+{
+	return readIndex(block_index, header.block_index_offset, header.block_index_size);
+}
 
 
 //
@@ -426,6 +297,11 @@ bool NetDemo::startRecording(const std::string &filename)
 	}
 
 	memset(&header, 0, sizeof(header));
+	header.snapshot_spacing = clamp(cl_netdemosnapshotspacing.asInt() * TICRATE, TICRATE, 0xFFFF);
+
+	blockbuf.clear();
+	blockpos = 0;
+
 	// Note: The header is not finalized at this point.  Write it anyway to
 	// reserve space in the output file for it and overwrite it later.
 	if (!writeHeader())
@@ -510,18 +386,14 @@ bool NetDemo::startPlaying(const std::string &filename)
 		return false;
 	}
 
-    if (header.version != NETDEMOVER)
-    {
-        // Do nothing since there is only one version of netdemo files currently
-    }
-
-	// read the demo's index
-	if (fseek(demofp, header.snapshot_index_offset, SEEK_SET) != 0)
+	// Version 3 netdemos are identical to version 4 without compression
+	if (header.compression != NETDEMO_COMP_NONE && header.compression != NETDEMO_COMP_LZO_BLOCKS)
 	{
-		error("Unable to find netdemo snapshot index.\n");
+		error("Unsupported netdemo compression.");
 		return false;
 	}
 
+	// read the demo's index
 	if (!readSnapshotIndex())
 	{
 		error("Unable to read netdemo snapshot index.\n");
@@ -529,12 +401,6 @@ bool NetDemo::startPlaying(const std::string &filename)
 	}
 
 	// read the demo's map index
-	if (fseek(demofp, header.map_index_offset, SEEK_SET) != 0)
-	{
-		error("Unable to find netdemo map index.\n");
-		return false;
-	}
-
 	if (!readMapIndex())
 	{
 		error("Unable to read netdemo map index.\n");
@@ -542,7 +408,27 @@ bool NetDemo::startPlaying(const std::string &filename)
 	}
 
 	// get set up to read server cmds
-	fseek(demofp, NetDemo::HEADER_SIZE, SEEK_SET);
+	if (isCompressed())
+	{
+		if (!readBlockIndex())
+		{
+			error("Unable to read netdemo block index.\n");
+			return false;
+		}
+
+		startPrefetch();
+
+		if (!loadBlock(NETDEMO_HEADER_SIZE))
+		{
+			error("Unable to read netdemo block.\n");
+			return false;
+		}
+	}
+	else
+	{
+		fseek(demofp, NETDEMO_HEADER_SIZE, SEEK_SET);
+	}
+
 	state = NetDemo::st_playing;
 
 	Printf(PRINT_HIGH, "Playing netdemo %s.\n", filename.c_str());
@@ -551,6 +437,159 @@ bool NetDemo::startPlaying(const std::string &filename)
 }
 
 
+//
+// convert()
+//
+//   Rewrites an uncompressed netdemo as a compressed netdemo. Each snapshot
+//   starts a new block and the snapshot and map indices are updated to point
+//   at those blocks.
+//
+
+bool NetDemo::convert(const std::string &infilename, const std::string &outfilename)
+{
+	if (state != NetDemo::st_stopped)
+	{
+		error("Cannot convert a netdemo while playing or recording.");
+		return false;
+	}
+
+	reset();
+	filename = outfilename;
+
+	if (!(demofp = fopen(infilename.c_str(), "rb")))
+	{
+		error("Unable to open netdemo file " + infilename + ".");
+		return false;
+	}
+
+	if (!readHeader() || !readSnapshotIndex() || !readMapIndex())
+	{
+		error("Unable to read netdemo " + infilename + ".");
+		return false;
+	}
+
+	if (header.compression != NETDEMO_COMP_NONE)
+	{
+		error("Netdemo " + infilename + " is already compressed.");
+		return false;
+	}
+
+	FILE *infp = demofp;
+	demofp = fopen(outfilename.c_str(), "wb");
+	if (!demofp)
+	{
+		fclose(infp);
+		error("Unable to create netdemo file " + outfilename + ".");
+		return false;
+	}
+
+	// the input's messages end where its indices begin
+	uint32_t endoffset = header.snapshot_index_offset;
+
+	// reserve space for the header; it is rewritten once the indices are known
+	if (!writeHeader())
+	{
+		fclose(infp);
+		error("Unable to write netdemo header.");
+		return false;
+	}
+
+	std::vector<byte> msgdata;
+	uint32_t offset = NETDEMO_HEADER_SIZE;
+	fseek(infp, offset, SEEK_SET);
+
+	size_t snapnum = 0, mapnum = 0;
+	bool ok = true;
+
+	while (ok && offset + NETDEMO_MESSAGE_HEADER_SIZE <= endoffset)
+	{
+		byte msgheader[NETDEMO_MESSAGE_HEADER_SIZE];
+		if (fread(msgheader, 1, sizeof(msgheader), infp) < sizeof(msgheader))
+		{
+			ok = false;
+			break;
+		}
+
+		uint32_t len, tic;
+		memcpy(&len, msgheader + 1, sizeof(len));
+		memcpy(&tic, msgheader + 5, sizeof(tic));
+		len = LELONG(len);
+		tic = LELONG(tic);
+
+		if (offset + sizeof(msgheader) + len > endoffset)
+		{
+			ok = false;
+			break;
+		}
+
+		// snapshots start a new block
+		bool snapshot = (snapnum < snapshot_index.size() && snapshot_index[snapnum].offset == offset) ||
+						(mapnum < map_index.size() && map_index[mapnum].offset == offset);
+		if (snapshot)
+		{
+			ok = flushBlock();
+			fflush(demofp);
+			uint32_t newoffset = ftell(demofp);
+
+			while (snapnum < snapshot_index.size() && snapshot_index[snapnum].offset == offset)
+				snapshot_index[snapnum++].offset = newoffset;
+			while (mapnum < map_index.size() && map_index[mapnum].offset == offset)
+				map_index[mapnum++].offset = newoffset;
+		}
+
+		msgdata.resize(len);
+		if (len > 0 && fread(&msgdata[0], 1, len, infp) < len)
+		{
+			ok = false;
+			break;
+		}
+
+		ok = ok && writeData(msgheader, sizeof(msgheader), tic);
+		if (len > 0)
+			ok = ok && writeData(&msgdata[0], len, tic);
+
+		offset += sizeof(msgheader) + len;
+	}
+
+	fclose(infp);
+
+	ok = ok && flushBlock();
+
+	if (ok)
+	{
+		fflush(demofp);
+		header.snapshot_index_offset = ftell(demofp);
+		ok = writeSnapshotIndex();
+
+		fflush(demofp);
+		header.map_index_offset = ftell(demofp);
+		ok = ok && writeMapIndex();
+
+		fflush(demofp);
+		header.block_index_offset = ftell(demofp);
+		header.block_index_size = block_index.size();
+		ok = ok && writeBlockIndex();
+
+		ok = ok && writeHeader();
+	}
+
+	if (!ok)
+	{
+		error("Unable to convert netdemo " + infilename + ".");
+		return false;
+	}
+
+	fflush(demofp);
+	long outsize = ftell(demofp);
+
+	Printf(PRINT_HIGH, "Converted %s to %s (%u bytes to %ld bytes in %u blocks).\n",
+		infilename.c_str(), outfilename.c_str(), endoffset, outsize, (unsigned)block_index.size());
+
+	reset();
+	return true;
+}
+
+
 // 
 // pause()
 //
@@ -606,7 +645,13 @@ bool NetDemo::stopRecording()
 
 	// write the end-of-demo marker
 	byte marker = svc_netdemostop;
-	writeChunk(&marker, sizeof(marker), NetDemo::msg_packet);
+	writeChunk(&marker, sizeof(marker), NETDEMO_MSG_PACKET);
+
+	if (!flushBlock())
+	{
+		error("Unable to write netdemo block.");
+		return false;
+	}
 
 	// write the number of the last gametic in the recording
 	header.ending_gametic = gametic;
@@ -633,6 +678,17 @@ bool NetDemo::stopRecording()
 		return false;
 	}
 
+	// and the block index after that
+	fflush(demofp);
+	header.block_index_offset = ftell(demofp);
+	header.block_index_size = block_index.size();
+
+	if (!writeBlockIndex())
+	{
+		error("Unable to write netdemo block index.");
+		return false;
+	}
+
 	// rewrite the header since snapshot_index_offset and 
 	// snapshot_index_size are now known
 	if (!writeHeader())
@@ -719,23 +775,11 @@ void NetDemo::writeLocalCmd(buf_t *netbuffer) const
 
 void NetDemo::writeChunk(const byte *data, size_t size, netdemo_message_t type)
 {
-	message_header_t msgheader;
-	memset(&msgheader, 0, sizeof(msgheader));
-	
-	msgheader.type = static_cast<byte>(type);
-	msgheader.length = LELONG((uint32_t)size);
-	msgheader.gametic = LELONG(gametic);
-	
-	size_t cnt = 0;
-	cnt += sizeof(msgheader.type) *
-		fwrite(&msgheader.type, sizeof(msgheader.type), 1, demofp);
-	cnt += sizeof(msgheader.length) *
-		fwrite(&msgheader.length, sizeof(msgheader.length), 1, demofp);
-	cnt += sizeof(msgheader.gametic) *
-		fwrite(&msgheader.gametic, sizeof(msgheader.gametic), 1, demofp);
+	byte msgheader[NETDEMO_MESSAGE_HEADER_SIZE];
+
+	D_WriteNetDemoMessageHeader(msgheader, type, size, gametic);
 
-	cnt += fwrite(data, 1, size, demofp);
-	if (cnt < size + NetDemo::MESSAGE_HEADER_SIZE)
+	if (!writeData(msgheader, sizeof(msgheader), gametic) || !writeData(data, size, gametic))
 	{
 		error("Unable to write netdemo message chunk\n");
 		return;
@@ -743,6 +787,314 @@ void NetDemo::writeChunk(const byte *data, size_t size, netdemo_message_t type)
 }
 
 
+//
+// writeData()
+//
+//   Writes raw message data to the netdemo file. For compressed netdemos, the
+//   data is added to the current block, which is written out once it is
+//   large enough. tic is the gametic of the message the data belongs to.
+//
+bool NetDemo::writeData(const void *data, size_t size, uint32_t tic)
+{
+	if (!isCompressed())
+		return fwrite(data, 1, size, demofp) == size;
+
+	if (blockbuf.empty())
+		blocktic = tic;
+
+	blockbuf.insert(blockbuf.end(), (const byte*)data, (const byte*)data + size);
+
+	if (blockbuf.size() >= NETDEMO_BLOCK_SIZE)
+		return flushBlock();
+
+	return true;
+}
+
+
+//
+// flushBlock()
+//
+//   Compresses the current block and writes it to the netdemo file along with
+//   its block header, recording it in the block index.
+//
+bool NetDemo::flushBlock()
+{
+	if (!isCompressed())
+		return true;
+
+	return D_WriteNetDemoBlock(demofp, blockbuf, blocktic, block_index);
+}
+
+
+//
+// ReadNetDemoBlock()
+//
+//   Reads and decompresses the block at the given offset into data.
+//   Sets nextoffset to the offset of the block that follows it. This only
+//   uses the given file handle, so it is safe to call from the prefetch thread.
+//
+static bool ReadNetDemoBlock(FILE *fp, uint32_t offset, std::vector<byte> &data,
+							 std::vector<byte> &scratch, uint32_t &nextoffset, size_t maxsize)
+{
+	uint32_t blockheader[3];
+
+	if (fseek(fp, offset, SEEK_SET) != 0)
+		return false;
+	if (fread(blockheader, 1, sizeof(blockheader), fp) < sizeof(blockheader))
+		return false;
+
+	uint32_t compressed_len = LELONG(blockheader[0]);
+	uint32_t raw_len = LELONG(blockheader[1]);
+
+	if (compressed_len == 0 || raw_len == 0 || raw_len > maxsize ||
+		compressed_len > raw_len + raw_len / 16 + 64 + 3)
+		return false;
+
+	scratch.resize(compressed_len);
+	if (fread(&scratch[0], 1, compressed_len, fp) < compressed_len)
+		return false;
+
+	data.resize(raw_len);
+	lzo_uint newlen = raw_len;
+	if (lzo1x_decompress_safe(&scratch[0], compressed_len, &data[0], &newlen, NULL) != LZO_E_OK ||
+		newlen != raw_len)
+		return false;
+
+	nextoffset = offset + sizeof(blockheader) + compressed_len;
+	return true;
+}
+
+
+//
+// Netdemo block prefetching
+//
+// [Odamex] While a compressed netdemo plays, the block after the current one
+// is read and decompressed on a separate thread with its own file handle so
+// that playback doesn't stall when it reaches the end of a block.
+//
+struct netdemo_prefetch_s
+{
+	thread_t*			thread;
+	mutex_t*			mutex;
+	condvar_t*			cond;
+	FILE*				fp;
+
+	uint32_t			offset;			// offset of the requested block
+	uint32_t			nextoffset;
+	bool				pending;		// the thread is reading the block
+	bool				done;			// the block has been read
+	bool				ok;
+	bool				quit;
+
+	std::vector<byte>	data;
+	std::vector<byte>	scratch;
+	size_t				maxsize;
+};
+
+static int NetDemoPrefetchThread(void *arg)
+{
+	netdemo_prefetch_s *pf = static_cast<netdemo_prefetch_s*>(arg);
+
+	OScopedLock lock(pf->mutex);
+	while (true)
+	{
+		while (!pf->pending && !pf->quit)
+			I_WaitCondVar(pf->cond, pf->mutex);
+
+		if (pf->quit)
+			break;
+
+		uint32_t offset = pf->offset;
+
+		I_UnlockMutex(pf->mutex);
+		uint32_t nextoffset = 0;
+		bool ok = ReadNetDemoBlock(pf->fp, offset, pf->data, pf->scratch, nextoffset, pf->maxsize);
+		I_LockMutex(pf->mutex);
+
+		pf->nextoffset = nextoffset;
+		pf->ok = ok;
+		pf->done = true;
+		pf->pending = false;
+		I_BroadcastCondVar(pf->cond);
+	}
+
+	return 0;
+}
+
+
+//
+// startPrefetch()
+//
+//   Starts the prefetch thread for a compressed netdemo. Blocks are read on
+//   the main thread instead if threads aren't available.
+//
+void NetDemo::startPrefetch()
+{
+	stopPrefetch();
+
+	if (!I_ThreadsAvailable())
+		return;
+
+	FILE *fp = fopen(filename.c_str(), "rb");
+	if (!fp)
+		return;
+
+	prefetch = new netdemo_prefetch_s;
+	prefetch->fp = fp;
+	prefetch->offset = prefetch->nextoffset = 0;
+	prefetch->pending = prefetch->done = prefetch->ok = prefetch->quit = false;
+	prefetch->maxsize = NetDemo::MAX_BLOCK_SIZE;
+	prefetch->mutex = I_CreateMutex();
+	prefetch->cond = I_CreateCondVar();
+	prefetch->thread = I_CreateThread(NetDemoPrefetchThread, prefetch);
+
+	if (prefetch->thread == NULL)
+		stopPrefetch();
+}
+
+
+//
+// stopPrefetch()
+//
+void NetDemo::stopPrefetch()
+{
+	if (!prefetch)
+		return;
+
+	if (prefetch->thread)
+	{
+		{
+			OScopedLock lock(prefetch->mutex);
+			prefetch->quit = true;
+			I_BroadcastCondVar(prefetch->cond);
+		}
+		I_WaitThread(prefetch->thread);
+	}
+
+	I_DestroyCondVar(prefetch->cond);
+	I_DestroyMutex(prefetch->mutex);
+	fclose(prefetch->fp);
+
+	delete prefetch;
+	prefetch = NULL;
+}
+
+
+//
+// loadBlock()
+//
+//   Makes the block at the given offset the current block, taking it from
+//   the prefetch thread if it was read ahead, and starts prefetching the
+//   block that follows it.
+//
+bool NetDemo::loadBlock(uint32_t offset)
+{
+	bool loaded = false;
+
+	if (prefetch)
+	{
+		OScopedLock lock(prefetch->mutex);
+		if (prefetch->offset == offset && (prefetch->pending || prefetch->done))
+		{
+			while (prefetch->pending)
+				I_WaitCondVar(prefetch->cond, prefetch->mutex);
+
+			if (prefetch->ok)
+			{
+				blockbuf.swap(prefetch->data);
+				nextblockoffset = prefetch->nextoffset;
+				loaded = true;
+			}
+			prefetch->done = false;
+		}
+	}
+
+	if (!loaded)
+	{
+		std::vector<byte> scratch;
+		if (!ReadNetDemoBlock(demofp, offset, blockbuf, scratch, nextblockoffset, NetDemo::MAX_BLOCK_SIZE))
+		{
+			blockbuf.clear();
+			blockpos = 0;
+			return false;
+		}
+	}
+
+	blockpos = 0;
+
+	// the indices follow the last block
+	if (prefetch && nextblockoffset < header.snapshot_index_offset)
+	{
+		OScopedLock lock(prefetch->mutex);
+		while (prefetch->pending)
+			I_WaitCondVar(prefetch->cond, prefetch->mutex);
+
+		prefetch->offset = nextblockoffset;
+		prefetch->done = false;
+		prefetch->pending = true;
+		I_BroadcastCondVar(prefetch->cond);
+	}
+
+	return true;
+}
+
+
+//
+// readData()
+//
+//   Reads size bytes of message data from the netdemo file, moving on to the
+//   next block of compressed netdemos as needed.
+//
+bool NetDemo::readData(void *dest, size_t size)
+{
+	if (!isCompressed())
+		return fread(dest, 1, size, demofp) == size;
+
+	byte *out = static_cast<byte*>(dest);
+	while (size > 0)
+	{
+		if (blockpos >= blockbuf.size())
+		{
+			if (nextblockoffset >= header.snapshot_index_offset || !loadBlock(nextblockoffset))
+				return false;
+		}
+
+		size_t cnt = MIN(size, blockbuf.size() - blockpos);
+		memcpy(out, &blockbuf[blockpos], cnt);
+		blockpos += cnt;
+		out += cnt;
+		size -= cnt;
+	}
+
+	return true;
+}
+
+
+//
+// skipData()
+//
+bool NetDemo::skipData(size_t size)
+{
+	if (!isCompressed())
+		return fseek(demofp, size, SEEK_CUR) == 0;
+
+	while (size > 0)
+	{
+		if (blockpos >= blockbuf.size())
+		{
+			if (nextblockoffset >= header.snapshot_index_offset || !loadBlock(nextblockoffset))
+				return false;
+		}
+
+		size_t cnt = MIN(size, blockbuf.size() - blockpos);
+		blockpos += cnt;
+		size -= cnt;
+	}
+
+	return true;
+}
+
+
 //
 // atSnapshotInterval()
 //
@@ -784,9 +1136,13 @@ void NetDemo::writeMessages()
 	{
 		size_t length;
 		writeSnapshotData(snapbuf, length);
-		writeSnapshotIndexEntry();
-			
-		writeChunk(snapbuf, length, NetDemo::msg_snapshot);
+		if (!writeSnapshotIndexEntry())
+		{
+			error("Unable to write netdemo block.");
+			return;
+		}
+
+		writeChunk(snapbuf, length, NETDEMO_MSG_SNAPSHOT);
 	}
 
 	if (connected)
@@ -812,7 +1168,7 @@ void NetDemo::writeMessages()
 		captured.pop_front();
 	}
 
-	writeChunk(output_buf, output_len, NetDemo::msg_packet);
+	writeChunk(output_buf, output_len, NETDEMO_MSG_PACKET);
 
 	delete [] output_buf;
 }
@@ -825,29 +1181,22 @@ void NetDemo::writeMessages()
 //   len and tic parameters.
 //   Returns false upon file read error.
 
-bool NetDemo::readMessageHeader(netdemo_message_t &type, uint32_t &len, uint32_t &tic) const
+bool NetDemo::readMessageHeader(netdemo_message_t &type, uint32_t &len, uint32_t &tic)
 {
 	len = tic = 0;
 
-	message_header_t msgheader;
-	
-	size_t cnt = 0;
-	cnt += sizeof(msgheader.type) *
-		fread(&msgheader.type, sizeof(msgheader.type), 1, demofp);
-	cnt += sizeof(msgheader.length) *
-		fread(&msgheader.length, sizeof(msgheader.length), 1, demofp);
-	cnt += sizeof(msgheader.gametic) *
-		fread(&msgheader.gametic, sizeof(msgheader.gametic), 1, demofp);
-	
-	if (cnt < NetDemo::MESSAGE_HEADER_SIZE)
+	byte msgheader[NETDEMO_MESSAGE_HEADER_SIZE];
+	if (!readData(msgheader, sizeof(msgheader)))
 	{
 		return false;
 	}
 
 	// convert the values to native byte order
-	len = LELONG(msgheader.length);
-	tic = LELONG(msgheader.gametic);
-	type = static_cast<netdemo_message_t>(msgheader.type);
+	memcpy(&len, msgheader + 1, sizeof(len));
+	memcpy(&tic, msgheader + 5, sizeof(tic));
+	len = LELONG(len);
+	tic = LELONG(tic);
+	type = static_cast<netdemo_message_t>(msgheader[0]);
 
 	return true;
 }
@@ -864,8 +1213,7 @@ void NetDemo::readMessageBody(buf_t *netbuffer, uint32_t len)
 {
 	char *msgdata = new char[len];
 	
-	size_t cnt = fread(msgdata, 1, len, demofp);
-	if (cnt < len)
+	if (!readData(msgdata, len))
 	{
 		delete[] msgdata;
 		fatalError("Can not read netdemo message.");
@@ -929,13 +1277,20 @@ void NetDemo::readMessages(buf_t* netbuffer)
 	uint32_t len = 0, tic = 0;
 	
 	// get the values for type, len and tic
-	readMessageHeader(type, len, tic);
+	if (!readMessageHeader(type, len, tic))
+	{
+		fatalError("Unexpected end of netdemo.");
+		return;
+	}
 	
-	while (type == NetDemo::msg_snapshot)
+	while (type == NETDEMO_MSG_SNAPSHOT)
 	{
 		// skip over snapshots and read the next message instead
-		fseek(demofp, len, SEEK_CUR);
-		readMessageHeader(type, len, tic);
+		if (!skipData(len) || !readMessageHeader(type, len, tic))
+		{
+			fatalError("Unexpected end of netdemo.");
+			return;
+		}
 	}
 
 	// read from the input file and put the data into netbuffer
@@ -1214,7 +1569,7 @@ void NetDemo::writeConnectionSequence(buf_t *netbuffer)
 //		Returns the snapshot that preceeds the ticnum parameter or returns
 //		NULL if the ticnum is out of bounds.
 //
-const NetDemo::netdemo_index_entry_t *NetDemo::snapshotLookup(int ticnum) const
+const netdemo_index_entry_t *NetDemo::snapshotLookup(int ticnum) const
 {
 	int index = (ticnum - header.starting_gametic) / header.snapshot_spacing - 1;
 
@@ -1325,7 +1680,7 @@ void NetDemo::nextMap()
 	if (nextmapindex >= header.map_index_size)
 		return;
 
-	const NetDemo::netdemo_index_entry_t *snap = &map_index[nextmapindex];
+	const netdemo_index_entry_t *snap = &map_index[nextmapindex];
 	
 	readSnapshot(snap);
 }
@@ -1345,7 +1700,7 @@ void NetDemo::prevMap()
 	if (prevmapindex < 0)
 		prevmapindex = 0;
 
-	const NetDemo::netdemo_index_entry_t *snap = &map_index[prevmapindex];
+	const netdemo_index_entry_t *snap = &map_index[prevmapindex];
 
 	readSnapshot(snap);
 }
@@ -1362,7 +1717,20 @@ void NetDemo::readSnapshot(const netdemo_index_entry_t *snap)
 
 	gametic = snap->ticnum;
 	int file_offset = snap->offset;
-	fseek(demofp, file_offset, SEEK_SET);
+
+	// snapshots are always at the start of a block in compressed netdemos
+	if (isCompressed())
+	{
+		if (!loadBlock(file_offset))
+		{
+			fatalError("Unable to read netdemo block");
+			return;
+		}
+	}
+	else
+	{
+		fseek(demofp, file_offset, SEEK_SET);
+	}
 	
 	// read the values for length, gametic, and message type
 	netdemo_message_t type;
@@ -1375,8 +1743,7 @@ void NetDemo::readSnapshot(const netdemo_index_entry_t *snap)
 		return;
 	}
 		
-	size_t cnt = fread(snapbuf, 1, len, demofp);
-	if (cnt < len)
+	if (!readData(snapbuf, len))
 	{
 		fatalError("Unable to read snapshot from data file");
 		return;
@@ -1440,10 +1807,13 @@ void NetDemo::writeMapChange()
 	{
 		size_t length;
 		writeSnapshotData(snapbuf, length);
-		writeMapIndexEntry();
-		writeSnapshotIndexEntry();
-		
-		writeChunk(snapbuf, length, NetDemo::msg_snapshot);
+		if (!writeMapIndexEntry() || !writeSnapshotIndexEntry())
+		{
+			error("Unable to write netdemo block.");
+			return;
+		}
+
+		writeChunk(snapbuf, length, NETDEMO_MSG_SNAPSHOT);
 	}
 }
 
@@ -1453,9 +1823,13 @@ void NetDemo::writeIntermission()
 	{
 		size_t length;
 		writeSnapshotData(snapbuf, length);
-		writeSnapshotIndexEntry();
-		
-		writeChunk(snapbuf, length, NetDemo::msg_snapshot);
+		if (!writeSnapshotIndexEntry())
+		{
+			error("Unable to write netdemo block.");
+			return;
+		}
+
+		writeChunk(snapbuf, length, NETDEMO_MSG_SNAPSHOT);
 	}
 }
 
@@ -1667,30 +2041,40 @@ void NetDemo::readSnapshotData(byte *buf, size_t length)
 // writeSnapshotIndexEntry()
 //
 //   
-void NetDemo::writeSnapshotIndexEntry()
+bool NetDemo::writeSnapshotIndexEntry()
 {
+	// the indexed message starts a new block
+	if (!flushBlock())
+		return false;
+
 	// Update the snapshot index
 	netdemo_index_entry_t entry;
-	
 	fflush(demofp);
 	entry.offset = ftell(demofp);
 	entry.ticnum = gametic;
 	snapshot_index.push_back(entry);
+
+	return true;
 }
 
 //
 // writeMapIndexEntry()
 //
 //   
-void NetDemo::writeMapIndexEntry()
+bool NetDemo::writeMapIndexEntry()
 {
+	// the indexed message starts a new block
+	if (!flushBlock())
+		return false;
+
 	// Update the map index
 	netdemo_index_entry_t entry;
-	
 	fflush(demofp);
 	entry.offset = ftell(demofp);
 	entry.ticnum = gametic;
 	map_index.push_back(entry);
+
+	return true;
 }
 
 VERSION_CONTROL (cl_demo_cpp, "$Id$")
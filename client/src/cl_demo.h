@@ -4,10 +4,13 @@
 #include "doomtype.h"
 #include "i_net.h"
 #include "d_net.h"
+#include "d_netdemo.h"
 #include <string>
 #include <vector>
 #include <list>
 
+struct netdemo_prefetch_s;
+
 class NetDemo
 {
 public:
@@ -20,6 +23,7 @@ public:
 	bool startRecording(const std::string &filename);
 	bool stopPlaying();
 	bool stopRecording();
+	bool convert(const std::string &infilename, const std::string &outfilename);
 	bool pause();
 	bool resume();
 	
@@ -34,6 +38,8 @@ public:
 	bool isPaused() const { return (state == NetDemo::st_paused); }
 	
 	int getSpacing() const { return header.snapshot_spacing; }
+	bool isCompressed() const { return header.compression == NETDEMO_COMP_LZO_BLOCKS; }
+	size_t getBlockCount() const { return block_index.size(); }
 	
 	void nextSnapshot();
 	void prevSnapshot();
@@ -55,25 +61,6 @@ private:
 		st_paused
 	} netdemo_state_t;
 
-	typedef enum
-	{
-		msg_packet		= 0xAA,
-		msg_snapshot
-	} netdemo_message_t;
-
-	typedef struct
-	{
-		byte		type;
-		uint32_t	length;
-		uint32_t	gametic;
-	} message_header_t;
-
-	typedef struct
-	{
-		uint32_t	ticnum;
-		uint32_t	offset;			// offset in the demo file
-	} netdemo_index_entry_t;
-	
 	void cleanUp();
 	void copy(NetDemo &to, const NetDemo &from);
 	void error(const std::string &message);
@@ -87,10 +74,17 @@ private:
 	void readSnapshotData(byte *buf, size_t length);
 	void writeSnapshotData(byte *buf, size_t &length);
 	
-	void writeSnapshotIndexEntry();
-	void writeMapIndexEntry();
+	bool writeSnapshotIndexEntry();
+	bool writeMapIndexEntry();
 	void readSnapshot(const netdemo_index_entry_t *snap);
 	void writeChunk(const byte *data, size_t size, netdemo_message_t type);
+	bool writeData(const void *data, size_t size, uint32_t tic);
+	bool readData(void *dest, size_t size);
+	bool skipData(size_t size);
+	bool flushBlock();
+	bool loadBlock(uint32_t offset);
+	void startPrefetch();
+	void stopPrefetch();
 	bool writeHeader();
 	bool readHeader();
 	
@@ -100,34 +94,19 @@ private:
 	bool readSnapshotIndex();
 	bool writeMapIndex();
 	bool readMapIndex();
+	bool writeBlockIndex();
+	bool readBlockIndex();
+	bool writeIndex(const std::vector<netdemo_index_entry_t> &index, uint32_t offset);
+	bool readIndex(std::vector<netdemo_index_entry_t> &index, uint32_t offset, size_t size);
 	int getCurrentSnapshotIndex() const;
 	int getCurrentMapIndex() const;
 	
 	void writeLocalCmd(buf_t *netbuffer) const;
-	bool readMessageHeader(netdemo_message_t &type, uint32_t &len, uint32_t &tic) const;
+	bool readMessageHeader(netdemo_message_t &type, uint32_t &len, uint32_t &tic);
 	void readMessageBody(buf_t *netbuffer, uint32_t len);
 	void writeFullUpdate(int ticnum);
 
-	typedef struct
-	{
-		char		identifier[4];  		// "ODAD"
-		byte		version;
-		byte    	compression;    		// type of compression used
-		uint16_t	snapshot_index_size;	// number of snapshots in the index
-		uint32_t	snapshot_index_offset;	// offset from start of the file for the index
-		uint16_t	map_index_size;			// number of maps in the mapindex
-		uint32_t	map_index_offset;		// offset from start of the file for the mapindex
-		uint16_t	snapshot_spacing;		// number of gametics between indices
-		uint32_t	starting_gametic;		// the gametic the demo starts at
-		uint32_t	ending_gametic;			// the last gametic of the demo
-		byte		reserved[36];   		// for future use
-	} netdemo_header_t;
-	
-	static const size_t HEADER_SIZE = 64;
-	static const size_t MESSAGE_HEADER_SIZE = 9;
-	static const size_t INDEX_ENTRY_SIZE = 8;
-
-	static const uint16_t SNAPSHOT_SPACING = 20 * TICRATE;
+	static const size_t MAX_BLOCK_SIZE = 4194304;
 
 	static const size_t MAX_SNAPSHOT_SIZE = 131072;
 	
@@ -141,6 +120,14 @@ private:
 	netdemo_header_t	header;	
 	std::vector<netdemo_index_entry_t> snapshot_index;
 	std::vector<netdemo_index_entry_t> map_index;
+	std::vector<netdemo_index_entry_t> block_index;
+
+	// uncompressed contents of the block being written or read
+	std::vector<byte>	blockbuf;
+	size_t				blockpos;
+	uint32_t			blocktic;
+	uint32_t			nextblockoffset;
+	netdemo_prefetch_s*	prefetch;
 	
 	byte				snapbuf[NetDemo::MAX_SNAPSHOT_SIZE];
 	int					netdemotic;
@@ -71,6 +71,7 @@
 
 #include <string>
 #include <vector>
+#include <algorithm>
 #include <map>
 #include <set>
 #include <sstream>
@@ -143,6 +144,12 @@ std::set<byte> teleported_players;
 // [SL] 2012-04-06 - moving sector snapshots received from the server
 std::map<unsigned short, SectorSnapshotManager> sector_snaps;
 
+// [Odamex] position snapshots for monsters and missiles received from the server
+std::map<unsigned short, ActorSnapshotManager> actor_snaps;
+
+// the world_index that CL_SimulateActors moves actors to after P_Ticker
+static int actor_world_index = 0;
+
 EXTERN_CVAR (sv_weaponstay)
 
 EXTERN_CVAR (cl_predictsectors)
@@ -647,11 +654,23 @@ void CL_StepTics(unsigned int count)
 	DObject::EndFrame ();
 }
 
+static void CL_NetDemoTimeFrame();
+static void CL_NetDemoTimeReport();
+
 //
 // CL_DisplayTics
 //
 void CL_DisplayTics()
 {
+	if (timingnetdemo)
+	{
+		dtime_t render_start = I_GetTime();
+		D_Display();
+		CL_AddNetDemoTime(NETDEMO_BENCH_RENDER, I_GetTime() - render_start);
+		CL_NetDemoTimeFrame();
+		return;
+	}
+
 	D_Display();
 }
 
@@ -698,6 +717,9 @@ void CL_RunTics()
 		CL_StepTics(1);
 	}
 
+	if (timingnetdemo && !netdemo.isPlaying())
+		CL_NetDemoTimeReport();
+
 	if (!connected)
 		CL_RequestConnectInfo();
 
@@ -1155,6 +1177,106 @@ void CL_NetDemoPlay(const std::string &filename)
 	netdemo.startPlaying(newfilename);
 }
 
+//
+// [Odamex] Headless netdemo replay benchmark
+//
+// -timenetdemo plays a netdemo back as fast as possible with no window or
+// audio, timing the parsing of server messages, the simulation and, with
+// -benchrender, the software renderer drawing into the offscreen surface.
+// A report is printed when playback ends and the client exits with a
+// non-zero status if nothing could be played.
+//
+bool timingnetdemo = false;
+bool timingnetdemo_render = false;
+
+static dtime_t netdemo_bench_start;
+static dtime_t netdemo_bench_lastframe;
+static dtime_t netdemo_bench_times[NUM_NETDEMO_BENCH_PHASES];
+static unsigned int netdemo_bench_tics;
+static size_t netdemo_bench_messages;
+static size_t netdemo_bench_bytes;
+static std::vector<dtime_t> netdemo_bench_frames;
+
+void CL_NetDemoTime(const std::string &filename)
+{
+	timingdemo = true;		// run the simulation and display uncapped
+	timingnetdemo = true;
+	timingnetdemo_render = Args.CheckParm("-benchrender") != 0;
+
+	for (int i = 0; i < NUM_NETDEMO_BENCH_PHASES; i++)
+		netdemo_bench_times[i] = 0;
+	netdemo_bench_tics = 0;
+	netdemo_bench_messages = 0;
+	netdemo_bench_bytes = 0;
+	netdemo_bench_frames.clear();
+	netdemo_bench_frames.reserve(TICRATE * 60 * 30);
+
+	CL_NetDemoPlay(filename);
+
+	netdemo_bench_start = netdemo_bench_lastframe = I_GetTime();
+}
+
+void CL_AddNetDemoTime(netdemo_benchphase_t phase, dtime_t time)
+{
+	netdemo_bench_times[phase] += time;
+	if (phase == NETDEMO_BENCH_PARSE)
+		netdemo_bench_tics++;
+}
+
+static void CL_NetDemoTimeFrame()
+{
+	dtime_t now = I_GetTime();
+	netdemo_bench_frames.push_back(now - netdemo_bench_lastframe);
+	netdemo_bench_lastframe = now;
+}
+
+static double CL_NetDemoTimePercentile(const std::vector<dtime_t> &sorted, int percent)
+{
+	size_t index = MIN(sorted.size() - 1, sorted.size() * percent / 100);
+	return double(sorted[index]) / 1e6;
+}
+
+static void CL_NetDemoTimeReport()
+{
+	double seconds = double(I_GetTime() - netdemo_bench_start) / 1e9;
+	unsigned int tics = MAX(netdemo_bench_tics, 1u);
+
+	static const char* phase_names[NUM_NETDEMO_BENCH_PHASES] = {
+		"parse", "sim", "render"
+	};
+
+	Printf(PRINT_HIGH, "timed %u gametics in %.3f seconds (%.1f tics/sec)\n",
+			netdemo_bench_tics, seconds, seconds > 0.0 ? netdemo_bench_tics / seconds : 0.0);
+
+	for (int i = 0; i < NUM_NETDEMO_BENCH_PHASES; i++)
+	{
+		if (i == NETDEMO_BENCH_RENDER && !timingnetdemo_render)
+			continue;
+		Printf(PRINT_HIGH, "  %-7s %10.3f ms total, %8.3f us/tic\n", phase_names[i],
+				double(netdemo_bench_times[i]) / 1e6, double(netdemo_bench_times[i]) / 1e3 / tics);
+	}
+
+	double parse_seconds = double(netdemo_bench_times[NETDEMO_BENCH_PARSE]) / 1e9;
+	if (parse_seconds > 0.0)
+		Printf(PRINT_HIGH, "  parsed  %u messages, %u bytes (%.0f messages/sec, %.2f MB/sec)\n",
+				(unsigned)netdemo_bench_messages, (unsigned)netdemo_bench_bytes,
+				netdemo_bench_messages / parse_seconds, netdemo_bench_bytes / parse_seconds / 1048576.0);
+
+	if (!netdemo_bench_frames.empty())
+	{
+		std::vector<dtime_t> sorted(netdemo_bench_frames);
+		std::sort(sorted.begin(), sorted.end());
+
+		Printf(PRINT_HIGH, "  frame   p50 %.3f ms, p90 %.3f ms, p99 %.3f ms, max %.3f ms\n",
+				CL_NetDemoTimePercentile(sorted, 50), CL_NetDemoTimePercentile(sorted, 90),
+				CL_NetDemoTimePercentile(sorted, 99), double(sorted.back()) / 1e6);
+	}
+
+	// exit the application
+	call_terms();
+	exit(netdemo_bench_tics > 0 ? EXIT_SUCCESS : EXIT_FAILURE);
+}
+
 BEGIN_COMMAND(stopnetdemo)
 {
 	if (netdemo.isRecording())
@@ -1246,6 +1368,9 @@ BEGIN_COMMAND(netdemostats)
 	Printf(PRINT_HIGH, "Total time: %i seconds\n", totaltime);
 	Printf(PRINT_HIGH, "Current position: %i seconds (%i%%)\n",
 		curtime, curtime * 100 / totaltime);
+	if (netdemo.isCompressed())
+		Printf(PRINT_HIGH, "Compressed blocks: %u\n", (unsigned)netdemo.getBlockCount());
+	Printf(PRINT_HIGH, "Snapshot spacing: %i seconds\n", netdemo.getSpacing() / TICRATE);
 	Printf(PRINT_HIGH, "Number of maps: %i\n", maptimes.size());
 	for (size_t i = 0; i < maptimes.size(); i++)
 	{
@@ -1255,6 +1380,20 @@ BEGIN_COMMAND(netdemostats)
 }
 END_COMMAND(netdemostats)
 
+BEGIN_COMMAND(netdemoconvert)
+{
+	if (argc < 3)
+	{
+		Printf(PRINT_HIGH, "Usage: netdemoconvert <input> <output>\n");
+		Printf(PRINT_HIGH, "Converts an uncompressed netdemo to the compressed netdemo format.\n");
+		return;
+	}
+
+	NetDemo converter;
+	converter.convert(argv[1], argv[2]);
+}
+END_COMMAND(netdemoconvert)
+
 BEGIN_COMMAND(netff)
 {
 	if (netdemo.isPlaying())
@@ -1458,11 +1597,41 @@ void CL_MoveMobj(void)
 	}
 	else
 	{
-		CL_MoveThing (mo, x, y, z);
+		// [Odamex] Save the position to a snapshot so that CL_SimulateActors
+		// can smooth the actor's movement between sparse updates
+		ActorSnapshot newsnap(last_svgametic);
+		newsnap.setAuthoritative(true);
+
+		newsnap.setX(x);
+		newsnap.setY(y);
+		newsnap.setZ(z);
+
+		actor_snaps[netid].addSnapshot(newsnap);
 		mo->rndindex = rndindex;
 	}
 }
 
+//
+// CL_FinishActorSnapshots
+//
+// Moves the actor to the most recent position received from the server and
+// stops moving it along its snapshots.  The server sends the exact position
+// of a missile or monster right before it explodes or dies.
+//
+static void CL_FinishActorSnapshots(AActor *mo)
+{
+	std::map<unsigned short, ActorSnapshotManager>::iterator itr;
+	itr = actor_snaps.find(mo->netid);
+	if (itr == actor_snaps.end())
+		return;
+
+	ActorSnapshot snap = itr->second.getSnapshot(itr->second.getMostRecentTime());
+	if (snap.isValid())
+		CL_MoveThing(mo, snap.getX(), snap.getY(), snap.getZ());
+
+	actor_snaps.erase(itr);
+}
+
 //
 // CL_DamageMobj
 //
@@ -2180,6 +2349,7 @@ void CL_SpawnMobj()
 		return;
 
 	P_ClearId(netid);
+	actor_snaps.erase(netid);
 
 	mo = new AActor (x, y, z, (mobjtype_t)type);
 
@@ -2454,6 +2624,23 @@ void CL_SetMobjSpeedAndAngle(void)
 		mo->momx = momx;
 		mo->momy = momy;
 		mo->momz = momz;
+
+		// [Odamex] Add the momentum to the position snapshot received for
+		// this gametic so that it can be used for extrapolation
+		std::map<unsigned short, ActorSnapshotManager>::iterator itr;
+		itr = actor_snaps.find(netid);
+		if (itr != actor_snaps.end() && itr->second.getMostRecentTime() == last_svgametic)
+		{
+			ActorSnapshot newsnap(last_svgametic);
+			newsnap.setAuthoritative(true);
+
+			newsnap.setMomX(momx);
+			newsnap.setMomY(momy);
+			newsnap.setMomZ(momz);
+			newsnap.setAngle(angle);
+
+			itr->second.addSnapshot(newsnap);
+		}
 	}
 }
 
@@ -2471,6 +2658,9 @@ void CL_ExplodeMissile(void)
 	if (!mo)
 		return;
 
+	// explode the missile where the server says it hit
+	CL_FinishActorSnapshots(mo);
+
 	P_ExplodeMissile(mo);
 }
 
@@ -2523,6 +2713,7 @@ void CL_RemoveMobj(void)
 		displayplayer_id = consoleplayer_id;
 
 	P_ClearId(netid);
+	actor_snaps.erase(netid);
 }
 
 
@@ -2591,6 +2782,9 @@ void CL_KillMobj(void)
 		for (size_t i = 0; i < MAXSAVETICS; i++)
 			localcmds[i].clear();
 
+	// don't slide corpses along their last known path
+	CL_FinishActorSnapshots(target);
+
 	P_KillMobj (source, target, inflictor, joinkill);
 }
 
@@ -2760,6 +2954,16 @@ void CL_ClearSectorSnapshots()
 	sector_snaps.clear();
 }
 
+//
+// CL_ClearActorSnapshots
+//
+// Removes all actor snapshots at the start of a map, etc
+//
+void CL_ClearActorSnapshots()
+{
+	actor_snaps.clear();
+}
+
 //
 // CL_UpdateSector
 // Updates floorheight and ceilingheight of a sector.
@@ -2985,8 +3189,13 @@ void CL_CheckMissedPacket(void)
 // if 0'd sections
 void CL_Decompress(int sequence)
 {
+	int packetsize = MSG_BytesLeft();
+
 	if(!MSG_BytesLeft() || MSG_NextByte() != svc_compressed)
+	{
+		netgraph.addPacket(packetsize, packetsize);
 		return;
+	}
 	else
 		MSG_ReadByte();
 
@@ -3004,6 +3213,8 @@ void CL_Decompress(int sequence)
 
 	if(method & minilzo_mask)
 		MSG_DecompressMinilzo();
+
+	netgraph.addPacket(packetsize, MSG_BytesLeft());
 #if 0
 	if(method & adaptive_record_mask)
 		compressor.ack_sent(net_message.ptr(), MSG_BytesLeft());
@@ -3316,6 +3527,7 @@ void CL_LoadMap(void)
 	teleported_players.clear();
 
 	CL_ClearSectorSnapshots();
+	CL_ClearActorSnapshots();
 	for (Players::iterator it = players.begin();it != players.end();++it)
 		it->snapshots.clearSnapshots();
 
@@ -3486,15 +3698,17 @@ void CL_WarmupState()
 }
 
 // client source (once)
+// [Odamex] Message handlers are looked up directly by message id.
 typedef void (*client_callback)();
-typedef std::map<svc_t, client_callback> cmdmap;
-cmdmap cmds;
+static client_callback cmds[256];
 
 //
 // CL_AllowPackets
 //
 void CL_InitCommands(void)
 {
+	memset(cmds, 0, sizeof(cmds));
+
 	cmds[svc_abort]				= &CL_EndGame;
 	cmds[svc_loadmap]			= &CL_LoadMap;
 	cmds[svc_resetmap]			= &CL_ResetMap;
@@ -3583,13 +3797,35 @@ void CL_InitCommands(void)
 	cmds[svc_maplist_index] = &CL_MaplistIndex;
 }
 
+//
+// CL_PrintMessageHistory
+//
+// Prints the most recent messages parsed from the current packet, oldest
+// first, for diagnosing bad server messages.
+//
+static const size_t MESSAGE_HISTORY_SIZE = 64;
+
+static void CL_PrintMessageHistory(const svc_t *history, size_t count)
+{
+	size_t first = count > MESSAGE_HISTORY_SIZE ? count - MESSAGE_HISTORY_SIZE : 0;
+
+	for (size_t j = first; j < count; j++)
+	{
+		svc_t cmd = history[j % MESSAGE_HISTORY_SIZE];
+		Printf(PRINT_HIGH, "CL_ParseCommands: message #%u [%d %s]\n", (unsigned)j, cmd,
+				cmd < svc_max ? svc_info[cmd].getName() : "unknown");
+	}
+}
+
 //
 // CL_ParseCommands
 //
 void CL_ParseCommands(void)
 {
-	std::vector<svc_t>	history;
+	svc_t				history[MESSAGE_HISTORY_SIZE];
+	size_t				count = 0;
 	svc_t				cmd = svc_abort;
+	size_t				parseStart = net_message.BytesRead();
 
 	static bool once = true;
 	if(once)CL_InitCommands();
@@ -3598,26 +3834,27 @@ void CL_ParseCommands(void)
 	while(connected)
 	{
 		size_t byteStart = net_message.BytesRead();
+		dtime_t timeStart = I_GetTime();
 
 		cmd = (svc_t)MSG_ReadByte();
-		history.push_back(cmd);
 
 		if(cmd == (svc_t)-1)
 			break;
 
-		cmdmap::iterator i = cmds.find(cmd);
-		if(i == cmds.end())
+		history[count++ % MESSAGE_HISTORY_SIZE] = cmd;
+
+		client_callback handler = cmds[cmd & 0xFF];
+		if(handler == NULL)
 		{
 			CL_QuitNetGame();
 			Printf(PRINT_HIGH, "CL_ParseCommands: Unknown server message %d following: \n", (int)cmd);
 
-			for(size_t j = 0; j < history.size(); j++)
-				Printf(PRINT_HIGH, "CL_ParseCommands: message #%d [%d %s]\n", j, history[j], svc_info[history[j]].getName());
+			CL_PrintMessageHistory(history, count);
 			Printf(PRINT_HIGH, "\n");
 			break;
 		}
 
-		i->second();
+		handler();
 
 		if (net_message.overflowed)
 		{
@@ -3625,11 +3862,10 @@ void CL_ParseCommands(void)
 			Printf(PRINT_HIGH, "CL_ParseCommands: Bad server message\n");
 			Printf(PRINT_HIGH, "CL_ParseCommands: %d(%s) overflowed\n",
 					   (int)cmd,
-					   svc_info[cmd].getName());
+					   cmd < svc_max ? svc_info[cmd].getName() : "unknown");
 			Printf(PRINT_HIGH, "CL_ParseCommands: It was command number %d in the packet\n",
-                                           (int)history.back());
-			for(size_t j = 0; j < history.size(); j++)
-				Printf(PRINT_HIGH, "CL_ParseCommands: message #%d [%d %s]\n", j, history[j], svc_info[history[j]].getName());
+                                           (int)count - 1);
+			CL_PrintMessageHistory(history, count);
 		}
 
 		// Measure length of each message, so we can keep track of bandwidth.
@@ -3637,6 +3873,13 @@ void CL_ParseCommands(void)
 			Printf(PRINT_HIGH, "CL_ParseCommands: end byte (%d) < start byte (%d)\n", net_message.BytesRead(), byteStart);
 
 		netgraph.addTrafficIn(net_message.BytesRead() - byteStart);
+		netgraph.addMessage(cmd, net_message.BytesRead() - byteStart, I_GetTime() - timeStart);
+	}
+
+	if (timingnetdemo)
+	{
+		netdemo_bench_messages += count;
+		netdemo_bench_bytes += net_message.BytesRead() - parseStart;
 	}
 }
 
@@ -3984,6 +4227,71 @@ void CL_SimulatePlayers()
 }
 
 
+//
+// CL_SimulateActors
+//
+// Moves every monster and missile that the server has sent position updates
+// for along the path described by its snapshots.  This is called after
+// P_Ticker so the actor's previous position has been saved for rendering
+// interpolation and any movement by the actor's thinker is overridden.
+// Corrections from new updates are smoothed over several tics instead of
+// snapping the actor to the new position.
+//
+void CL_SimulateActors()
+{
+	if (gamestate != GS_LEVEL || netdemo.isPaused())
+		return;
+
+	std::map<unsigned short, ActorSnapshotManager>::iterator itr;
+	itr = actor_snaps.begin();
+
+	while (itr != actor_snaps.end())
+	{
+		AActor *mo = P_FindThingById(itr->first);
+		ActorSnapshotManager *mgr = &(itr->second);
+
+		// has the actor been removed or are its snapshots too old?
+		if (!mo || mo->player || mgr->empty() ||
+			actor_world_index - mgr->getMostRecentTime() > NUM_SNAPSHOTS)
+		{
+			actor_snaps.erase(itr++);
+			continue;
+		}
+
+		ActorSnapshot snap = mgr->getSnapshot(actor_world_index);
+		if (snap.isValid())
+		{
+			// The actor's previous position is where it was drawn last tic.
+			// If it doesn't match the snapshot for the previous world_index,
+			// a new update has corrected the actor's path.
+			ActorSnapshot prevsnap = mgr->getSnapshot(actor_world_index - 1);
+			if (snap.isContinuous() && prevsnap.isValid())
+			{
+				v3fixed_t offset;
+				M_SetVec3Fixed(&offset, prevsnap.getX() - mo->prevx,
+										prevsnap.getY() - mo->prevy,
+										prevsnap.getZ() - mo->prevz);
+
+				fixed_t dist = M_LengthVec3Fixed(&offset);
+				if (dist > 2 * FRACUNIT && dist < 128 * FRACUNIT)
+				{
+					static const fixed_t correction_amount = FRACUNIT * 0.80f;
+					M_ScaleVec3Fixed(&offset, &offset, correction_amount);
+
+					snap.setX(snap.getX() - offset.x);
+					snap.setY(snap.getY() - offset.y);
+					snap.setZ(snap.getZ() - offset.z);
+				}
+			}
+
+			CL_MoveThing(mo, snap.getX(), snap.getY(), snap.getZ());
+		}
+
+		++itr;
+	}
+}
+
+
 //
 // CL_SimulateWorld
 //
@@ -4043,6 +4351,8 @@ void CL_SimulateWorld()
 	CL_SimulateSectors();
 	CL_SimulatePlayers();
 
+	actor_world_index = world_index;
+
 	// [SL] 2012-03-17 - Try to maintain sync with the server by gradually
 	// slowing down or speeding up world_index
 	int drift_correction = CL_CalculateWorldIndexDriftCorrection();
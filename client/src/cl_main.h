@@ -63,6 +63,21 @@ bool CL_Connect(void);
 void CL_DisplayTics();
 void CL_RunTics();
 
+// [Odamex] headless netdemo replay benchmark (-timenetdemo)
+typedef enum
+{
+	NETDEMO_BENCH_PARSE,
+	NETDEMO_BENCH_SIM,
+	NETDEMO_BENCH_RENDER,
+	NUM_NETDEMO_BENCH_PHASES
+} netdemo_benchphase_t;
+
+extern bool timingnetdemo;
+extern bool timingnetdemo_render;
+
+void CL_NetDemoTime(const std::string &filename);
+void CL_AddNetDemoTime(netdemo_benchphase_t phase, dtime_t time);
+
 bool CL_SectorIsPredicting(sector_t *sector);
 
 std::string M_ExpandTokens(const std::string &str);
@@ -23,16 +23,21 @@
 //-----------------------------------------------------------------------------
 
 #include <sstream>
+#include <algorithm>
+#include <vector>
 
 #include "math.h"
 #include "g_game.h"
 #include "v_video.h"
 #include "v_text.h"
+#include "c_dispatch.h"
 #include "cl_netgraph.h"
 #include "r_draw.h"
 
+extern NetGraph netgraph;
+
 NetGraph::NetGraph(int x, int y) :
-	mX(x), mY(y)
+	mX(x), mY(y), mMessageLog(NULL)
 {
 	for (size_t i = 0; i < NetGraph::MAX_HISTORY_TICS; i++)
 	{
@@ -41,6 +46,8 @@ NetGraph::NetGraph(int x, int y) :
 		mTrafficIn[i] = 0;
 		mTrafficOut[i] = 0;
 	}
+
+	resetMessageStats();
 }
 
 void NetGraph::setMisprediction(bool val)
@@ -85,6 +92,193 @@ void NetGraph::setInterpolation(int val)
 	mInterpolation = val;
 }
 
+//
+// NetGraph::updateMessageSecond
+//
+// Moves the per message type statistics into the statistics for the last
+// full second when a new second starts.
+//
+void NetGraph::updateMessageSecond()
+{
+	int second = gametic / TICRATE;
+	if (second == mMessageSecond)
+		return;
+
+	if (mMessageSecond >= 0)
+	{
+		writeMessageLog();
+
+		memcpy(mLastMessages, mMessages, sizeof(mMessages));
+		mLastPackets = mPackets;
+	}
+
+	memset(mMessages, 0, sizeof(mMessages));
+	memset(&mPackets, 0, sizeof(mPackets));
+	mMessageSecond = second;
+}
+
+void NetGraph::addMessage(int cmd, int bytes, dtime_t parsetime)
+{
+	if (cmd < 0 || cmd >= svc_max)
+		return;
+
+	updateMessageSecond();
+
+	mMessages[cmd].count++;
+	mMessages[cmd].bytes += bytes;
+	mMessages[cmd].parsetime += parsetime;
+
+	mTotalMessages[cmd].count++;
+	mTotalMessages[cmd].bytes += bytes;
+	mTotalMessages[cmd].parsetime += parsetime;
+}
+
+void NetGraph::addPacket(int size, int uncompressedsize)
+{
+	updateMessageSecond();
+
+	mPackets.count++;
+	mPackets.bytes += size;
+	mPackets.uncompressedbytes += uncompressedsize;
+
+	mTotalPackets.count++;
+	mTotalPackets.bytes += size;
+	mTotalPackets.uncompressedbytes += uncompressedsize;
+}
+
+void NetGraph::resetMessageStats()
+{
+	memset(mMessages, 0, sizeof(mMessages));
+	memset(mLastMessages, 0, sizeof(mLastMessages));
+	memset(mTotalMessages, 0, sizeof(mTotalMessages));
+	memset(&mPackets, 0, sizeof(mPackets));
+	memset(&mLastPackets, 0, sizeof(mLastPackets));
+	memset(&mTotalPackets, 0, sizeof(mTotalPackets));
+
+	mMessageSecond = -1;
+	mMessageStartTic = gametic;
+}
+
+template <typename T>
+class NetGraphCompareBytes
+{
+public:
+	NetGraphCompareBytes(const T *stats) : mStats(stats) { }
+
+	bool operator()(int a, int b) const
+	{
+		return mStats[a].bytes > mStats[b].bytes;
+	}
+
+private:
+	const T *mStats;
+};
+
+//
+// NetGraphSortMessages
+//
+// Fills indices with the message types that were received, ordered by the
+// number of bytes used.
+//
+template <typename T>
+static void NetGraphSortMessages(const T *stats, std::vector<int> &indices)
+{
+	indices.clear();
+	for (int i = 0; i < svc_max; i++)
+	{
+		if (stats[i].count > 0)
+			indices.push_back(i);
+	}
+
+	std::sort(indices.begin(), indices.end(), NetGraphCompareBytes<T>(stats));
+}
+
+static float NetGraphCompressionRatio(int bytes, int uncompressedbytes)
+{
+	return uncompressedbytes > 0 ? 100.0f * bytes / uncompressedbytes : 100.0f;
+}
+
+//
+// NetGraph::printMessageReport
+//
+// Prints the bytes, count and parse time of each message type received
+// since the statistics were last reset.
+//
+void NetGraph::printMessageReport()
+{
+	float seconds = float(gametic - mMessageStartTic) / TICRATE;
+	if (seconds < 1.0f)
+		seconds = 1.0f;
+
+	std::vector<int> indices;
+	NetGraphSortMessages(mTotalMessages, indices);
+
+	Printf(PRINT_HIGH, "%-24s %8s %10s %9s %6s %9s\n",
+			"message", "count", "bytes", "bytes/s", "avg", "parse ms");
+
+	dtime_t totalparsetime = 0;
+	for (size_t i = 0; i < indices.size(); i++)
+	{
+		const messagestats_t &stats = mTotalMessages[indices[i]];
+		totalparsetime += stats.parsetime;
+
+		Printf(PRINT_HIGH, "%-24s %8d %10d %9.1f %6.1f %9.2f\n",
+				svc_info[indices[i]].getName(), stats.count, stats.bytes,
+				stats.bytes / seconds, float(stats.bytes) / stats.count,
+				stats.parsetime / 1000000.0);
+	}
+
+	Printf(PRINT_HIGH, "%d packets in %.1f seconds, %d bytes received (%.1f bytes/s)\n",
+			mTotalPackets.count, seconds, mTotalPackets.bytes, mTotalPackets.bytes / seconds);
+	Printf(PRINT_HIGH, "compressed to %.1f%% of %d bytes, %.2f ms spent parsing\n",
+			NetGraphCompressionRatio(mTotalPackets.bytes, mTotalPackets.uncompressedbytes),
+			mTotalPackets.uncompressedbytes, totalparsetime / 1000000.0);
+}
+
+//
+// NetGraph::startMessageLog
+//
+// Writes the statistics for each message type to a CSV file once per
+// second until stopMessageLog is called.
+//
+bool NetGraph::startMessageLog(const std::string &filename)
+{
+	stopMessageLog();
+
+	mMessageLog = fopen(filename.c_str(), "w");
+	if (!mMessageLog)
+		return false;
+
+	fprintf(mMessageLog, "second,message,count,bytes,parse_us,uncompressed_bytes\n");
+	return true;
+}
+
+void NetGraph::stopMessageLog()
+{
+	if (mMessageLog)
+		fclose(mMessageLog);
+	mMessageLog = NULL;
+}
+
+void NetGraph::writeMessageLog()
+{
+	if (!mMessageLog)
+		return;
+
+	for (int i = 0; i < svc_max; i++)
+	{
+		if (mMessages[i].count == 0)
+			continue;
+
+		fprintf(mMessageLog, "%d,%s,%d,%d,%.1f,\n", mMessageSecond,
+				svc_info[i].getName(), mMessages[i].count, mMessages[i].bytes,
+				mMessages[i].parsetime / 1000.0);
+	}
+
+	fprintf(mMessageLog, "%d,packets,%d,%d,,%d\n", mMessageSecond,
+			mPackets.count, mPackets.bytes, mPackets.uncompressedbytes);
+}
+
 static void NetGraphDrawBar(int startx, int starty, int width, int height, int color)
 {
 	dspan.color = color;
@@ -197,6 +391,42 @@ void NetGraph::drawTrafficOut(int x, int y)
 	screen->DrawText(textcolor, x, y, buf.str().c_str());
 }
 
+void NetGraph::drawMessages(int x, int y)
+{
+	static const int textcolor = CR_GREY;
+	static const int fontheight = 8;
+
+	updateMessageSecond();
+
+	dtime_t parsetime = 0;
+	for (int i = 0; i < svc_max; i++)
+		parsetime += mLastMessages[i].parsetime;
+
+	std::ostringstream buf;
+	buf.precision(2);
+	buf << "Packets: " << mLastPackets.count << "/s, " << std::fixed
+		<< NetGraphCompressionRatio(mLastPackets.bytes, mLastPackets.uncompressedbytes)
+		<< "% compressed";
+	screen->DrawText(textcolor, x, y, buf.str().c_str());
+
+	buf.str("");
+	buf << "Parse Time: " << std::fixed << parsetime / 1000000.0 << " ms/s";
+	screen->DrawText(textcolor, x, y + fontheight, buf.str().c_str());
+
+	std::vector<int> indices;
+	NetGraphSortMessages(mLastMessages, indices);
+
+	for (size_t i = 0; i < indices.size() && i < NetGraph::MAX_DRAWN_MESSAGES; i++)
+	{
+		const messagestats_t &stats = mLastMessages[indices[i]];
+
+		buf.str("");
+		buf << svc_info[indices[i]].getName() << ": " << stats.count << "/s "
+			<< std::fixed << stats.bytes / 1024.0 << " kb/s";
+		screen->DrawText(textcolor, x, y + fontheight * (i + 3), buf.str().c_str());
+	}
+}
+
 void NetGraph::draw()
 {
 	static const int textcolor = CR_GREY;
@@ -210,6 +440,42 @@ void NetGraph::draw()
 
 	drawTrafficIn(mX, mY + 128 + fontheight);
 	drawTrafficOut(mX, mY + 128 + fontheight * 3);
+
+	drawMessages(mX, mY + 128 + fontheight * 5);
+}
+
+//
+// netprofile
+//
+// Prints the bandwidth used by each type of message from the server.
+// "netprofile reset" clears the statistics, "netprofile csv <file>" writes
+// them to a CSV file every second and "netprofile csv" stops writing them.
+//
+BEGIN_COMMAND (netprofile)
+{
+	if (argc > 1 && stricmp(argv[1], "reset") == 0)
+	{
+		netgraph.resetMessageStats();
+		return;
+	}
+
+	if (argc > 1 && stricmp(argv[1], "csv") == 0)
+	{
+		if (argc < 3)
+		{
+			netgraph.stopMessageLog();
+			Printf(PRINT_HIGH, "netprofile: stopped writing CSV\n");
+		}
+		else if (netgraph.startMessageLog(argv[2]))
+			Printf(PRINT_HIGH, "netprofile: writing CSV to %s\n", argv[2]);
+		else
+			Printf(PRINT_HIGH, "netprofile: could not open %s\n", argv[2]);
+
+		return;
+	}
+
+	netgraph.printMessageReport();
 }
+END_COMMAND (netprofile)
 
 VERSION_CONTROL (cl_netgraph_cpp, "$Id$")
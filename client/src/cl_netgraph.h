@@ -25,6 +25,12 @@
 #ifndef __CL_NETGRAPH_H__
 #define __CL_NETGRAPH_H__
 
+#include <stdio.h>
+#include <string>
+
+#include "doomtype.h"
+#include "i_net.h"
+
 class NetGraph
 {
 public:
@@ -37,11 +43,37 @@ public:
 	void addTrafficOut(int val);
 	void draw();
 
+	// [Odamex] Per message type statistics
+	void addMessage(int cmd, int bytes, dtime_t parsetime);
+	void addPacket(int size, int uncompressedsize);
+	void printMessageReport();
+	void resetMessageStats();
+	bool startMessageLog(const std::string &filename);
+	void stopMessageLog();
+
 private:
+	typedef struct
+	{
+		int		count;
+		int		bytes;
+		dtime_t	parsetime;
+	} messagestats_t;
+
+	typedef struct
+	{
+		int		count;
+		int		bytes;
+		int		uncompressedbytes;
+	} packetstats_t;
+
+	void updateMessageSecond();
+	void writeMessageLog();
+
 	void drawWorldIndexSync(int x, int y);
 	void drawMispredictions(int x, int y);
 	void drawTrafficIn(int x, int y);
 	void drawTrafficOut(int x, int y);
+	void drawMessages(int x, int y);
 
 	static const int BAR_HEIGHT_WORLD_INDEX = 4;
 	static const int BAR_WIDTH_WORLD_INDEX = 2;
@@ -62,6 +94,21 @@ private:
 	int		mInterpolation;
 	int		mTrafficIn[NetGraph::MAX_HISTORY_TICS];
 	int		mTrafficOut[NetGraph::MAX_HISTORY_TICS];
+
+	static const int MAX_DRAWN_MESSAGES = 6;
+
+	// statistics for the second being measured, the last full second and
+	// everything since the statistics were reset
+	int				mMessageSecond;
+	int				mMessageStartTic;
+	messagestats_t	mMessages[svc_max];
+	messagestats_t	mLastMessages[svc_max];
+	messagestats_t	mTotalMessages[svc_max];
+	packetstats_t	mPackets;
+	packetstats_t	mLastPackets;
+	packetstats_t	mTotalPackets;
+
+	FILE*			mMessageLog;
 };
 
 #endif // __CL_NETGRAPH_H__
@@ -54,6 +54,18 @@ void P_CalcHeight (player_t *player);
 extern NetCommand localcmds[MAXSAVETICS];
 static PlayerSnapshot cl_savedsnaps[MAXSAVETICS];
 
+// [Odamex] The predicted state of the player at the end of each tic.  When
+// the server confirms a tic was predicted correctly, prediction continues
+// from the most recent of these instead of replaying every tic again.
+static PlayerSnapshot cl_predictedsnaps[MAXSAVETICS];
+
+// Statistics for the netpredstats command
+static int pred_frames = 0;
+static int pred_fullreplays = 0;
+static int pred_replayedtics = 0;
+static int pred_maxreplayedtics = 0;
+static int pred_lastreplayedtics = 0;
+
 bool predicting;
 
 extern std::map<unsigned short, SectorSnapshotManager> sector_snaps;
@@ -263,6 +275,35 @@ static void CL_PredictLocalPlayer(int predtic)
 	player->mo->RunThink();
 }
 
+//
+// CL_ClearPredictedSnapshots
+//
+// Discards the predicted states of the player so that the next prediction
+// replays every tic from the last position received from the server.
+//
+static void CL_ClearPredictedSnapshots()
+{
+	for (int i = 0; i < MAXSAVETICS; i++)
+		cl_predictedsnaps[i] = PlayerSnapshot();
+}
+
+//
+// CL_PredictedSnapshotMatches
+//
+// Returns true if the player's state received from the server for the tic
+// predtic matches the state that was predicted for that tic.
+//
+static bool CL_PredictedSnapshotMatches(const PlayerSnapshot &snap, int predtic)
+{
+	const PlayerSnapshot &predsnap = cl_predictedsnaps[predtic % MAXSAVETICS];
+	if (!predsnap.isValid() || predsnap.getTime() != predtic)
+		return false;
+
+	return predsnap.getX() == snap.getX() && predsnap.getY() == snap.getY() &&
+		   predsnap.getZ() == snap.getZ() && predsnap.getMomX() == snap.getMomX() &&
+		   predsnap.getMomY() == snap.getMomY() && predsnap.getMomZ() == snap.getMomZ();
+}
+
 //
 // CL_PredictWorld
 //
@@ -312,20 +353,61 @@ void CL_PredictWorld(void)
 	if (cl_predictsectors)
 		CL_ResetSectors();
 
-	// Move the client to the last position received from the sever
 	int snaptime = p->snapshots.getMostRecentTime();
 	PlayerSnapshot snap = p->snapshots.getSnapshot(snaptime);
-	snap.toPlayer(p);
+
+	if (!snap.isContinuous())
+		CL_ClearPredictedSnapshots();
+
+	// [Odamex] If the server agrees with what was predicted for predtic, the
+	// tics predicted since then are still correct and only the tics after
+	// the most recently predicted one need to be run.  The state of moving
+	// sectors isn't saved, so predicting sectors requires a full replay.
+	bool incremental = cl_predictlocalplayer &&
+			!(cl_predictsectors && !movingsectors.empty()) &&
+			CL_PredictedSnapshotMatches(snap, predtic);
+
+	if (incremental)
+	{
+		int lasttic = gametic - 1;
+		while (lasttic > predtic &&
+			   cl_predictedsnaps[lasttic % MAXSAVETICS].getTime() != lasttic)
+			lasttic--;
+
+		predtic = lasttic;
+		cl_predictedsnaps[predtic % MAXSAVETICS].toPlayer(p);
+	}
+	else
+	{
+		// Move the client to the last position received from the sever
+		snap.toPlayer(p);
+
+		PlayerSnapshot servsnap(predtic, p);
+		cl_predictedsnaps[predtic % MAXSAVETICS] = servsnap;
+	}
 
 	if (cl_predictlocalplayer)
 	{
+		int replayedtics = 0;
+
 		while (++predtic < gametic)
 		{
 			if (cl_predictsectors)
 				CL_PredictSectors(predtic);
-			CL_PredictLocalPlayer(predtic);  
+			CL_PredictLocalPlayer(predtic);
+
+			PlayerSnapshot predsnap(predtic, p);
+			cl_predictedsnaps[predtic % MAXSAVETICS] = predsnap;
+			replayedtics++;
 		}
 
+		pred_frames++;
+		if (!incremental)
+			pred_fullreplays++;
+		pred_replayedtics += replayedtics;
+		pred_lastreplayedtics = replayedtics;
+		pred_maxreplayedtics = MAX(pred_maxreplayedtics, replayedtics);
+
 		// If the player didn't just spawn or teleport, nudge the player from
 		// his position last tic to this new corrected position.  This smooths the
 		// view when there's a misprediction.
@@ -358,6 +440,24 @@ void CL_PredictWorld(void)
 	CL_PredictLocalPlayer(gametic);
 }
 
+BEGIN_COMMAND (netpredstats)
+{
+	if (argc > 1 && stricmp(argv[1], "reset") == 0)
+	{
+		pred_frames = pred_fullreplays = 0;
+		pred_replayedtics = pred_maxreplayedtics = pred_lastreplayedtics = 0;
+		return;
+	}
+
+	Printf(PRINT_HIGH, "%d frames predicted, %d with a full replay\n",
+			pred_frames, pred_fullreplays);
+	Printf(PRINT_HIGH, "%d tics replayed (%.2f per frame, %d max, %d last frame)\n",
+			pred_replayedtics,
+			pred_frames ? float(pred_replayedtics) / float(pred_frames) : 0.0f,
+			pred_maxreplayedtics, pred_lastreplayedtics);
+}
+END_COMMAND (netpredstats)
+
 
 VERSION_CONTROL (cl_pred_cpp, "$Id$")
 
@@ -220,7 +220,7 @@ void D_DisplayTicker()
 //
 void D_Display()
 {
-	if (nodrawers || I_IsHeadless())
+	if (nodrawers || (I_IsHeadless() && !timingnetdemo_render))
 		return; 				// for comparative timing / profiling
 
 	BEGIN_STAT(D_Display);
@@ -925,6 +925,14 @@ void D_DoomMain()
 		CL_NetDemoPlay(filename);
 	}
 
+	// [Odamex] play a netdemo headless as fast as possible and report timings
+	p = Args.CheckParm("-timenetdemo");
+	if (p && p < Args.NumArgs() - 1)
+	{
+		std::string filename = Args.GetArg(p + 1);
+		CL_NetDemoTime(filename);
+	}
+
 	// --- initialization complete ---
 
 	Printf_Bold("\n\35\36\36\36\36 Odamex Client Initialized \36\36\36\36\37\n");
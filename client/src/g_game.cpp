@@ -831,6 +831,7 @@ void P_MovePlayer (player_t *player);
 void P_CalcHeight (player_t *player);
 void P_DeathThink (player_t *player);
 void CL_SimulateWorld();
+void CL_SimulateActors();
 //
 // G_Ticker
 // Make ticcmd_ts for the players.
@@ -941,7 +942,10 @@ void G_Ticker (void)
 
 	if(netdemo.isPlaying())
 	{
+		dtime_t parse_start = timingnetdemo ? I_GetTime() : 0;
 		netdemo.readMessages(&net_message);
+		if (timingnetdemo)
+			CL_AddNetDemoTime(NETDEMO_BENCH_PARSE, I_GetTime() - parse_start);
 	}
 
 	if (connected && !simulated_connection)
@@ -1048,6 +1052,8 @@ void G_Ticker (void)
     }
 
 	// do main actions
+	dtime_t sim_start = timingnetdemo ? I_GetTime() : 0;
+
 	switch (gamestate)
 	{
 	case GS_LEVEL:
@@ -1070,6 +1076,8 @@ void G_Ticker (void)
 			CL_PredictWorld();
 		}
 		P_Ticker ();
+		if (clientside && !serverside)
+			CL_SimulateActors();
 		ST_Ticker ();
 		AM_Ticker ();
 		break;
@@ -1090,6 +1098,9 @@ void G_Ticker (void)
 	default:
 		break;
 	}
+
+	if (timingnetdemo)
+		CL_AddNetDemoTime(NETDEMO_BENCH_SIM, I_GetTime() - sim_start);
 }
 
 
@@ -529,15 +529,10 @@ void G_DoLoadLevel (int position)
 		it->points = 0;
 	}
 
-	// initialize the msecnode_t freelist.					phares 3/25/98
-	// any nodes in the freelist are gone by now, cleared
-	// by Z_FreeTags() when the previous level ended or player
-	// died.
+	// the msecnode_t freelist is cleared by P_ClearSecnodes()
+	// in P_SetupLevel, so no actor may still point into it.
 
 	{
-		extern msecnode_t *headsecnode; // phares 3/25/98
-		headsecnode = NULL;
-
 		// denis - todo - wtf is this crap?
 		// [RH] Need to prevent the AActor destructor from trying to
 		//		free the nodes
@@ -668,7 +668,8 @@ void R_Subsector (int num)
 	frontsector = R_FakeFlat(frontsector, &tempsec, &floorlightlevel,
 						   &ceilinglightlevel, false);	// killough 4/11/98
 
-	basecolormap = frontsector->colormap->maps;
+	// [Odamex] remake the shaderef so that it picks up the view blend
+	basecolormap = frontsector->colormap->maps.with(0);
 
 	ceilingplane = P_CeilingHeight(camera) > viewz ||
 		frontsector->ceilingpic == skyflatnum ||
@@ -43,6 +43,7 @@
 
 #include "gi.h"
 #include "v_text.h"
+#include "c_dispatch.h"
 
 #undef RANGECHECK
 
@@ -91,8 +92,15 @@ void (*R_FillTranslucentSpan)(void);
 // Possibly vectorized functions:
 void (*R_DrawSpanD)(void);
 void (*R_DrawSlopeSpanD)(void);
+void (*R_FillTranslucentSpanD)(void);
+drawcolumnquadfunc_t R_DrawColumnQuadD;
+drawcolumnquadfunc_t R_DrawTranslucentColumnQuadD;
 void (*r_dimpatchD)(IWindowSurface* surface, argb_t color, int alpha, int x1, int y1, int w, int h);
 
+// [Odamex] surfaces can be blitted before r_optimize is set
+void (*r_blitrowPD)(argb_t* dest, const palindex_t* source, const argb_t* palette, int count, fixed_t xstep) = r_blitrowPD_c;
+void (*r_blitrowDD)(argb_t* dest, const argb_t* source, int count, fixed_t xstep) = r_blitrowDD_c;
+
 // ============================================================================
 //
 // Fuzz Table
@@ -591,6 +599,112 @@ static forceinline void R_DrawColumnGeneric(PIXEL_T* dest, const drawcolumn_t& d
 }
 
 
+//
+// R_DrawColumnPart
+//
+// Draws the rows yl through yh of a column using the given drawer.
+//
+static void R_DrawColumnPart(const drawcolumn_t& drawcolumn, int yl, int yh, drawcolumnfunc_t func)
+{
+	if (yl > yh)
+		return;
+
+	drawcolumn_t part = drawcolumn;
+	part.texturefrac += (yl - drawcolumn.yl) * drawcolumn.iscale;
+	part.yl = yl;
+	part.yh = yh;
+	func(part);
+}
+
+//
+// R_DrawColumnQuadEnds
+//
+// [Odamex] Prepares four adjacent columns for drawing together. The rows the
+// four columns have in common are returned in top and bottom, and the rows
+// outside of them are drawn a column at a time using func. Returns false if
+// the columns have no rows in common, in which case they have all been drawn.
+//
+bool R_DrawColumnQuadEnds(const drawcolumn_t* const* columns, drawcolumnfunc_t func, int& top, int& bottom)
+{
+	top = MAX(MAX(columns[0]->yl, columns[1]->yl), MAX(columns[2]->yl, columns[3]->yl));
+	bottom = MIN(MIN(columns[0]->yh, columns[1]->yh), MIN(columns[2]->yh, columns[3]->yh));
+
+	if (top > bottom)
+	{
+		for (int i = 0; i < 4; i++)
+			func(*columns[i]);
+		return false;
+	}
+
+	for (int i = 0; i < 4; i++)
+	{
+		R_DrawColumnPart(*columns[i], columns[i]->yl, top - 1, func);
+		R_DrawColumnPart(*columns[i], bottom + 1, columns[i]->yh, func);
+	}
+
+	return true;
+}
+
+
+//
+// R_DrawColumnQuadGeneric
+//
+// Templated version of a function to draw four adjacent columns at once,
+// writing a row of four pixels at a time. The columns must use textures whose
+// heights are a power-of-2. Each pixel is the same as it would be if the
+// columns were drawn separately with R_DrawColumnGeneric.
+//
+template<typename PIXEL_T, typename COLORFUNC>
+static forceinline void R_DrawColumnQuadGeneric(const drawcolumn_t* const* columns, drawcolumnfunc_t func)
+{
+	int top, bottom;
+	if (!R_DrawColumnQuadEnds(columns, func, top, bottom))
+		return;
+
+	const drawcolumn_t& dc0 = *columns[0];
+	const drawcolumn_t& dc1 = *columns[1];
+	const drawcolumn_t& dc2 = *columns[2];
+	const drawcolumn_t& dc3 = *columns[3];
+
+	PIXEL_T* dest = (PIXEL_T*)dc0.destination + top * dc0.pitch_in_pixels + dc0.x;
+	const int pitch = dc0.pitch_in_pixels;
+	int count = bottom - top + 1;
+
+	const palindex_t* source0 = dc0.source;
+	const palindex_t* source1 = dc1.source;
+	const palindex_t* source2 = dc2.source;
+	const palindex_t* source3 = dc3.source;
+
+	const int mask0 = (dc0.textureheight >> FRACBITS) - 1;
+	const int mask1 = (dc1.textureheight >> FRACBITS) - 1;
+	const int mask2 = (dc2.textureheight >> FRACBITS) - 1;
+	const int mask3 = (dc3.textureheight >> FRACBITS) - 1;
+
+	fixed_t frac0 = dc0.texturefrac + (top - dc0.yl) * dc0.iscale;
+	fixed_t frac1 = dc1.texturefrac + (top - dc1.yl) * dc1.iscale;
+	fixed_t frac2 = dc2.texturefrac + (top - dc2.yl) * dc2.iscale;
+	fixed_t frac3 = dc3.texturefrac + (top - dc3.yl) * dc3.iscale;
+
+	COLORFUNC colorfunc0(dc0);
+	COLORFUNC colorfunc1(dc1);
+	COLORFUNC colorfunc2(dc2);
+	COLORFUNC colorfunc3(dc3);
+
+	do {
+		colorfunc0(source0[(frac0 >> FRACBITS) & mask0], dest + 0);
+		colorfunc1(source1[(frac1 >> FRACBITS) & mask1], dest + 1);
+		colorfunc2(source2[(frac2 >> FRACBITS) & mask2], dest + 2);
+		colorfunc3(source3[(frac3 >> FRACBITS) & mask3], dest + 3);
+
+		frac0 += dc0.iscale;
+		frac1 += dc1.iscale;
+		frac2 += dc2.iscale;
+		frac3 += dc3.iscale;
+		dest += pitch;
+	} while (--count);
+}
+
+
 //
 // R_FillSpanGeneric
 //
@@ -935,7 +1049,7 @@ private:
 //
 // ----------------------------------------------------------------------------
 
-#define FB_COLDEST_P ((palindex_t*)dcol.destination + dcol.yl * dcol.pitch_in_pixels + dcol.x)
+#define FB_COLDEST_P(dc) ((palindex_t*)(dc).destination + (dc).yl * (dc).pitch_in_pixels + (dc).x)
 
 //
 // R_FillColumnP
@@ -943,9 +1057,14 @@ private:
 // Fills a column in the 8bpp palettized screen buffer with a solid color,
 // determined by dcol.color. Performs no shading.
 //
+void R_FillColumnP(const drawcolumn_t& drawcolumn)
+{
+	R_FillColumnGeneric<palindex_t, PaletteFunc>(FB_COLDEST_P(drawcolumn), drawcolumn);
+}
+
 void R_FillColumnP()
 {
-	R_FillColumnGeneric<palindex_t, PaletteFunc>(FB_COLDEST_P, dcol);
+	R_FillColumnP(dcol);
 }
 
 //
@@ -954,9 +1073,14 @@ void R_FillColumnP()
 // Renders a column to the 8bpp palettized screen buffer from the source buffer
 // dcol.source and scaled by dcol.iscale. Shading is performed using dcol.colormap.
 //
+void R_DrawColumnP(const drawcolumn_t& drawcolumn)
+{
+	R_DrawColumnGeneric<palindex_t, PaletteColormapFunc>(FB_COLDEST_P(drawcolumn), drawcolumn);
+}
+
 void R_DrawColumnP()
 {
-	R_DrawColumnGeneric<palindex_t, PaletteColormapFunc>(FB_COLDEST_P, dcol);
+	R_DrawColumnP(dcol);
 }
 
 //
@@ -967,7 +1091,7 @@ void R_DrawColumnP()
 //
 void R_StretchColumnP()
 {
-	R_DrawColumnGeneric<palindex_t, PaletteFunc>(FB_COLDEST_P, dcol);
+	R_DrawColumnGeneric<palindex_t, PaletteFunc>(FB_COLDEST_P(dcol), dcol);
 }
 
 //
@@ -985,7 +1109,7 @@ void R_DrawFuzzColumnP()
 	if (dcol.yh >= viewheight - 1)
 		dcol.yh = viewheight - 2;
 
-	R_FillColumnGeneric<palindex_t, PaletteFuzzyFunc>(FB_COLDEST_P, dcol);
+	R_FillColumnGeneric<palindex_t, PaletteFuzzyFunc>(FB_COLDEST_P(dcol), dcol);
 	fuzztable.incrementColumn();
 }
 
@@ -997,9 +1121,14 @@ void R_DrawFuzzColumnP()
 // translucency is controlled by dcol.translevel. Shading is performed using
 // dcol.colormap.
 //
+void R_DrawTranslucentColumnP(const drawcolumn_t& drawcolumn)
+{
+	R_DrawColumnGeneric<palindex_t, PaletteTranslucentColormapFunc>(FB_COLDEST_P(drawcolumn), drawcolumn);
+}
+
 void R_DrawTranslucentColumnP()
 {
-	R_DrawColumnGeneric<palindex_t, PaletteTranslucentColormapFunc>(FB_COLDEST_P, dcol);
+	R_DrawTranslucentColumnP(dcol);
 }
 
 //
@@ -1009,9 +1138,14 @@ void R_DrawTranslucentColumnP()
 // from the source buffer dcol.source and scaled by dcol.iscale. The translation
 // table is supplied by dcol.translation. Shading is performed using dcol.colormap.
 //
+void R_DrawTranslatedColumnP(const drawcolumn_t& drawcolumn)
+{
+	R_DrawColumnGeneric<palindex_t, PaletteTranslatedColormapFunc>(FB_COLDEST_P(drawcolumn), drawcolumn);
+}
+
 void R_DrawTranslatedColumnP()
 {
-	R_DrawColumnGeneric<palindex_t, PaletteTranslatedColormapFunc>(FB_COLDEST_P, dcol);
+	R_DrawTranslatedColumnP(dcol);
 }
 
 //
@@ -1023,9 +1157,58 @@ void R_DrawTranslatedColumnP()
 // translucency is controlled by dcol.translevel. Shading is performed using
 // dcol.colormap.
 //
+void R_DrawTlatedLucentColumnP(const drawcolumn_t& drawcolumn)
+{
+	R_DrawColumnGeneric<palindex_t, PaletteTranslatedTranslucentColormapFunc>(FB_COLDEST_P(drawcolumn), drawcolumn);
+}
+
 void R_DrawTlatedLucentColumnP()
 {
-	R_DrawColumnGeneric<palindex_t, PaletteTranslatedTranslucentColormapFunc>(FB_COLDEST_P, dcol);
+	R_DrawTlatedLucentColumnP(dcol);
+}
+
+//
+// R_DrawColumnQuadP
+//
+// Renders four adjacent columns to the 8bpp palettized screen buffer as
+// R_DrawColumnP would.
+//
+void R_DrawColumnQuadP(const drawcolumn_t* const* columns)
+{
+	R_DrawColumnQuadGeneric<palindex_t, PaletteColormapFunc>(columns, R_DrawColumnP);
+}
+
+//
+// R_DrawTranslucentColumnQuadP
+//
+// Renders four adjacent columns to the 8bpp palettized screen buffer as
+// R_DrawTranslucentColumnP would.
+//
+void R_DrawTranslucentColumnQuadP(const drawcolumn_t* const* columns)
+{
+	R_DrawColumnQuadGeneric<palindex_t, PaletteTranslucentColormapFunc>(columns, R_DrawTranslucentColumnP);
+}
+
+//
+// R_DrawTranslatedColumnQuadP
+//
+// Renders four adjacent columns to the 8bpp palettized screen buffer as
+// R_DrawTranslatedColumnP would.
+//
+void R_DrawTranslatedColumnQuadP(const drawcolumn_t* const* columns)
+{
+	R_DrawColumnQuadGeneric<palindex_t, PaletteTranslatedColormapFunc>(columns, R_DrawTranslatedColumnP);
+}
+
+//
+// R_DrawTlatedLucentColumnQuadP
+//
+// Renders four adjacent columns to the 8bpp palettized screen buffer as
+// R_DrawTlatedLucentColumnP would.
+//
+void R_DrawTlatedLucentColumnQuadP(const drawcolumn_t* const* columns)
+{
+	R_DrawColumnQuadGeneric<palindex_t, PaletteTranslatedTranslucentColormapFunc>(columns, R_DrawTlatedLucentColumnP);
 }
 
 
@@ -1035,7 +1218,7 @@ void R_DrawTlatedLucentColumnP()
 //
 // ----------------------------------------------------------------------------
 
-#define FB_SPANDEST_P ((palindex_t*)dspan.destination + dspan.y * dspan.pitch_in_pixels + dspan.x1)
+#define FB_SPANDEST_P(ds) ((palindex_t*)(ds).destination + (ds).y * (ds).pitch_in_pixels + (ds).x1)
 
 //
 // R_FillSpanP
@@ -1043,9 +1226,14 @@ void R_DrawTlatedLucentColumnP()
 // Fills a span in the 8bpp palettized screen buffer with a solid color,
 // determined by dspan.color. Performs no shading.
 //
+void R_FillSpanP(const drawspan_t& drawspan)
+{
+	R_FillSpanGeneric<palindex_t, PaletteFunc>(FB_SPANDEST_P(drawspan), drawspan);
+}
+
 void R_FillSpanP()
 {
-	R_FillSpanGeneric<palindex_t, PaletteFunc>(FB_SPANDEST_P, dspan);
+	R_FillSpanP(dspan);
 }
 
 //
@@ -1055,9 +1243,14 @@ void R_FillSpanP()
 // determined by dspan.color using translucency. Shading is performed 
 // using dspan.colormap.
 //
+void R_FillTranslucentSpanP(const drawspan_t& drawspan)
+{
+	R_FillSpanGeneric<palindex_t, PaletteTranslucentColormapFunc>(FB_SPANDEST_P(drawspan), drawspan);
+}
+
 void R_FillTranslucentSpanP()
 {
-	R_FillSpanGeneric<palindex_t, PaletteTranslucentColormapFunc>(FB_SPANDEST_P, dspan);
+	R_FillTranslucentSpanP(dspan);
 }
 
 //
@@ -1066,9 +1259,14 @@ void R_FillTranslucentSpanP()
 // Renders a span for a level plane to the 8bpp palettized screen buffer from
 // the source buffer dspan.source. Shading is performed using dspan.colormap.
 //
+void R_DrawSpanP(const drawspan_t& drawspan)
+{
+	R_DrawLevelSpanGeneric<palindex_t, PaletteColormapFunc>(FB_SPANDEST_P(drawspan), drawspan);
+}
+
 void R_DrawSpanP()
 {
-	R_DrawLevelSpanGeneric<palindex_t, PaletteColormapFunc>(FB_SPANDEST_P, dspan);
+	R_DrawSpanP(dspan);
 }
 
 //
@@ -1079,7 +1277,7 @@ void R_DrawSpanP()
 //
 void R_DrawSlopeSpanP()
 {
-	R_DrawSlopedSpanGeneric<palindex_t, PaletteSlopeColormapFunc>(FB_SPANDEST_P, dspan);
+	R_DrawSlopedSpanGeneric<palindex_t, PaletteSlopeColormapFunc>(FB_SPANDEST_P(dspan), dspan);
 }
 
 
@@ -1232,7 +1430,7 @@ private:
 //
 // ----------------------------------------------------------------------------
 
-#define FB_COLDEST_D ((argb_t*)dcol.destination + dcol.yl * dcol.pitch_in_pixels + dcol.x)
+#define FB_COLDEST_D(dc) ((argb_t*)(dc).destination + (dc).yl * (dc).pitch_in_pixels + (dc).x)
 
 //
 // R_FillColumnD
@@ -1242,7 +1440,7 @@ private:
 //
 void R_FillColumnD()
 {
-	R_FillColumnGeneric<argb_t, DirectFunc>(FB_COLDEST_D, dcol);
+	R_FillColumnGeneric<argb_t, DirectFunc>(FB_COLDEST_D(dcol), dcol);
 }
 
 //
@@ -1251,9 +1449,14 @@ void R_FillColumnD()
 // Renders a column to the 32bpp ARGB8888 screen buffer from the source buffer
 // dcol.source and scaled by dcol.iscale. Shading is performed using dcol.colormap.
 //
+void R_DrawColumnD(const drawcolumn_t& drawcolumn)
+{
+	R_DrawColumnGeneric<argb_t, DirectColormapFunc>(FB_COLDEST_D(drawcolumn), drawcolumn);
+}
+
 void R_DrawColumnD()
 {
-	R_DrawColumnGeneric<argb_t, DirectColormapFunc>(FB_COLDEST_D, dcol);
+	R_DrawColumnD(dcol);
 }
 
 //
@@ -1271,7 +1474,7 @@ void R_DrawFuzzColumnD()
 	if (dcol.yh >= viewheight - 1)
 		dcol.yh = viewheight - 2;
 
-	R_FillColumnGeneric<argb_t, DirectFuzzyFunc>(FB_COLDEST_D, dcol);
+	R_FillColumnGeneric<argb_t, DirectFuzzyFunc>(FB_COLDEST_D(dcol), dcol);
 	fuzztable.incrementColumn();
 }
 
@@ -1283,9 +1486,14 @@ void R_DrawFuzzColumnD()
 // translucency is controlled by dcol.translevel. Shading is performed using
 // dcol.colormap.
 //
+void R_DrawTranslucentColumnD(const drawcolumn_t& drawcolumn)
+{
+	R_DrawColumnGeneric<argb_t, DirectTranslucentColormapFunc>(FB_COLDEST_D(drawcolumn), drawcolumn);
+}
+
 void R_DrawTranslucentColumnD()
 {
-	R_DrawColumnGeneric<argb_t, DirectTranslucentColormapFunc>(FB_COLDEST_D, dcol);
+	R_DrawTranslucentColumnD(dcol);
 }
 
 //
@@ -1295,9 +1503,14 @@ void R_DrawTranslucentColumnD()
 // from the source buffer dcol.source and scaled by dcol.iscale. The translation
 // table is supplied by dcol.translation. Shading is performed using dcol.colormap.
 //
+void R_DrawTranslatedColumnD(const drawcolumn_t& drawcolumn)
+{
+	R_DrawColumnGeneric<argb_t, DirectTranslatedColormapFunc>(FB_COLDEST_D(drawcolumn), drawcolumn);
+}
+
 void R_DrawTranslatedColumnD()
 {
-	R_DrawColumnGeneric<argb_t, DirectTranslatedColormapFunc>(FB_COLDEST_D, dcol);
+	R_DrawTranslatedColumnD(dcol);
 }
 
 //
@@ -1309,9 +1522,58 @@ void R_DrawTranslatedColumnD()
 // translucency is controlled by dcol.translevel. Shading is performed using
 // dcol.colormap.
 //
+void R_DrawTlatedLucentColumnD(const drawcolumn_t& drawcolumn)
+{
+	R_DrawColumnGeneric<argb_t, DirectTranslatedTranslucentColormapFunc>(FB_COLDEST_D(drawcolumn), drawcolumn);
+}
+
 void R_DrawTlatedLucentColumnD()
 {
-	R_DrawColumnGeneric<argb_t, DirectTranslatedTranslucentColormapFunc>(FB_COLDEST_D, dcol);
+	R_DrawTlatedLucentColumnD(dcol);
+}
+
+//
+// R_DrawColumnQuadD
+//
+// Renders four adjacent columns to the 32bpp ARGB8888 screen buffer as
+// R_DrawColumnD would.
+//
+void R_DrawColumnQuadD_c(const drawcolumn_t* const* columns)
+{
+	R_DrawColumnQuadGeneric<argb_t, DirectColormapFunc>(columns, R_DrawColumnD);
+}
+
+//
+// R_DrawTranslucentColumnQuadD
+//
+// Renders four adjacent columns to the 32bpp ARGB8888 screen buffer as
+// R_DrawTranslucentColumnD would.
+//
+void R_DrawTranslucentColumnQuadD_c(const drawcolumn_t* const* columns)
+{
+	R_DrawColumnQuadGeneric<argb_t, DirectTranslucentColormapFunc>(columns, R_DrawTranslucentColumnD);
+}
+
+//
+// R_DrawTranslatedColumnQuadD
+//
+// Renders four adjacent columns to the 32bpp ARGB8888 screen buffer as
+// R_DrawTranslatedColumnD would.
+//
+void R_DrawTranslatedColumnQuadD(const drawcolumn_t* const* columns)
+{
+	R_DrawColumnQuadGeneric<argb_t, DirectTranslatedColormapFunc>(columns, R_DrawTranslatedColumnD);
+}
+
+//
+// R_DrawTlatedLucentColumnQuadD
+//
+// Renders four adjacent columns to the 32bpp ARGB8888 screen buffer as
+// R_DrawTlatedLucentColumnD would.
+//
+void R_DrawTlatedLucentColumnQuadD(const drawcolumn_t* const* columns)
+{
+	R_DrawColumnQuadGeneric<argb_t, DirectTranslatedTranslucentColormapFunc>(columns, R_DrawTlatedLucentColumnD);
 }
 
 
@@ -1321,7 +1583,7 @@ void R_DrawTlatedLucentColumnD()
 //
 // ----------------------------------------------------------------------------
 
-#define FB_SPANDEST_D ((argb_t*)dspan.destination + dspan.y * dspan.pitch_in_pixels + dspan.x1)
+#define FB_SPANDEST_D(ds) ((argb_t*)(ds).destination + (ds).y * (ds).pitch_in_pixels + (ds).x1)
 
 //
 // R_FillSpanD
@@ -1331,7 +1593,7 @@ void R_DrawTlatedLucentColumnD()
 //
 void R_FillSpanD()
 {
-	R_FillSpanGeneric<argb_t, DirectFunc>(FB_SPANDEST_D, dspan);
+	R_FillSpanGeneric<argb_t, DirectFunc>(FB_SPANDEST_D(dspan), dspan);
 }
 
 //
@@ -1341,9 +1603,14 @@ void R_FillSpanD()
 // determined by dspan.color using translucency. Shading is performed 
 // using dspan.colormap.
 //
-void R_FillTranslucentSpanD()
+void R_FillTranslucentSpanD_c(const drawspan_t& drawspan)
 {
-	R_FillSpanGeneric<argb_t, DirectTranslucentColormapFunc>(FB_SPANDEST_D, dspan);
+	R_FillSpanGeneric<argb_t, DirectTranslucentColormapFunc>(FB_SPANDEST_D(drawspan), drawspan);
+}
+
+void R_FillTranslucentSpanD_c()
+{
+	R_FillTranslucentSpanD_c(dspan);
 }
 
 //
@@ -1352,9 +1619,14 @@ void R_FillTranslucentSpanD()
 // Renders a span for a level plane to the 32bpp ARGB8888 screen buffer from
 // the source buffer dspan.source. Shading is performed using dspan.colormap.
 //
+void R_DrawSpanD_c(const drawspan_t& drawspan)
+{
+	R_DrawLevelSpanGeneric<argb_t, DirectColormapFunc>(FB_SPANDEST_D(drawspan), drawspan);
+}
+
 void R_DrawSpanD_c()
 {
-	R_DrawLevelSpanGeneric<argb_t, DirectColormapFunc>(FB_SPANDEST_D, dspan);
+	R_DrawSpanD_c(dspan);
 }
 
 //
@@ -1365,7 +1637,7 @@ void R_DrawSpanD_c()
 //
 void R_DrawSlopeSpanD_c()
 {
-	R_DrawSlopedSpanGeneric<argb_t, DirectSlopeColormapFunc>(FB_SPANDEST_D, dspan);
+	R_DrawSlopedSpanGeneric<argb_t, DirectSlopeColormapFunc>(FB_SPANDEST_D(dspan), dspan);
 }
 
 
@@ -1448,7 +1720,8 @@ enum r_optimize_kind {
 	OPTIMIZE_NONE,
 	OPTIMIZE_SSE2,
 	OPTIMIZE_MMX,
-	OPTIMIZE_ALTIVEC
+	OPTIMIZE_ALTIVEC,
+	OPTIMIZE_AVX2
 };
 
 static r_optimize_kind optimize_kind = OPTIMIZE_NONE;
@@ -1461,6 +1734,7 @@ static const char *get_optimization_name(r_optimize_kind kind)
 		case OPTIMIZE_SSE2:    return "sse2";
 		case OPTIMIZE_MMX:     return "mmx";
 		case OPTIMIZE_ALTIVEC: return "altivec";
+		case OPTIMIZE_AVX2:    return "avx2";
 		case OPTIMIZE_NONE:
 		default:
 			return "none";
@@ -1488,6 +1762,20 @@ static void print_optimizations()
 	Printf(PRINT_HIGH, "r_optimize detected \"%s\"\n", get_optimization_name_list(false).c_str());
 }
 
+//
+// R_CPUHasAVX2
+//
+// [Odamex] SDL only reports AVX2 support from version 2.0.4 onwards.
+//
+static bool R_CPUHasAVX2()
+{
+	#if SDL_VERSION_ATLEAST(2, 0, 4)
+	return SDL_HasAVX2();
+	#else
+	return false;
+	#endif
+}
+
 static bool detect_optimizations()
 {
 	if (!optimizations_available.empty())
@@ -1511,6 +1799,10 @@ static bool detect_optimizations()
 	if (SDL_HasAltiVec())
 		optimizations_available.push_back(OPTIMIZE_ALTIVEC);
 	#endif
+	#ifdef ODA_HAVE_AVX2
+	if (R_CPUHasAVX2())
+		optimizations_available.push_back(OPTIMIZE_AVX2);
+	#endif
 
 	return true;
 }
@@ -1545,6 +1837,8 @@ CVAR_FUNC_IMPL(r_optimize)
 		optimize_kind = OPTIMIZE_MMX;
 	else if (stricmp(val, "altivec") == 0 && R_IsOptimizationAvailable(OPTIMIZE_ALTIVEC))
 		optimize_kind = OPTIMIZE_ALTIVEC;
+	else if (stricmp(val, "avx2") == 0 && R_IsOptimizationAvailable(OPTIMIZE_AVX2))
+		optimize_kind = OPTIMIZE_AVX2;
 	else if (stricmp(val, "detect") == 0)
 		// Default to the most preferred:
 		optimize_kind = optimizations_available.back();
@@ -1587,14 +1881,42 @@ void R_InitVectorizedDrawers()
 		// [SL] set defaults to non-vectorized drawers
 		R_DrawSpanD				= R_DrawSpanD_c;
 		R_DrawSlopeSpanD		= R_DrawSlopeSpanD_c;
+		R_FillTranslucentSpanD	= R_FillTranslucentSpanD_c;
 		r_dimpatchD             = r_dimpatchD_c;
+		r_blitrowPD				= r_blitrowPD_c;
+		r_blitrowDD				= r_blitrowDD_c;
+		R_DrawColumnQuadD		= R_DrawColumnQuadD_c;
+		R_DrawTranslucentColumnQuadD = R_DrawTranslucentColumnQuadD_c;
 	}
 	#ifdef __SSE2__
 	if (optimize_kind == OPTIMIZE_SSE2)
 	{
 		R_DrawSpanD				= R_DrawSpanD_SSE2;
 		R_DrawSlopeSpanD		= R_DrawSlopeSpanD_SSE2;
+		R_FillTranslucentSpanD	= R_FillTranslucentSpanD_c;
 		r_dimpatchD             = r_dimpatchD_SSE2;
+		r_blitrowPD				= r_blitrowPD_SSE2;
+		r_blitrowDD				= r_blitrowDD_SSE2;
+		R_DrawColumnQuadD		= R_DrawColumnQuadD_SSE2;
+		R_DrawTranslucentColumnQuadD = R_DrawTranslucentColumnQuadD_SSE2;
+	}
+	#endif
+	#ifdef ODA_HAVE_AVX2
+	else if (optimize_kind == OPTIMIZE_AVX2)
+	{
+		R_DrawSpanD				= R_DrawSpanD_AVX2;
+		R_DrawSlopeSpanD		= R_DrawSlopeSpanD_AVX2;
+		R_FillTranslucentSpanD	= R_FillTranslucentSpanD_AVX2;
+		r_dimpatchD             = r_dimpatchD_AVX2;
+		r_blitrowPD				= r_blitrowPD_AVX2;
+		r_blitrowDD				= r_blitrowDD_AVX2;
+		#ifdef __SSE2__
+		R_DrawColumnQuadD		= R_DrawColumnQuadD_SSE2;
+		R_DrawTranslucentColumnQuadD = R_DrawTranslucentColumnQuadD_SSE2;
+		#else
+		R_DrawColumnQuadD		= R_DrawColumnQuadD_c;
+		R_DrawTranslucentColumnQuadD = R_DrawTranslucentColumnQuadD_c;
+		#endif
 	}
 	#endif
 	#ifdef __MMX__
@@ -1602,7 +1924,12 @@ void R_InitVectorizedDrawers()
 	{
 		R_DrawSpanD				= R_DrawSpanD_c;		// TODO
 		R_DrawSlopeSpanD		= R_DrawSlopeSpanD_c;	// TODO
+		R_FillTranslucentSpanD	= R_FillTranslucentSpanD_c;
 		r_dimpatchD             = r_dimpatchD_MMX;
+		r_blitrowPD				= r_blitrowPD_c;
+		r_blitrowDD				= r_blitrowDD_c;
+		R_DrawColumnQuadD		= R_DrawColumnQuadD_c;
+		R_DrawTranslucentColumnQuadD = R_DrawTranslucentColumnQuadD_c;
 	}
 	#endif
 	#ifdef __ALTIVEC__
@@ -1610,14 +1937,51 @@ void R_InitVectorizedDrawers()
 	{
 		R_DrawSpanD				= R_DrawSpanD_c;		// TODO
 		R_DrawSlopeSpanD		= R_DrawSlopeSpanD_c;	// TODO
+		R_FillTranslucentSpanD	= R_FillTranslucentSpanD_c;
 		r_dimpatchD             = r_dimpatchD_ALTIVEC;
+		r_blitrowPD				= r_blitrowPD_c;
+		r_blitrowDD				= r_blitrowDD_c;
+		R_DrawColumnQuadD		= R_DrawColumnQuadD_c;
+		R_DrawTranslucentColumnQuadD = R_DrawTranslucentColumnQuadD_c;
 	}
 	#endif
 
 	// Check that all pointers are definitely assigned!
 	assert(R_DrawSpanD != NULL);
 	assert(R_DrawSlopeSpanD != NULL);
+	assert(R_FillTranslucentSpanD != NULL);
 	assert(r_dimpatchD != NULL);
+	assert(r_blitrowPD != NULL);
+	assert(r_blitrowDD != NULL);
+	assert(R_DrawColumnQuadD != NULL);
+	assert(R_DrawTranslucentColumnQuadD != NULL);
+}
+
+//
+// R_GetColumnQuadDrawer
+//
+// [Odamex] Returns the drawer for four adjacent columns that matches the
+// given column drawer, or NULL if there is none.
+//
+drawcolumnquadfunc_t R_GetColumnQuadDrawer(drawcolumnfunc_t func)
+{
+	if (func == (drawcolumnfunc_t)R_DrawColumnP)
+		return R_DrawColumnQuadP;
+	if (func == (drawcolumnfunc_t)R_DrawTranslucentColumnP)
+		return R_DrawTranslucentColumnQuadP;
+	if (func == (drawcolumnfunc_t)R_DrawTranslatedColumnP)
+		return R_DrawTranslatedColumnQuadP;
+	if (func == (drawcolumnfunc_t)R_DrawTlatedLucentColumnP)
+		return R_DrawTlatedLucentColumnQuadP;
+	if (func == (drawcolumnfunc_t)R_DrawColumnD)
+		return R_DrawColumnQuadD;
+	if (func == (drawcolumnfunc_t)R_DrawTranslucentColumnD)
+		return R_DrawTranslucentColumnQuadD;
+	if (func == (drawcolumnfunc_t)R_DrawTranslatedColumnD)
+		return R_DrawTranslatedColumnQuadD;
+	if (func == (drawcolumnfunc_t)R_DrawTlatedLucentColumnD)
+		return R_DrawTlatedLucentColumnQuadD;
+	return NULL;
 }
 
 // [RH] Initialize the column drawer pointers
@@ -1653,5 +2017,397 @@ void R_InitColumnDrawers ()
 	}
 }
 
+//
+// R_BenchRandom
+//
+// [Odamex] A small LCG for the drawer benchmarks, so that they draw the same
+// random data on every platform.
+//
+static inline int R_BenchRandom(unsigned int* seed)
+{
+	*seed = *seed * 1103515245 + 12345;
+	return (*seed >> 16) & 0x7FFF;
+}
+
+//
+// benchcolumns
+//
+// [Odamex] Times each column drawer that has a quad version, drawing a set of
+// random columns a column at a time and then four at a time, and checks that
+// both produce the same pixels.
+//
+struct columnbenchmark_t
+{
+	const char*				name;
+	int						bytesperpixel;
+	drawcolumnfunc_t		func;
+	drawcolumnquadfunc_t	quadfunc;
+};
+
+static double R_BenchColumnDrawer(const columnbenchmark_t& bench, std::vector<drawcolumn_t>& columns,
+			byte* buffer, int passes, bool quad)
+{
+	for (size_t i = 0; i < columns.size(); i++)
+		columns[i].destination = buffer;
+
+	dtime_t start = I_GetTime();
+
+	for (int pass = 0; pass < passes; pass++)
+	{
+		for (size_t i = 0; i + 3 < columns.size(); i += 4)
+		{
+			if (quad)
+			{
+				const drawcolumn_t* quadcolumns[4] = {
+						&columns[i + 0], &columns[i + 1], &columns[i + 2], &columns[i + 3] };
+				bench.quadfunc(quadcolumns);
+			}
+			else
+			{
+				bench.func(columns[i + 0]);
+				bench.func(columns[i + 1]);
+				bench.func(columns[i + 2]);
+				bench.func(columns[i + 3]);
+			}
+		}
+	}
+
+	return double(I_GetTime() - start);
+}
+
+BEGIN_COMMAND (benchcolumns)
+{
+	if (!translationtables || V_GetDefaultPalette() == NULL)
+		return;
+
+	int passes = 200;
+	if (argc >= 2)
+		passes = MAX(atoi(argv[1]), 1);
+
+	const int width = 256, height = 256, texheight = 128;
+
+	// a random texture column and a set of random columns using it
+	unsigned int seed = 1;
+
+	byte source[texheight];
+	for (int i = 0; i < texheight; i++)
+		source[i] = R_BenchRandom(&seed) & 0xFF;
+
+	std::vector<drawcolumn_t> columns(width);
+	size_t numpixels = 0;
+	for (int x = 0; x < width; x++)
+	{
+		drawcolumn_t& column = columns[x];
+		column.source = source;
+		column.pitch_in_pixels = width;
+		column.colormap = shaderef_t(&V_GetDefaultPalette()->maps, R_BenchRandom(&seed) % NUMCOLORMAPS);
+		column.translation = translationref_t(translationtables);
+		column.x = x;
+		column.yl = R_BenchRandom(&seed) % (height / 4);
+		column.yh = height - 1 - R_BenchRandom(&seed) % (height / 4);
+		column.iscale = FRACUNIT / 4 + R_BenchRandom(&seed) * 8;
+		column.texturefrac = R_BenchRandom(&seed) << 8;
+		column.textureheight = texheight << FRACBITS;
+		column.translevel = FRACUNIT / 4 + (R_BenchRandom(&seed) << 2);
+		numpixels += column.yh - column.yl + 1;
+	}
+
+	const columnbenchmark_t benchmarks[] = {
+		{ "R_DrawColumnP",				1, R_DrawColumnP,				R_DrawColumnQuadP },
+		{ "R_DrawTranslucentColumnP",	1, R_DrawTranslucentColumnP,	R_DrawTranslucentColumnQuadP },
+		{ "R_DrawTranslatedColumnP",	1, R_DrawTranslatedColumnP,		R_DrawTranslatedColumnQuadP },
+		{ "R_DrawTlatedLucentColumnP",	1, R_DrawTlatedLucentColumnP,	R_DrawTlatedLucentColumnQuadP },
+		{ "R_DrawColumnD",				4, R_DrawColumnD,				R_DrawColumnQuadD },
+		{ "R_DrawTranslucentColumnD",	4, R_DrawTranslucentColumnD,	R_DrawTranslucentColumnQuadD },
+		{ "R_DrawTranslatedColumnD",	4, R_DrawTranslatedColumnD,		R_DrawTranslatedColumnQuadD },
+		{ "R_DrawTlatedLucentColumnD",	4, R_DrawTlatedLucentColumnD,	R_DrawTlatedLucentColumnQuadD }
+	};
+
+	const size_t buffersize = width * height * sizeof(argb_t);
+	std::vector<byte> singlebuffer(buffersize), quadbuffer(buffersize);
+
+	Printf(PRINT_HIGH, "Drawing %d columns, %u pixels, %d times (r_optimize %s):\n",
+			width, (unsigned)numpixels, passes, get_optimization_name(optimize_kind));
+
+	for (size_t i = 0; i < sizeof(benchmarks) / sizeof(benchmarks[0]); i++)
+	{
+		const columnbenchmark_t& bench = benchmarks[i];
+
+		for (size_t j = 0; j < buffersize; j++)
+			singlebuffer[j] = quadbuffer[j] = j * 7;
+
+		double single = R_BenchColumnDrawer(bench, columns, &singlebuffer[0], passes, false);
+		double quad = R_BenchColumnDrawer(bench, columns, &quadbuffer[0], passes, true);
+		bool match = memcmp(&singlebuffer[0], &quadbuffer[0], width * height * bench.bytesperpixel) == 0;
+
+		// the times are in nanoseconds
+		double total = double(numpixels) * passes;
+		Printf(PRINT_HIGH, "%-28s %7.1f Mpixels/s single, %7.1f Mpixels/s quad %s\n", bench.name,
+				single > 0.0 ? 1000.0 * total / single : 0.0,
+				quad > 0.0 ? 1000.0 * total / quad : 0.0,
+				match ? "" : "(MISMATCH)");
+	}
+}
+END_COMMAND (benchcolumns)
+
+
+//
+// benchspans
+//
+// [Odamex] Times each of the drawers chosen by r_optimize with every
+// optimization the CPU supports, and checks that they all produce the same
+// pixels as the C versions.
+//
+struct benchspan_t
+{
+	int			y, x1, x2;
+	dsfixed_t	xfrac, yfrac, xstep, ystep;
+	float		iu, iv, id, iustep, ivstep, idstep;
+	fixed_t		translevel;
+	palindex_t	color;
+	shaderef_t	colormap;
+};
+
+enum benchspankind_t
+{
+	BENCH_DRAWSPAN,
+	BENCH_DRAWSLOPESPAN,
+	BENCH_FILLTRANSLUCENTSPAN,
+	BENCH_DIMPATCH,
+	NUM_BENCHSPANKINDS
+};
+
+static const char* benchspannames[NUM_BENCHSPANKINDS] = {
+	"R_DrawSpanD", "R_DrawSlopeSpanD", "R_FillTranslucentSpanD", "r_dimpatchD"
+};
+
+static double R_BenchSpanDrawer(benchspankind_t kind, const std::vector<benchspan_t>& spans,
+			IWindowSurface* surface, int passes)
+{
+	dspan.destination = surface->getBuffer();
+	dspan.pitch_in_pixels = surface->getPitchInPixels();
+
+	dtime_t start = I_GetTime();
+
+	for (int pass = 0; pass < passes; pass++)
+	{
+		if (kind == BENCH_DIMPATCH)
+		{
+			// the same rectangle is dimmed with a different amount each pass
+			r_dimpatchD(surface, argb_t(pass * 3, pass * 5, pass * 7), pass % 257,
+					3, 5, surface->getWidth() - 7, surface->getHeight() - 9);
+			continue;
+		}
+
+		for (size_t i = 0; i < spans.size(); i++)
+		{
+			const benchspan_t& span = spans[i];
+			dspan.y = span.y;
+			dspan.x1 = span.x1;
+			dspan.x2 = span.x2;
+			dspan.xfrac = span.xfrac;
+			dspan.yfrac = span.yfrac;
+			dspan.xstep = span.xstep;
+			dspan.ystep = span.ystep;
+			dspan.iu = span.iu;
+			dspan.iv = span.iv;
+			dspan.id = span.id;
+			dspan.iustep = span.iustep;
+			dspan.ivstep = span.ivstep;
+			dspan.idstep = span.idstep;
+			dspan.translevel = span.translevel;
+			dspan.color = span.color;
+			dspan.colormap = span.colormap;
+
+			if (kind == BENCH_DRAWSPAN)
+				R_DrawSpanD();
+			else if (kind == BENCH_DRAWSLOPESPAN)
+				R_DrawSlopeSpanD();
+			else
+				R_FillTranslucentSpanD();
+		}
+	}
+
+	return double(I_GetTime() - start);
+}
+
+BEGIN_COMMAND (benchspans)
+{
+	if (V_GetDefaultPalette() == NULL)
+		return;
+
+	int passes = 200;
+	if (argc >= 2)
+		passes = MAX(atoi(argv[1]), 1);
+
+	const int width = 256, height = 256;
+	const shademap_t* maps = &V_GetDefaultPalette()->maps;
+
+	unsigned int seed = 1;
+
+	// a random flat and a random span on each row using it
+	byte source[64 * 64];
+	for (int i = 0; i < 64 * 64; i++)
+		source[i] = R_BenchRandom(&seed) & 0xFF;
+
+	dspan.source = source;
+	for (int x = 0; x < width; x++)
+		dspan.slopelighting[x] = shaderef_t(maps, R_BenchRandom(&seed) % NUMCOLORMAPS);
+
+	std::vector<benchspan_t> spans(height);
+	size_t numpixels = 0;
+	for (int y = 0; y < height; y++)
+	{
+		benchspan_t& span = spans[y];
+		span.y = y;
+		span.x1 = R_BenchRandom(&seed) % 32;
+		span.x2 = width - 1 - R_BenchRandom(&seed) % 32;
+		span.xfrac = (unsigned int)R_BenchRandom(&seed) << 17;
+		span.xfrac ^= R_BenchRandom(&seed);
+		span.yfrac = (unsigned int)R_BenchRandom(&seed) << 17;
+		span.yfrac ^= R_BenchRandom(&seed);
+		span.xstep = (R_BenchRandom(&seed) << 12) - (1 << 26);
+		span.ystep = (R_BenchRandom(&seed) << 12) - (1 << 26);
+		span.iu = float(R_BenchRandom(&seed)) / 64.0f;
+		span.iv = float(R_BenchRandom(&seed)) / 64.0f;
+		span.id = 1.0f + float(R_BenchRandom(&seed)) / 32768.0f;
+		span.iustep = float(R_BenchRandom(&seed)) / 4096.0f;
+		span.ivstep = float(R_BenchRandom(&seed)) / 4096.0f;
+		span.idstep = float(R_BenchRandom(&seed)) / (32768.0f * 1024.0f);
+		span.translevel = R_BenchRandom(&seed) << 1;
+		span.color = R_BenchRandom(&seed) & 0xFF;
+		span.colormap = shaderef_t(maps, R_BenchRandom(&seed) % NUMCOLORMAPS);
+		numpixels += span.x2 - span.x1 + 1;
+	}
+
+	IWindowSurface* surface = I_AllocateSurface(width, height, 32);
+	const size_t buffersize = surface->getPitch() * height;
+	std::vector<byte> reference(buffersize);
+
+	const r_optimize_kind saved_kind = optimize_kind;
+
+	Printf(PRINT_HIGH, "Drawing %d spans, %u pixels, %d times:\n", height, (unsigned)numpixels, passes);
+
+	for (int i = 0; i < NUM_BENCHSPANKINDS; i++)
+	{
+		const benchspankind_t kind = (benchspankind_t)i;
+		const double total = double(kind == BENCH_DIMPATCH ? (width - 7) * (height - 9) : numpixels) * passes;
+
+		// the first optimization is always none, the C reference
+		for (size_t j = 0; j < optimizations_available.size(); j++)
+		{
+			optimize_kind = optimizations_available[j];
+			R_InitVectorizedDrawers();
+
+			byte* buffer = surface->getBuffer();
+			for (size_t k = 0; k < buffersize; k++)
+				buffer[k] = k * 7;
+
+			double elapsed = R_BenchSpanDrawer(kind, spans, surface, passes);
+
+			bool match = true;
+			if (j == 0)
+				memcpy(&reference[0], buffer, buffersize);
+			else
+				match = memcmp(&reference[0], buffer, buffersize) == 0;
+
+			// the times are in nanoseconds
+			Printf(PRINT_HIGH, "%-24s %-8s %7.1f Mpixels/s %s\n", benchspannames[i],
+					get_optimization_name(optimize_kind),
+					elapsed > 0.0 ? 1000.0 * total / elapsed : 0.0,
+					match ? "" : "(MISMATCH)");
+		}
+	}
+
+	optimize_kind = saved_kind;
+	R_InitVectorizedDrawers();
+
+	I_FreeSurface(surface);
+}
+END_COMMAND (benchspans)
+
+
+//
+// benchblit
+//
+// [Odamex] Times IWindowSurface::blit stretching 320x200 surfaces to common
+// screen resolutions and converting a full screen from 8bpp to 32bpp, with
+// every optimization the CPU supports.
+//
+BEGIN_COMMAND (benchblit)
+{
+	if (V_GetDefaultPalette() == NULL)
+		return;
+
+	int passes = 20;
+	if (argc >= 2)
+		passes = MAX(atoi(argv[1]), 1);
+
+	static const int sizes[][4] = {
+		{ 320, 200, 640, 400 },
+		{ 320, 200, 1280, 800 },
+		{ 320, 200, 1920, 1080 },
+		{ 320, 200, 2560, 1440 },
+		{ 320, 200, 3840, 2160 },
+		{ 1920, 1080, 1920, 1080 },
+		{ 3840, 2160, 3840, 2160 }
+	};
+
+	const r_optimize_kind saved_kind = optimize_kind;
+
+	for (size_t i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++)
+	{
+		const int srcw = sizes[i][0], srch = sizes[i][1];
+		const int destw = sizes[i][2], desth = sizes[i][3];
+
+		for (int srcbits = 8; srcbits <= 32; srcbits += 24)
+		{
+			IWindowSurface* source = I_AllocateSurface(srcw, srch, srcbits);
+			IWindowSurface* dest = I_AllocateSurface(destw, desth, 32);
+			source->setPalette(V_GetDefaultPalette()->colors);
+
+			byte* buffer = source->getBuffer();
+			for (int k = 0; k < source->getPitch() * srch; k++)
+				buffer[k] = (k * 7) ^ (k >> 9);
+
+			const size_t buffersize = dest->getPitch() * desth;
+			std::vector<byte> reference(buffersize);
+
+			// the first optimization is always none, the C reference
+			for (size_t j = 0; j < optimizations_available.size(); j++)
+			{
+				optimize_kind = optimizations_available[j];
+				R_InitVectorizedDrawers();
+
+				memset(dest->getBuffer(), 0, buffersize);
+
+				dtime_t start = I_GetTime();
+				for (int pass = 0; pass < passes; pass++)
+					dest->blit(source, 0, 0, srcw, srch, 0, 0, destw, desth);
+				double elapsed = double(I_GetTime() - start);
+
+				bool match = true;
+				if (j == 0)
+					memcpy(&reference[0], dest->getBuffer(), buffersize);
+				else
+					match = memcmp(&reference[0], dest->getBuffer(), buffersize) == 0;
+
+				// the times are in nanoseconds
+				Printf(PRINT_HIGH, "%4dx%-4d %2dbpp -> %4dx%-4d %-8s %7.3f ms %s\n",
+						srcw, srch, srcbits, destw, desth,
+						get_optimization_name(optimize_kind),
+						elapsed / (1000000.0 * passes), match ? "" : "(MISMATCH)");
+			}
+
+			I_FreeSurface(source);
+			I_FreeSurface(dest);
+		}
+	}
+
+	optimize_kind = saved_kind;
+	R_InitVectorizedDrawers();
+}
+END_COMMAND (benchblit)
+
 VERSION_CONTROL (r_draw_cpp, "$Id$")
 
@@ -0,0 +1,664 @@
+// Emacs style mode select   -*- C++ -*-
+//-----------------------------------------------------------------------------
+//
+// $Id$
+//
+// Copyright (C) 2006-2019 by The Odamex Team.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// DESCRIPTION:
+//	Deferred column and span drawing for the multithreaded renderer.
+//
+//	While the draw queue is active, the column and span drawers invoked
+//	by R_RenderPlayerView are recorded instead of run. When the queue is
+//	flushed, the view window is split into vertical strips, one for each
+//	drawing thread, and every thread runs the queued drawers that touch
+//	its strip in the order they were queued. A column always lies within
+//	a single strip and a span is clipped to the strip exactly, so the
+//	result is identical to drawing everything on one thread.
+//
+//	Drawers that depend on state other than their drawcolumn_t or
+//	drawspan_t (the fuzz effect, sloped spans, r_drawflat) cannot be run
+//	out of order. Queuing one of those flushes the queue and then runs it
+//	immediately on the main thread.
+//
+//	With r_batchcolumns enabled, runs of four adjacent columns queued one
+//	after another with the same drawer are drawn together by the quad
+//	column drawers, even when there is only one drawing thread.
+//
+//-----------------------------------------------------------------------------
+
+#include <vector>
+
+#include "doomtype.h"
+#include "doomdef.h"
+#include "doomstat.h"
+#include "c_cvars.h"
+#include "c_dispatch.h"
+#include "i_system.h"
+#include "i_thread.h"
+#include "i_video.h"
+#include "r_local.h"
+#include "r_draw.h"
+#include "r_intrin.h"
+#include "z_zone.h"
+
+EXTERN_CVAR(r_drawthreads)
+EXTERN_CVAR(r_batchcolumns)
+
+static const int MAXDRAWTHREADS = 32;
+
+// Strips are widened to a multiple of this many pixels so that threads
+// don't share cache lines at the strip edges.
+static const int STRIPALIGN = 16;
+
+bool r_deferdrawing = false;
+static bool batchcolumns = false;
+
+//
+// Queued drawers
+//
+// Columns are stored whole. Spans only store the fields needed by the
+// drawers that can be queued, since drawspan_t carries the lighting for
+// sloped spans and is too large to copy for every span.
+//
+struct queuedcolumn_t
+{
+	drawcolumnfunc_t	func;
+	drawcolumnquadfunc_t quadfunc;		// NULL if it can't be drawn four at a time
+	drawcolumn_t		drawcolumn;
+};
+
+struct queuedspan_t
+{
+	drawspanfunc_t		func;
+
+	byte*				source;
+	byte*				destination;
+	int					pitch_in_pixels;
+
+	shaderef_t			colormap;
+
+	int					y;
+	int					x1;
+	int					x2;
+
+	dsfixed_t			xfrac;
+	dsfixed_t			yfrac;
+	dsfixed_t			xstep;
+	dsfixed_t			ystep;
+
+	fixed_t				translevel;
+	palindex_t			color;
+};
+
+static std::vector<queuedcolumn_t> queuedcolumns;
+static std::vector<queuedspan_t> queuedspans;
+
+// Drawing order. Columns are stored as their index in queuedcolumns and
+// spans as the complement of their index in queuedspans.
+static std::vector<int> drawqueue;
+
+
+//
+// Drawing threads
+//
+// drawthreads[0] is the main thread, which draws the first strip itself.
+//
+struct drawthread_t
+{
+	thread_t*			thread;
+	int					x1;
+	int					x2;
+	drawspan_t*			drawspan;
+};
+
+static std::vector<drawthread_t> drawthreads;
+
+static mutex_t* drawmutex = NULL;
+static condvar_t* drawstartcond = NULL;
+static condvar_t* drawdonecond = NULL;
+
+static unsigned int drawgeneration = 0;
+static int drawpending = 0;
+static bool drawquit = false;
+
+
+// ============================================================================
+//
+// Drawer lookup
+//
+// ============================================================================
+
+struct columndrawer_t
+{
+	void				(*func)();
+	drawcolumnfunc_t	statefunc;
+};
+
+struct spandrawer_t
+{
+	void				(*func)();
+	drawspanfunc_t		statefunc;
+};
+
+static const columndrawer_t columndrawers[] = {
+	{ R_FillColumnP,				R_FillColumnP },
+	{ R_DrawColumnP,				R_DrawColumnP },
+	{ R_DrawTranslucentColumnP,		R_DrawTranslucentColumnP },
+	{ R_DrawTranslatedColumnP,		R_DrawTranslatedColumnP },
+	{ R_DrawTlatedLucentColumnP,	R_DrawTlatedLucentColumnP },
+	{ R_DrawColumnD,				R_DrawColumnD },
+	{ R_DrawTranslucentColumnD,		R_DrawTranslucentColumnD },
+	{ R_DrawTranslatedColumnD,		R_DrawTranslatedColumnD },
+	{ R_DrawTlatedLucentColumnD,	R_DrawTlatedLucentColumnD },
+	{ NULL,							NULL }
+};
+
+static const spandrawer_t spandrawers[] = {
+	{ R_FillSpanP,					R_FillSpanP },
+	{ R_FillTranslucentSpanP,		R_FillTranslucentSpanP },
+	{ R_DrawSpanP,					R_DrawSpanP },
+	{ R_FillTranslucentSpanD_c,		R_FillTranslucentSpanD_c },
+	{ R_DrawSpanD_c,				R_DrawSpanD_c },
+	#ifdef __SSE2__
+	{ R_DrawSpanD_SSE2,				R_DrawSpanD_SSE2 },
+	#endif
+	#ifdef ODA_HAVE_AVX2
+	{ R_FillTranslucentSpanD_AVX2,	R_FillTranslucentSpanD_AVX2 },
+	{ R_DrawSpanD_AVX2,				R_DrawSpanD_AVX2 },
+	#endif
+	{ NULL,							NULL }
+};
+
+//
+// R_FindColumnDrawer
+//
+// Returns the version of the column drawer that takes its state as a
+// parameter, or NULL if it can not be deferred.
+//
+static drawcolumnfunc_t R_FindColumnDrawer(void (*drawfunc)())
+{
+	static void (*lastfunc)() = NULL;
+	static drawcolumnfunc_t laststatefunc = NULL;
+
+	if (drawfunc == lastfunc)
+		return laststatefunc;
+
+	lastfunc = drawfunc;
+	laststatefunc = NULL;
+
+	for (const columndrawer_t* drawer = columndrawers; drawer->func; drawer++)
+	{
+		if (drawer->func == drawfunc)
+		{
+			laststatefunc = drawer->statefunc;
+			break;
+		}
+	}
+
+	return laststatefunc;
+}
+
+//
+// R_FindSpanDrawer
+//
+// Returns the version of the span drawer that takes its state as a
+// parameter, or NULL if it can not be deferred.
+//
+static drawspanfunc_t R_FindSpanDrawer(void (*drawfunc)())
+{
+	static void (*lastfunc)() = NULL;
+	static drawspanfunc_t laststatefunc = NULL;
+
+	if (drawfunc == lastfunc)
+		return laststatefunc;
+
+	lastfunc = drawfunc;
+	laststatefunc = NULL;
+
+	for (const spandrawer_t* drawer = spandrawers; drawer->func; drawer++)
+	{
+		if (drawer->func == drawfunc)
+		{
+			laststatefunc = drawer->statefunc;
+			break;
+		}
+	}
+
+	return laststatefunc;
+}
+
+
+// ============================================================================
+//
+// Drawing
+//
+// ============================================================================
+
+//
+// R_CanDrawColumnQuad
+//
+// Returns true if the four queued columns starting at drawqueue[i] can be
+// drawn together by a quad column drawer within the columns x1 through x2.
+//
+static inline bool R_CanDrawColumnQuad(size_t i, int x1, int x2)
+{
+	if (i + 3 >= drawqueue.size())
+		return false;
+
+	const int index = drawqueue[i];
+	const queuedcolumn_t& column = queuedcolumns[index];
+	const int x = column.drawcolumn.x;
+
+	if (column.quadfunc == NULL || x < x1 || x + 3 > x2)
+		return false;
+
+	for (int j = 1; j < 4; j++)
+	{
+		if (drawqueue[i + j] != index + j)
+			return false;
+
+		const queuedcolumn_t& next = queuedcolumns[index + j];
+		if (next.quadfunc != column.quadfunc || next.drawcolumn.x != x + j)
+			return false;
+	}
+
+	return true;
+}
+
+//
+// R_DrawStrip
+//
+// Runs every queued drawer that touches the columns x1 through x2 of the
+// given thread's strip, clipping spans to the strip.
+//
+static void R_DrawStrip(drawthread_t* thread)
+{
+	const int x1 = thread->x1, x2 = thread->x2;
+	if (x1 > x2)
+		return;
+
+	drawspan_t& drawspan = *thread->drawspan;
+
+	for (size_t i = 0; i < drawqueue.size(); i++)
+	{
+		const int index = drawqueue[i];
+
+		if (index >= 0)
+		{
+			if (batchcolumns && R_CanDrawColumnQuad(i, x1, x2))
+			{
+				const drawcolumn_t* columns[4] = {
+					&queuedcolumns[index + 0].drawcolumn, &queuedcolumns[index + 1].drawcolumn,
+					&queuedcolumns[index + 2].drawcolumn, &queuedcolumns[index + 3].drawcolumn };
+
+				queuedcolumns[index].quadfunc(columns);
+				i += 3;
+				continue;
+			}
+
+			const queuedcolumn_t& column = queuedcolumns[index];
+			if (column.drawcolumn.x >= x1 && column.drawcolumn.x <= x2)
+				column.func(column.drawcolumn);
+		}
+		else
+		{
+			const queuedspan_t& span = queuedspans[~index];
+			if (span.x2 < x1 || span.x1 > x2)
+				continue;
+
+			const int start = MAX(span.x1, x1);
+			const int skip = start - span.x1;
+
+			drawspan.source = span.source;
+			drawspan.destination = span.destination;
+			drawspan.pitch_in_pixels = span.pitch_in_pixels;
+			drawspan.colormap = span.colormap;
+			drawspan.y = span.y;
+			drawspan.x1 = start;
+			drawspan.x2 = MIN(span.x2, x2);
+			drawspan.xfrac = span.xfrac + skip * span.xstep;
+			drawspan.yfrac = span.yfrac + skip * span.ystep;
+			drawspan.xstep = span.xstep;
+			drawspan.ystep = span.ystep;
+			drawspan.translevel = span.translevel;
+			drawspan.color = span.color;
+
+			span.func(drawspan);
+		}
+	}
+}
+
+//
+// R_DrawThreadFunc
+//
+// Waits for the main thread to flush the queue, draws this thread's strip
+// and reports back, until the threads are shut down.
+//
+static int R_DrawThreadFunc(void* data)
+{
+	drawthread_t* thread = static_cast<drawthread_t*>(data);
+	unsigned int generation = 0;
+
+	while (true)
+	{
+		{
+			OScopedLock lock(drawmutex);
+			while (drawgeneration == generation && !drawquit)
+				I_WaitCondVar(drawstartcond, drawmutex);
+
+			if (drawquit)
+				return 0;
+
+			generation = drawgeneration;
+		}
+
+		R_DrawStrip(thread);
+
+		OScopedLock lock(drawmutex);
+		if (--drawpending == 0)
+			I_SignalCondVar(drawdonecond);
+	}
+}
+
+//
+// R_FlushDrawQueue
+//
+// Draws everything queued so far, using all of the drawing threads, and
+// empties the queue.
+//
+void R_FlushDrawQueue()
+{
+	if (drawqueue.empty())
+		return;
+
+	const int numthreads = (int)drawthreads.size();
+
+	int stripwidth = (viewwidth + numthreads - 1) / numthreads;
+	stripwidth = (stripwidth + STRIPALIGN - 1) & ~(STRIPALIGN - 1);
+
+	for (int i = 0; i < numthreads; i++)
+	{
+		drawthreads[i].x1 = i * stripwidth;
+		drawthreads[i].x2 = MIN((i + 1) * stripwidth, viewwidth) - 1;
+	}
+
+	if (numthreads > 1)
+	{
+		OScopedLock lock(drawmutex);
+		drawpending = numthreads - 1;
+		drawgeneration++;
+		I_BroadcastCondVar(drawstartcond);
+	}
+
+	R_DrawStrip(&drawthreads[0]);
+
+	if (numthreads > 1)
+	{
+		OScopedLock lock(drawmutex);
+		while (drawpending > 0)
+			I_WaitCondVar(drawdonecond, drawmutex);
+	}
+
+	drawqueue.clear();
+	queuedcolumns.clear();
+	queuedspans.clear();
+}
+
+//
+// R_QueueColumn
+//
+// Queues the column described by dcol to be drawn by drawfunc.
+//
+void R_QueueColumn(void (*drawfunc)())
+{
+	if (drawfunc == R_BlankColumn)
+		return;
+
+	drawcolumnfunc_t statefunc = R_FindColumnDrawer(drawfunc);
+	if (statefunc == NULL)
+	{
+		R_FlushDrawQueue();
+		drawfunc();
+		return;
+	}
+
+	drawqueue.push_back((int)queuedcolumns.size());
+	queuedcolumns.push_back(queuedcolumn_t());
+
+	queuedcolumn_t& column = queuedcolumns.back();
+	column.func = statefunc;
+	column.quadfunc = NULL;
+	column.drawcolumn = dcol;
+
+	// the quad drawers only handle textures with power-of-2 heights
+	if (batchcolumns && (dcol.textureheight & (dcol.textureheight - 1)) == 0)
+		column.quadfunc = R_GetColumnQuadDrawer(statefunc);
+}
+
+//
+// R_QueueSpan
+//
+// Queues the span described by dspan to be drawn by drawfunc.
+//
+void R_QueueSpan(void (*drawfunc)())
+{
+	if (drawfunc == R_BlankSpan)
+		return;
+
+	drawspanfunc_t statefunc = R_FindSpanDrawer(drawfunc);
+	if (statefunc == NULL)
+	{
+		R_FlushDrawQueue();
+		drawfunc();
+		return;
+	}
+
+	drawqueue.push_back(~(int)queuedspans.size());
+	queuedspans.push_back(queuedspan_t());
+
+	queuedspan_t& span = queuedspans.back();
+	span.func = statefunc;
+	span.source = dspan.source;
+	span.destination = dspan.destination;
+	span.pitch_in_pixels = dspan.pitch_in_pixels;
+	span.colormap = dspan.colormap;
+	span.y = dspan.y;
+	span.x1 = dspan.x1;
+	span.x2 = dspan.x2;
+	span.xfrac = dspan.xfrac;
+	span.yfrac = dspan.yfrac;
+	span.xstep = dspan.xstep;
+	span.ystep = dspan.ystep;
+	span.translevel = dspan.translevel;
+	span.color = dspan.color;
+}
+
+//
+// R_BeginDrawQueue
+//
+// Starts queuing drawers if there is more than one drawing thread or
+// columns are to be drawn in batches.
+//
+void R_BeginDrawQueue()
+{
+	batchcolumns = r_batchcolumns;
+	r_deferdrawing = drawthreads.size() > 1 || (batchcolumns && !drawthreads.empty());
+
+	// Cached textures must not be purged while drawers referring to them
+	// are waiting in the queue.
+	Z_SetPurgeCallback(r_deferdrawing ? R_FlushDrawQueue : NULL);
+}
+
+//
+// R_EndDrawQueue
+//
+// Draws anything still queued and goes back to drawing immediately.
+//
+void R_EndDrawQueue()
+{
+	R_FlushDrawQueue();
+	r_deferdrawing = false;
+
+	Z_SetPurgeCallback(NULL);
+}
+
+
+// ============================================================================
+//
+// Thread management
+//
+// ============================================================================
+
+//
+// R_StartDrawThreads
+//
+static void R_StartDrawThreads(int count)
+{
+	R_ShutdownDrawThreads();
+
+	if (!I_ThreadsAvailable())
+		count = 1;
+	count = clamp(count, 1, MAXDRAWTHREADS);
+
+	if (drawmutex == NULL)
+	{
+		drawmutex = I_CreateMutex();
+		drawstartcond = I_CreateCondVar();
+		drawdonecond = I_CreateCondVar();
+	}
+
+	drawquit = false;
+	drawgeneration = 0;
+
+	// the threads hold pointers to their entries, so the vector must not
+	// be resized once they have started
+	drawthreads.resize(count);
+	for (int i = 0; i < count; i++)
+	{
+		drawthreads[i].thread = NULL;
+		drawthreads[i].x1 = 0;
+		drawthreads[i].x2 = -1;
+		drawthreads[i].drawspan = new drawspan_t;
+	}
+
+	for (int i = 1; i < count; i++)
+	{
+		drawthreads[i].thread = I_CreateThread(R_DrawThreadFunc, &drawthreads[i]);
+		if (drawthreads[i].thread == NULL)
+		{
+			Printf(PRINT_HIGH, "R_InitDrawThreads: could only start %d drawing threads\n", i);
+
+			for (int j = i; j < count; j++)
+				delete drawthreads[j].drawspan;
+
+			drawthreads.resize(i);
+			break;
+		}
+	}
+}
+
+//
+// R_InitDrawThreads
+//
+// Starts the number of drawing threads given by r_drawthreads, including the
+// main thread. Zero uses one thread for each CPU.
+//
+void R_InitDrawThreads()
+{
+	int count = r_drawthreads.asInt();
+	if (count <= 0)
+		count = I_GetNumCPUs();
+
+	R_StartDrawThreads(count);
+}
+
+//
+// R_ShutdownDrawThreads
+//
+void R_ShutdownDrawThreads()
+{
+	R_EndDrawQueue();
+
+	if (drawthreads.size() > 1)
+	{
+		{
+			OScopedLock lock(drawmutex);
+			drawquit = true;
+			I_BroadcastCondVar(drawstartcond);
+		}
+
+		for (size_t i = 1; i < drawthreads.size(); i++)
+			I_WaitThread(drawthreads[i].thread);
+	}
+
+	for (size_t i = 0; i < drawthreads.size(); i++)
+		delete drawthreads[i].drawspan;
+
+	drawthreads.clear();
+}
+
+CVAR_FUNC_IMPL(r_drawthreads)
+{
+	R_InitDrawThreads();
+}
+
+
+//
+// benchrender
+//
+// Renders the current view repeatedly with increasing numbers of drawing
+// threads and reports the frame rate for each.
+//
+BEGIN_COMMAND(benchrender)
+{
+	if (gamestate != GS_LEVEL)
+	{
+		Printf(PRINT_HIGH, "benchrender: must be in a level\n");
+		return;
+	}
+
+	int frames = 100;
+	if (argc >= 2)
+		frames = MAX(atoi(argv[1]), 1);
+
+	const int numcpus = MIN(I_GetNumCPUs(), MAXDRAWTHREADS);
+
+	Printf(PRINT_HIGH, "Rendering %d frames at %dx%d:\n", frames, viewwidth, viewheight);
+
+	for (int count = 1; ; count = MIN(count * 2, numcpus))
+	{
+		R_StartDrawThreads(count);
+
+		I_BeginUpdate();
+
+		dtime_t start = I_GetTime();
+		for (int i = 0; i < frames; i++)
+			R_RenderPlayerView(&displayplayer());
+		dtime_t elapsed = I_GetTime() - start;
+
+		I_FinishUpdate();
+
+		double ms = double(I_ConvertTimeToMs(elapsed)) / frames;
+		Printf(PRINT_HIGH, "%2d threads: %.2f ms per frame (%.1f fps)\n",
+				(int)drawthreads.size(), ms, ms > 0.0 ? 1000.0 / ms : 0.0);
+
+		if (count >= numcpus)
+			break;
+	}
+
+	R_InitDrawThreads();
+}
+END_COMMAND(benchrender)
+
+VERSION_CONTROL (r_drawq_cpp, "$Id$")
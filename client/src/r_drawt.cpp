@@ -20,7 +20,10 @@
 //
 //-----------------------------------------------------------------------------
 
+#include <cstring>
+
 #include "doomtype.h"
+#include "m_fixed.h"
 #include "i_video.h"
 #include "v_video.h"
 
@@ -42,6 +45,52 @@ void r_dimpatchD_c(IWindowSurface* surface, argb_t color, int alpha, int x1, int
 	}
 }
 
+
+//
+// r_blitrowPD_c
+//
+// [Odamex] Converts count 8bpp pixels to 32bpp through the palette, reading
+// the source every xstep (fixed point) pixels. Used by IWindowSurface::blit.
+//
+void r_blitrowPD_c(argb_t* dest, const palindex_t* source, const argb_t* palette, int count, fixed_t xstep)
+{
+	if (xstep == FRACUNIT)
+	{
+		for (int x = 0; x < count; x++)
+			dest[x] = palette[source[x]];
+		return;
+	}
+
+	fixed_t xfrac = 0;
+	for (int x = 0; x < count; x++)
+	{
+		dest[x] = palette[source[xfrac >> FRACBITS]];
+		xfrac += xstep;
+	}
+}
+
+//
+// r_blitrowDD_c
+//
+// [Odamex] Copies count 32bpp pixels, reading the source every xstep
+// (fixed point) pixels.
+//
+void r_blitrowDD_c(argb_t* dest, const argb_t* source, int count, fixed_t xstep)
+{
+	if (xstep == FRACUNIT)
+	{
+		memcpy(dest, source, count * sizeof(argb_t));
+		return;
+	}
+
+	fixed_t xfrac = 0;
+	for (int x = 0; x < count; x++)
+	{
+		dest[x] = source[xfrac >> FRACBITS];
+		xfrac += xstep;
+	}
+}
+
 	
 VERSION_CONTROL (r_drawt_cpp, "$Id$")
 
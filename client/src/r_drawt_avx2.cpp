@@ -0,0 +1,538 @@
+// Emacs style mode select   -*- C++ -*-
+//-----------------------------------------------------------------------------
+//
+// $Id$
+//
+// Copyright (C) 2006-2019 by The Odamex Team.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// DESCRIPTION:
+//	Direct rendering (32-bit) functions for AVX2 optimization.
+//
+//	Each function is compiled for AVX2 on its own, so the rest of the
+//	program does not require AVX2. R_InitVectorizedDrawers only selects
+//	these when r_optimize has found that the CPU supports AVX2. They
+//	produce exactly the same pixels as the C versions.
+//
+//-----------------------------------------------------------------------------
+
+#include "i_sdl.h"
+#include "r_intrin.h"
+
+#ifdef ODA_HAVE_AVX2
+
+#include <immintrin.h>
+
+#if defined(__GNUC__) && !defined(__AVX2__)
+#define AVX2_TARGET __attribute__((target("avx2")))
+#else
+#define AVX2_TARGET
+#endif
+
+#ifdef _MSC_VER
+#define AVX2_ALIGNED(x) _CRT_ALIGN(32) x
+#else
+#define AVX2_ALIGNED(x) x __attribute__((aligned(32)))
+#endif
+
+#include "doomtype.h"
+#include "doomdef.h"
+#include "i_system.h"
+#include "r_defs.h"
+#include "r_draw.h"
+#include "r_main.h"
+#include "i_video.h"
+#include "v_video.h"
+
+
+//
+// R_DrawSpanD_AVX2
+//
+// Renders a span for a level plane eight pixels at a time. The texture
+// coordinates are stepped in vectors and the shades of the eight texels are
+// gathered from the shade map at once.
+//
+AVX2_TARGET void R_DrawSpanD_AVX2(const drawspan_t& drawspan)
+{
+#ifdef RANGECHECK
+	if (drawspan.x2 < drawspan.x1 || drawspan.x1 < 0 || drawspan.x2 >= viewwidth ||
+		drawspan.y >= viewheight || drawspan.y < 0)
+	{
+		Printf(PRINT_HIGH, "R_DrawLevelSpan: %i to %i at %i", drawspan.x1, drawspan.x2, drawspan.y);
+		return;
+	}
+#endif
+
+	const int width = drawspan.x2 - drawspan.x1 + 1;
+	if (width <= 0)
+		return;
+
+	// TODO: store flats in column-major format and swap u and v
+	dsfixed_t ufrac = drawspan.yfrac;
+	dsfixed_t vfrac = drawspan.xfrac;
+	const dsfixed_t ustep = drawspan.ystep;
+	const dsfixed_t vstep = drawspan.xstep;
+
+	const byte* source = drawspan.source;
+	argb_t* dest = (argb_t*)drawspan.destination + drawspan.y * drawspan.pitch_in_pixels + drawspan.x1;
+
+	const shaderef_t& colormap = drawspan.colormap;
+
+	const int texture_width_bits = 6, texture_height_bits = 6;
+
+	const unsigned int umask = ((1 << texture_width_bits) - 1) << texture_height_bits;
+	const unsigned int vmask = (1 << texture_height_bits) - 1;
+	// TODO: don't shift the values of ufrac and vfrac by 10 in R_MapLevelPlane
+	const int ushift = FRACBITS - texture_height_bits + 10;
+	const int vshift = FRACBITS + 10;
+
+	int batches = width / 8;
+	int remainder = width & 7;
+
+	if (batches > 0)
+	{
+		const __m256i mumask = _mm256_set1_epi32(umask);
+		const __m256i mvmask = _mm256_set1_epi32(vmask);
+
+		__m256i mufrac = _mm256_setr_epi32(
+				ufrac+ustep*0, ufrac+ustep*1, ufrac+ustep*2, ufrac+ustep*3,
+				ufrac+ustep*4, ufrac+ustep*5, ufrac+ustep*6, ufrac+ustep*7);
+		const __m256i mufracinc = _mm256_set1_epi32(ustep*8);
+		__m256i mvfrac = _mm256_setr_epi32(
+				vfrac+vstep*0, vfrac+vstep*1, vfrac+vstep*2, vfrac+vstep*3,
+				vfrac+vstep*4, vfrac+vstep*5, vfrac+vstep*6, vfrac+vstep*7);
+		const __m256i mvfracinc = _mm256_set1_epi32(vstep*8);
+
+		const int* shademap = (const int*)colormap.m_shademap;
+		AVX2_ALIGNED(unsigned int spots[8]);
+
+		ufrac += ustep * 8 * batches;
+		vfrac += vstep * 8 * batches;
+
+		do {
+			const __m256i u = _mm256_and_si256(_mm256_srli_epi32(mufrac, ushift), mumask);
+			const __m256i v = _mm256_and_si256(_mm256_srli_epi32(mvfrac, vshift), mvmask);
+			_mm256_store_si256((__m256i*)spots, _mm256_or_si256(u, v));
+
+			// The flat is only 4096 bytes so the texels are loaded one at a
+			// time rather than gathered, which could read past its end.
+			const __m256i texels = _mm256_setr_epi32(
+					source[spots[0]], source[spots[1]], source[spots[2]], source[spots[3]],
+					source[spots[4]], source[spots[5]], source[spots[6]], source[spots[7]]);
+
+			_mm256_storeu_si256((__m256i*)dest, _mm256_i32gather_epi32(shademap, texels, 4));
+
+			dest += 8;
+
+			mufrac = _mm256_add_epi32(mufrac, mufracinc);
+			mvfrac = _mm256_add_epi32(mvfrac, mvfracinc);
+		} while (--batches);
+	}
+
+	// blit the remaining 0 - 7 pixels
+	while (remainder--)
+	{
+		const unsigned int spot = ((ufrac >> ushift) & umask) | ((vfrac >> vshift) & vmask);
+		*dest = colormap.shade(source[spot]);
+		dest++;
+
+		ufrac += ustep;
+		vfrac += vstep;
+	}
+}
+
+void R_DrawSpanD_AVX2 (void)
+{
+	R_DrawSpanD_AVX2(dspan);
+}
+
+
+//
+// R_DrawSlopeSpanRunD_AVX2
+//
+// Draws count pixels of a sloped span using affine texture mapping from
+// (ufrac, vfrac), eight pixels at a time.
+//
+static AVX2_TARGET void R_DrawSlopeSpanRunD_AVX2(argb_t* dest, const byte* src,
+		const shaderef_t* lighting, fixed_t ufrac, fixed_t vfrac,
+		fixed_t ustep, fixed_t vstep, int count)
+{
+	if (count >= 8)
+	{
+		const __m256i mumask = _mm256_set1_epi32(63);
+		const __m256i mvmask = _mm256_set1_epi32(0xFC0);
+
+		__m256i mufrac = _mm256_setr_epi32(
+				ufrac+ustep*0, ufrac+ustep*1, ufrac+ustep*2, ufrac+ustep*3,
+				ufrac+ustep*4, ufrac+ustep*5, ufrac+ustep*6, ufrac+ustep*7);
+		const __m256i mufracinc = _mm256_set1_epi32(ustep*8);
+		__m256i mvfrac = _mm256_setr_epi32(
+				vfrac+vstep*0, vfrac+vstep*1, vfrac+vstep*2, vfrac+vstep*3,
+				vfrac+vstep*4, vfrac+vstep*5, vfrac+vstep*6, vfrac+vstep*7);
+		const __m256i mvfracinc = _mm256_set1_epi32(vstep*8);
+
+		AVX2_ALIGNED(int spots[8]);
+
+		do {
+			const __m256i u = _mm256_and_si256(_mm256_srli_epi32(mufrac, 16), mumask);
+			const __m256i v = _mm256_and_si256(_mm256_srli_epi32(mvfrac, 10), mvmask);
+			_mm256_store_si256((__m256i*)spots, _mm256_or_si256(u, v));
+
+			// every pixel has its own light level
+			const __m256i colors = _mm256_setr_epi32(
+					lighting[0].shade(src[spots[0]]), lighting[1].shade(src[spots[1]]),
+					lighting[2].shade(src[spots[2]]), lighting[3].shade(src[spots[3]]),
+					lighting[4].shade(src[spots[4]]), lighting[5].shade(src[spots[5]]),
+					lighting[6].shade(src[spots[6]]), lighting[7].shade(src[spots[7]]));
+			_mm256_storeu_si256((__m256i*)dest, colors);
+
+			dest += 8;
+			lighting += 8;
+			ufrac += ustep * 8;
+			vfrac += vstep * 8;
+			count -= 8;
+
+			mufrac = _mm256_add_epi32(mufrac, mufracinc);
+			mvfrac = _mm256_add_epi32(mvfrac, mvfracinc);
+		} while (count >= 8);
+	}
+
+	while (count--)
+	{
+		*dest = lighting->shade(src[((vfrac >> 10) & 0xFC0) | ((ufrac >> 16) & 63)]);
+		dest++;
+		lighting++;
+		ufrac += ustep;
+		vfrac += vstep;
+	}
+}
+
+//
+// R_DrawSlopeSpanD_AVX2
+//
+// Renders a span for a sloped plane. The perspective correction is
+// calculated every SPANJUMP pixels exactly as R_DrawSlopeSpanD_c does and
+// the pixels between are drawn eight at a time.
+//
+AVX2_TARGET void R_DrawSlopeSpanD_AVX2 (void)
+{
+	int count = dspan.x2 - dspan.x1 + 1;
+	if (count <= 0)
+		return;
+
+#ifdef RANGECHECK
+	if (dspan.x2 < dspan.x1
+		|| dspan.x1 < 0
+		|| dspan.x2 >= I_GetSurfaceWidth()
+		|| dspan.y >= I_GetSurfaceHeight())
+	{
+		I_Error ("R_DrawSlopeSpan: %i to %i at %i",
+				 dspan.x1, dspan.x2, dspan.y);
+	}
+#endif
+
+	float iu = dspan.iu, iv = dspan.iv;
+	const float ius = dspan.iustep, ivs = dspan.ivstep;
+	float id = dspan.id, ids = dspan.idstep;
+
+	argb_t* dest = (argb_t*)dspan.destination + dspan.y * dspan.pitch_in_pixels + dspan.x1;
+	const byte* src = dspan.source;
+	const shaderef_t* lighting = dspan.slopelighting;
+
+	while (count >= SPANJUMP)
+	{
+		const float mulstart = 65536.0f / id;
+		id += ids * SPANJUMP;
+		const float mulend = 65536.0f / id;
+
+		const float ustart = iu * mulstart;
+		const float vstart = iv * mulstart;
+
+		fixed_t ufrac = (fixed_t)ustart;
+		fixed_t vfrac = (fixed_t)vstart;
+
+		iu += ius * SPANJUMP;
+		iv += ivs * SPANJUMP;
+
+		const float uend = iu * mulend;
+		const float vend = iv * mulend;
+
+		fixed_t ustep = (fixed_t)((uend - ustart) * INTERPSTEP);
+		fixed_t vstep = (fixed_t)((vend - vstart) * INTERPSTEP);
+
+		R_DrawSlopeSpanRunD_AVX2(dest, src, lighting, ufrac, vfrac, ustep, vstep, SPANJUMP);
+
+		dest += SPANJUMP;
+		lighting += SPANJUMP;
+		count -= SPANJUMP;
+	}
+
+	if (count > 0)
+	{
+		const float mulstart = 65536.0f / id;
+		id += ids * count;
+		const float mulend = 65536.0f / id;
+
+		const float ustart = iu * mulstart;
+		const float vstart = iv * mulstart;
+
+		fixed_t ufrac = (fixed_t)ustart;
+		fixed_t vfrac = (fixed_t)vstart;
+
+		iu += ius * count;
+		iv += ivs * count;
+
+		const float uend = iu * mulend;
+		const float vend = iv * mulend;
+
+		fixed_t ustep = (fixed_t)((uend - ustart) / count);
+		fixed_t vstep = (fixed_t)((vend - vstart) / count);
+
+		R_DrawSlopeSpanRunD_AVX2(dest, src, lighting, ufrac, vfrac, ustep, vstep, count);
+	}
+}
+
+
+//
+// R_FillTranslucentSpanD_AVX2
+//
+// Fills a span with a solid color using translucency, blending eight
+// pixels at a time.
+//
+AVX2_TARGET void R_FillTranslucentSpanD_AVX2(const drawspan_t& drawspan)
+{
+#ifdef RANGECHECK
+	if (drawspan.x2 < drawspan.x1 || drawspan.x1 < 0 || drawspan.x2 >= viewwidth ||
+		drawspan.y >= viewheight || drawspan.y < 0)
+	{
+		Printf(PRINT_HIGH, "R_FillSpan: %i to %i at %i", drawspan.x1, drawspan.x2, drawspan.y);
+		return;
+	}
+#endif
+
+	int count = drawspan.x2 - drawspan.x1 + 1;
+	if (count <= 0)
+		return;
+
+	const int fga = (drawspan.translevel & ~0x03FF) >> 8;
+	const int bga = 255 - fga;
+
+	// the blend must not overflow 16-bits, and bga must not be negative
+	if (fga < 0 || fga >= 256)
+	{
+		R_FillTranslucentSpanD_c(drawspan);
+		return;
+	}
+
+	const argb_t fg = drawspan.colormap.shade(drawspan.color);
+	argb_t* dest = (argb_t*)drawspan.destination + drawspan.y * drawspan.pitch_in_pixels + drawspan.x1;
+
+	if (count >= 8)
+	{
+		const __m256i zero = _mm256_setzero_si256();
+
+		// fg * fga is the same for every pixel
+		const __m256i fgterm = _mm256_mullo_epi16(
+				_mm256_unpacklo_epi8(_mm256_set1_epi32(fg), zero), _mm256_set1_epi16(fga));
+		const __m256i mbga = _mm256_set1_epi16(bga);
+
+		// alphablend2a always produces opaque colors
+		const __m256i opaque = _mm256_set1_epi32(argb_t(255, 0, 0, 0));
+
+		do {
+			const __m256i bg = _mm256_loadu_si256((__m256i*)dest);
+
+			// (bg * bga + fg * fga) >> 8 for each color channel
+			const __m256i lower = _mm256_srli_epi16(_mm256_add_epi16(
+					_mm256_mullo_epi16(_mm256_unpacklo_epi8(bg, zero), mbga), fgterm), 8);
+			const __m256i upper = _mm256_srli_epi16(_mm256_add_epi16(
+					_mm256_mullo_epi16(_mm256_unpackhi_epi8(bg, zero), mbga), fgterm), 8);
+
+			_mm256_storeu_si256((__m256i*)dest, _mm256_or_si256(_mm256_packus_epi16(lower, upper), opaque));
+
+			dest += 8;
+			count -= 8;
+		} while (count >= 8);
+	}
+
+	while (count--)
+	{
+		*dest = alphablend2a(*dest, bga, fg, fga);
+		dest++;
+	}
+}
+
+void R_FillTranslucentSpanD_AVX2 (void)
+{
+	R_FillTranslucentSpanD_AVX2(dspan);
+}
+
+
+//
+// r_dimpatchD_AVX2
+//
+// Blends a rectangle of the surface towards color, eight pixels at a time.
+//
+AVX2_TARGET void r_dimpatchD_AVX2(IWindowSurface* surface, argb_t color, int alpha, int x1, int y1, int w, int h)
+{
+	const int surface_pitch_pixels = surface->getPitchInPixels();
+
+	argb_t* line = (argb_t*)surface->getBuffer() + y1 * surface_pitch_pixels;
+
+	const __m256i zero = _mm256_setzero_si256();
+	const __m256i vec_color = _mm256_unpacklo_epi8(_mm256_set1_epi32(color), zero);
+	const __m256i vec_alpha = _mm256_set1_epi16(alpha);
+
+	// alphablend1a always produces opaque colors
+	const __m256i opaque = _mm256_set1_epi32(argb_t(255, 0, 0, 0));
+
+	for (int y = y1; y < y1 + h; y++)
+	{
+		int x = x1;
+
+		for (; x + 8 <= x1 + w; x += 8)
+		{
+			const __m256i input = _mm256_loadu_si256((__m256i*)(line + x));
+			__m256i lower = _mm256_unpacklo_epi8(input, zero);
+			__m256i upper = _mm256_unpackhi_epi8(input, zero);
+
+			// input + (((color - input) * alpha) >> 8), as alphablend1a does.
+			// The product needs more than 16-bits, so its bits 8 to 23 are
+			// put together from its low and high halves.
+			const __m256i difflower = _mm256_sub_epi16(vec_color, lower);
+			const __m256i diffupper = _mm256_sub_epi16(vec_color, upper);
+
+			lower = _mm256_add_epi16(lower, _mm256_or_si256(
+					_mm256_slli_epi16(_mm256_mulhi_epi16(difflower, vec_alpha), 8),
+					_mm256_srli_epi16(_mm256_mullo_epi16(difflower, vec_alpha), 8)));
+			upper = _mm256_add_epi16(upper, _mm256_or_si256(
+					_mm256_slli_epi16(_mm256_mulhi_epi16(diffupper, vec_alpha), 8),
+					_mm256_srli_epi16(_mm256_mullo_epi16(diffupper, vec_alpha), 8)));
+
+			_mm256_storeu_si256((__m256i*)(line + x), _mm256_or_si256(_mm256_packus_epi16(lower, upper), opaque));
+		}
+
+		for (; x < x1 + w; x++)
+			line[x] = alphablend1a(line[x], color, alpha);
+
+		line += surface_pitch_pixels;
+	}
+}
+
+
+//
+// r_blitrowPD_AVX2
+//
+// Converts 8bpp pixels to 32bpp eight at a time, gathering the colors from
+// the palette. When stretching, the source indexes are read one at a time
+// since gathering 32 bits at each one could read past the end of the
+// source surface.
+//
+AVX2_TARGET void r_blitrowPD_AVX2(argb_t* dest, const palindex_t* source, const argb_t* palette, int count, fixed_t xstep)
+{
+	const int* pal = (const int*)palette;
+	int x = 0;
+
+	if (xstep == FRACUNIT)
+	{
+		for (; x + 8 <= count; x += 8)
+		{
+			const __m256i indexes = _mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i*)(source + x)));
+			_mm256_storeu_si256((__m256i*)(dest + x), _mm256_i32gather_epi32(pal, indexes, 4));
+		}
+	}
+	else if (xstep == FRACUNIT / 2)
+	{
+		// doubling, as when blitting 320x200 to 640x400
+		const __m256i lowerhalf = _mm256_setr_epi32(0, 0, 1, 1, 2, 2, 3, 3);
+		const __m256i upperhalf = _mm256_setr_epi32(4, 4, 5, 5, 6, 6, 7, 7);
+
+		for (; x + 16 <= count; x += 16)
+		{
+			const __m256i indexes = _mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i*)(source + (x >> 1))));
+			const __m256i colors = _mm256_i32gather_epi32(pal, indexes, 4);
+			_mm256_storeu_si256((__m256i*)(dest + x), _mm256_permutevar8x32_epi32(colors, lowerhalf));
+			_mm256_storeu_si256((__m256i*)(dest + x + 8), _mm256_permutevar8x32_epi32(colors, upperhalf));
+		}
+	}
+	else
+	{
+		fixed_t xfrac = 0;
+		for (; x + 8 <= count; x += 8)
+		{
+			const __m256i indexes = _mm256_setr_epi32(
+					source[xfrac >> FRACBITS], source[(xfrac + xstep) >> FRACBITS],
+					source[(xfrac + 2 * xstep) >> FRACBITS], source[(xfrac + 3 * xstep) >> FRACBITS],
+					source[(xfrac + 4 * xstep) >> FRACBITS], source[(xfrac + 5 * xstep) >> FRACBITS],
+					source[(xfrac + 6 * xstep) >> FRACBITS], source[(xfrac + 7 * xstep) >> FRACBITS]);
+			_mm256_storeu_si256((__m256i*)(dest + x), _mm256_i32gather_epi32(pal, indexes, 4));
+			xfrac += 8 * xstep;
+		}
+	}
+
+	// Pick up the remainder:
+	for (fixed_t xfrac = x * xstep; x < count; x++, xfrac += xstep)
+		dest[x] = palette[source[xfrac >> FRACBITS]];
+}
+
+//
+// r_blitrowDD_AVX2
+//
+// Copies 32bpp pixels eight at a time, gathering them from the source when
+// it is being stretched or shrunk.
+//
+AVX2_TARGET void r_blitrowDD_AVX2(argb_t* dest, const argb_t* source, int count, fixed_t xstep)
+{
+	if (xstep == FRACUNIT)
+	{
+		memcpy(dest, source, count * sizeof(argb_t));
+		return;
+	}
+
+	const int* src = (const int*)source;
+	int x = 0;
+
+	if (xstep == FRACUNIT / 2)
+	{
+		const __m256i lowerhalf = _mm256_setr_epi32(0, 0, 1, 1, 2, 2, 3, 3);
+		const __m256i upperhalf = _mm256_setr_epi32(4, 4, 5, 5, 6, 6, 7, 7);
+
+		for (; x + 16 <= count; x += 16)
+		{
+			const __m256i pixels = _mm256_loadu_si256((const __m256i*)(src + (x >> 1)));
+			_mm256_storeu_si256((__m256i*)(dest + x), _mm256_permutevar8x32_epi32(pixels, lowerhalf));
+			_mm256_storeu_si256((__m256i*)(dest + x + 8), _mm256_permutevar8x32_epi32(pixels, upperhalf));
+		}
+	}
+	else
+	{
+		const __m256i steps = _mm256_mullo_epi32(_mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7),
+				_mm256_set1_epi32(xstep));
+		fixed_t xfrac = 0;
+		for (; x + 8 <= count; x += 8)
+		{
+			const __m256i fracs = _mm256_add_epi32(_mm256_set1_epi32(xfrac), steps);
+			const __m256i indexes = _mm256_srli_epi32(fracs, FRACBITS);
+			_mm256_storeu_si256((__m256i*)(dest + x), _mm256_i32gather_epi32(src, indexes, 4));
+			xfrac += 8 * xstep;
+		}
+	}
+
+	// Pick up the remainder:
+	for (fixed_t xfrac = x * xstep; x < count; x++, xfrac += xstep)
+		dest[x] = source[xfrac >> FRACBITS];
+}
+
+
+VERSION_CONTROL (r_drawt_avx2_cpp, "$Id$")
+
+#endif
@@ -56,29 +56,29 @@ static inline uintptr_t R_GetBytesUntilAligned(void* data, uintptr_t alignment)
 }
 
 
-void R_DrawSpanD_SSE2 (void)
+void R_DrawSpanD_SSE2 (const drawspan_t& drawspan)
 {
 #ifdef RANGECHECK
-	if (dspan.x2 < dspan.x1 || dspan.x1 < 0 || dspan.x2 >= viewwidth ||
-		dspan.y >= viewheight || dspan.y < 0)
+	if (drawspan.x2 < drawspan.x1 || drawspan.x1 < 0 || drawspan.x2 >= viewwidth ||
+		drawspan.y >= viewheight || drawspan.y < 0)
 	{
-		Printf(PRINT_HIGH, "R_DrawLevelSpan: %i to %i at %i", dspan.x1, dspan.x2, dspan.y);
+		Printf(PRINT_HIGH, "R_DrawLevelSpan: %i to %i at %i", drawspan.x1, drawspan.x2, drawspan.y);
 		return;
 	}
 #endif
 
-	const int width = dspan.x2 - dspan.x1 + 1;
+	const int width = drawspan.x2 - drawspan.x1 + 1;
 
 	// TODO: store flats in column-major format and swap u and v
-	dsfixed_t ufrac = dspan.yfrac;
-	dsfixed_t vfrac = dspan.xfrac;
-	dsfixed_t ustep = dspan.ystep;
-	dsfixed_t vstep = dspan.xstep;
+	dsfixed_t ufrac = drawspan.yfrac;
+	dsfixed_t vfrac = drawspan.xfrac;
+	dsfixed_t ustep = drawspan.ystep;
+	dsfixed_t vstep = drawspan.xstep;
 
-	const byte* source = dspan.source;
-	argb_t* dest = (argb_t*)dspan.destination + dspan.y * dspan.pitch_in_pixels + dspan.x1;
+	const byte* source = drawspan.source;
+	argb_t* dest = (argb_t*)drawspan.destination + drawspan.y * drawspan.pitch_in_pixels + drawspan.x1;
 
-	shaderef_t colormap = dspan.colormap;
+	shaderef_t colormap = drawspan.colormap;
 	
 	const int texture_width_bits = 6, texture_height_bits = 6;
 
@@ -174,6 +174,11 @@ void R_DrawSpanD_SSE2 (void)
 	}
 }
 
+void R_DrawSpanD_SSE2 (void)
+{
+	R_DrawSpanD_SSE2(dspan);
+}
+
 void R_DrawSlopeSpanD_SSE2 (void)
 {
 	int count = dspan.x2 - dspan.x1 + 1;
@@ -320,6 +325,140 @@ void R_DrawSlopeSpanD_SSE2 (void)
 }
 
 
+//
+// R_DrawColumnQuadD_SSE2
+//
+// [Odamex] Renders four adjacent columns, producing the same pixels as
+// R_DrawColumnD. The texture coordinates of the four columns are stepped
+// together and each row of four pixels is written with a single store.
+//
+void R_DrawColumnQuadD_SSE2(const drawcolumn_t* const* columns)
+{
+	int top, bottom;
+	if (!R_DrawColumnQuadEnds(columns, R_DrawColumnD, top, bottom))
+		return;
+
+	const drawcolumn_t& dc0 = *columns[0];
+	const drawcolumn_t& dc1 = *columns[1];
+	const drawcolumn_t& dc2 = *columns[2];
+	const drawcolumn_t& dc3 = *columns[3];
+
+	argb_t* dest = (argb_t*)dc0.destination + top * dc0.pitch_in_pixels + dc0.x;
+	const int pitch = dc0.pitch_in_pixels;
+	int count = bottom - top + 1;
+
+	__m128i mfrac = _mm_setr_epi32(
+			dc0.texturefrac + (top - dc0.yl) * dc0.iscale,
+			dc1.texturefrac + (top - dc1.yl) * dc1.iscale,
+			dc2.texturefrac + (top - dc2.yl) * dc2.iscale,
+			dc3.texturefrac + (top - dc3.yl) * dc3.iscale);
+	const __m128i mstep = _mm_setr_epi32(dc0.iscale, dc1.iscale, dc2.iscale, dc3.iscale);
+	const __m128i mmask = _mm_setr_epi32(
+			(dc0.textureheight >> FRACBITS) - 1, (dc1.textureheight >> FRACBITS) - 1,
+			(dc2.textureheight >> FRACBITS) - 1, (dc3.textureheight >> FRACBITS) - 1);
+
+	SSE2_ALIGNED(int spots[4]);
+
+	do {
+		_mm_store_si128((__m128i*)spots, _mm_and_si128(_mm_srai_epi32(mfrac, FRACBITS), mmask));
+
+		const __m128i colors = _mm_setr_epi32(
+				dc0.colormap.shade(dc0.source[spots[0]]),
+				dc1.colormap.shade(dc1.source[spots[1]]),
+				dc2.colormap.shade(dc2.source[spots[2]]),
+				dc3.colormap.shade(dc3.source[spots[3]]));
+		_mm_storeu_si128((__m128i*)dest, colors);
+
+		mfrac = _mm_add_epi32(mfrac, mstep);
+		dest += pitch;
+	} while (--count);
+}
+
+//
+// R_DrawTranslucentColumnQuadD_SSE2
+//
+// [Odamex] Renders four adjacent translucent columns, producing the same
+// pixels as R_DrawTranslucentColumnD. Each row of four pixels is blended
+// with the screen buffer at once.
+//
+void R_DrawTranslucentColumnQuadD_SSE2(const drawcolumn_t* const* columns)
+{
+	int fga[4];
+	for (int i = 0; i < 4; i++)
+	{
+		fga[i] = (columns[i]->translevel & ~0x03FF) >> 8;
+
+		// the blend must not overflow 16-bits
+		if (fga[i] < 0 || fga[i] > 256)
+		{
+			for (int j = 0; j < 4; j++)
+				R_DrawTranslucentColumnD(*columns[j]);
+			return;
+		}
+	}
+
+	int top, bottom;
+	if (!R_DrawColumnQuadEnds(columns, R_DrawTranslucentColumnD, top, bottom))
+		return;
+
+	const drawcolumn_t& dc0 = *columns[0];
+	const drawcolumn_t& dc1 = *columns[1];
+	const drawcolumn_t& dc2 = *columns[2];
+	const drawcolumn_t& dc3 = *columns[3];
+
+	argb_t* dest = (argb_t*)dc0.destination + top * dc0.pitch_in_pixels + dc0.x;
+	const int pitch = dc0.pitch_in_pixels;
+	int count = bottom - top + 1;
+
+	__m128i mfrac = _mm_setr_epi32(
+			dc0.texturefrac + (top - dc0.yl) * dc0.iscale,
+			dc1.texturefrac + (top - dc1.yl) * dc1.iscale,
+			dc2.texturefrac + (top - dc2.yl) * dc2.iscale,
+			dc3.texturefrac + (top - dc3.yl) * dc3.iscale);
+	const __m128i mstep = _mm_setr_epi32(dc0.iscale, dc1.iscale, dc2.iscale, dc3.iscale);
+	const __m128i mmask = _mm_setr_epi32(
+			(dc0.textureheight >> FRACBITS) - 1, (dc1.textureheight >> FRACBITS) - 1,
+			(dc2.textureheight >> FRACBITS) - 1, (dc3.textureheight >> FRACBITS) - 1);
+
+	// The alpha of each column, repeated for each of its color channels.
+	// The lower half holds the first two columns and the upper half the others.
+	const __m128i fgalower = _mm_setr_epi16(fga[0], fga[0], fga[0], fga[0], fga[1], fga[1], fga[1], fga[1]);
+	const __m128i fgaupper = _mm_setr_epi16(fga[2], fga[2], fga[2], fga[2], fga[3], fga[3], fga[3], fga[3]);
+	const __m128i bgalower = _mm_sub_epi16(_mm_set1_epi16(255), fgalower);
+	const __m128i bgaupper = _mm_sub_epi16(_mm_set1_epi16(255), fgaupper);
+
+	// alphablend2a always produces opaque colors
+	const __m128i opaque = _mm_set1_epi32(argb_t(255, 0, 0, 0));
+	const __m128i zero = _mm_setzero_si128();
+
+	SSE2_ALIGNED(int spots[4]);
+
+	do {
+		_mm_store_si128((__m128i*)spots, _mm_and_si128(_mm_srai_epi32(mfrac, FRACBITS), mmask));
+
+		const __m128i fg = _mm_setr_epi32(
+				dc0.colormap.shade(dc0.source[spots[0]]),
+				dc1.colormap.shade(dc1.source[spots[1]]),
+				dc2.colormap.shade(dc2.source[spots[2]]),
+				dc3.colormap.shade(dc3.source[spots[3]]));
+		const __m128i bg = _mm_loadu_si128((__m128i*)dest);
+
+		// (bg * bga + fg * fga) >> 8 for each color channel
+		const __m128i lower = _mm_srli_epi16(_mm_add_epi16(
+				_mm_mullo_epi16(_mm_unpacklo_epi8(bg, zero), bgalower),
+				_mm_mullo_epi16(_mm_unpacklo_epi8(fg, zero), fgalower)), 8);
+		const __m128i upper = _mm_srli_epi16(_mm_add_epi16(
+				_mm_mullo_epi16(_mm_unpackhi_epi8(bg, zero), bgaupper),
+				_mm_mullo_epi16(_mm_unpackhi_epi8(fg, zero), fgaupper)), 8);
+
+		_mm_storeu_si128((__m128i*)dest, _mm_or_si128(_mm_packus_epi16(lower, upper), opaque));
+
+		mfrac = _mm_add_epi32(mfrac, mstep);
+		dest += pitch;
+	} while (--count);
+}
+
+
 void r_dimpatchD_SSE2(IWindowSurface* surface, argb_t color, int alpha, int x1, int y1, int w, int h)
 {
 	int surface_pitch_pixels = surface->getPitchInPixels();
@@ -392,6 +531,91 @@ void r_dimpatchD_SSE2(IWindowSurface* surface, argb_t color, int alpha, int x1,
 }
 
 
+//
+// r_blitrowPD_SSE2
+//
+// Converts 8bpp pixels to 32bpp four at a time. SSE2 has no gather, so the
+// palette lookups stay scalar, but doubled pixels are written with a single
+// store and the lookups of each group are independent of one another.
+//
+void r_blitrowPD_SSE2(argb_t* dest, const palindex_t* source, const argb_t* palette, int count, fixed_t xstep)
+{
+	const int* pal = (const int*)palette;
+	int x = 0;
+
+	if (xstep == FRACUNIT / 2)
+	{
+		// doubling, as when blitting 320x200 to 640x400
+		for (; x + 4 <= count; x += 4)
+		{
+			const int c0 = pal[source[(x >> 1) + 0]];
+			const int c1 = pal[source[(x >> 1) + 1]];
+			_mm_storeu_si128((__m128i*)(dest + x), _mm_set_epi32(c1, c1, c0, c0));
+		}
+	}
+	else
+	{
+		fixed_t xfrac = 0;
+		for (; x + 4 <= count; x += 4)
+		{
+			const int c0 = pal[source[xfrac >> FRACBITS]];
+			const int c1 = pal[source[(xfrac + xstep) >> FRACBITS]];
+			const int c2 = pal[source[(xfrac + 2 * xstep) >> FRACBITS]];
+			const int c3 = pal[source[(xfrac + 3 * xstep) >> FRACBITS]];
+			_mm_storeu_si128((__m128i*)(dest + x), _mm_set_epi32(c3, c2, c1, c0));
+			xfrac += 4 * xstep;
+		}
+	}
+
+	// Pick up the remainder:
+	for (fixed_t xfrac = x * xstep; x < count; x++, xfrac += xstep)
+		dest[x] = palette[source[xfrac >> FRACBITS]];
+}
+
+//
+// r_blitrowDD_SSE2
+//
+// Copies 32bpp pixels, doubling them with unpacks when the source is being
+// stretched to twice its width.
+//
+void r_blitrowDD_SSE2(argb_t* dest, const argb_t* source, int count, fixed_t xstep)
+{
+	if (xstep == FRACUNIT)
+	{
+		memcpy(dest, source, count * sizeof(argb_t));
+		return;
+	}
+
+	int x = 0;
+
+	if (xstep == FRACUNIT / 2)
+	{
+		for (; x + 8 <= count; x += 8)
+		{
+			const __m128i pixels = _mm_loadu_si128((const __m128i*)(source + (x >> 1)));
+			_mm_storeu_si128((__m128i*)(dest + x), _mm_unpacklo_epi32(pixels, pixels));
+			_mm_storeu_si128((__m128i*)(dest + x + 4), _mm_unpackhi_epi32(pixels, pixels));
+		}
+	}
+	else
+	{
+		const int* src = (const int*)source;
+		fixed_t xfrac = 0;
+		for (; x + 4 <= count; x += 4)
+		{
+			_mm_storeu_si128((__m128i*)(dest + x), _mm_set_epi32(
+					src[(xfrac + 3 * xstep) >> FRACBITS], src[(xfrac + 2 * xstep) >> FRACBITS],
+					src[(xfrac + xstep) >> FRACBITS], src[xfrac >> FRACBITS]));
+			xfrac += 4 * xstep;
+		}
+	}
+
+	// Pick up the remainder:
+	for (fixed_t xfrac = x * xstep; x < count; x++, xfrac += xstep)
+		dest[x] = source[xfrac >> FRACBITS];
+}
+
+
 VERSION_CONTROL (r_drawt_sse2_cpp, "$Id$")
 
 #endif
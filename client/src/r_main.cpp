@@ -641,6 +641,7 @@ void R_Init()
 void STACK_ARGS R_Shutdown()
 {
     R_FreeTranslationTables();
+    R_ShutdownDrawThreads();
 }
 
 
@@ -1008,6 +1009,15 @@ void R_RenderPlayerView(player_t* player)
 	if (!viewactive)
 		return;
 
+	IWindowSurface* surface = R_GetRenderingSurface();
+
+	// NOTE(jsd): Full-screen status color blending:
+	// [Odamex] The blend is applied to the shademaps before the view is drawn
+	// instead of to every pixel of the view afterwards.
+	int blend_alpha = int(blend_color.geta() * 255.0f);
+	if (surface->getBitsPerPixel() == 32)
+		V_BeginViewBlend(V_GammaCorrect(blend_color), blend_alpha);
+
 	R_SetupFrame(player);
 
 	// Clear buffers.
@@ -1019,8 +1029,6 @@ void R_RenderPlayerView(player_t* player)
 
 	R_ResetDrawFuncs();
 
-	IWindowSurface* surface = R_GetRenderingSurface();
-
 	// [SL] fill the screen with a blinking solid color to make HOM more visible
 	if (r_flashhom)
 	{
@@ -1033,6 +1041,9 @@ void R_RenderPlayerView(player_t* player)
 
 	R_BeginInterpolation(render_lerp_amount);
 
+	// [Odamex] Queue the columns and spans for the drawing threads
+	R_BeginDrawQueue();
+
 	// [RH] Setup particles for this frame
 	R_FindParticleSubsectors();
 
@@ -1052,13 +1063,9 @@ void R_RenderPlayerView(player_t* player)
 
 	R_DrawMasked();
 
-	// NOTE(jsd): Full-screen status color blending:
-	int blend_alpha = int(blend_color.geta() * 255.0f);
-	if (surface->getBitsPerPixel() == 32 && blend_alpha > 0)
-	{
-		r_dimpatchD(surface, V_GammaCorrect(blend_color), blend_alpha,
-						viewwindowx, viewwindowy, viewwidth, viewheight);
-	}
+	R_EndDrawQueue();
+
+	V_EndViewBlend();
 
 	R_EndInterpolation();
 }
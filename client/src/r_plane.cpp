@@ -33,6 +33,8 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <algorithm>
+#include <vector>
 
 #include "i_system.h"
 #include "z_zone.h"
@@ -50,6 +52,7 @@
 #include "v_video.h"
 
 #include "m_vectors.h"
+#include "c_dispatch.h"
 #include <math.h>
 
 planefunction_t 		floorfunc;
@@ -65,6 +68,15 @@ static visplane_t		*visplanes[MAXVISPLANES];	// killough
 static visplane_t		*freetail;					// killough
 static visplane_t		**freehead = &freetail;		// killough
 
+// [Odamex] visible planes sorted by flat, reused every frame
+static std::vector<visplane_t*> sortedplanes;
+
+// [Odamex] counters reported by benchplanes
+static unsigned int		planescreated;
+static unsigned int		planesforked;
+static unsigned int		planecolumnscleared;
+static dtime_t			planedrawtime;
+
 visplane_t 				*floorplane;
 visplane_t 				*ceilingplane;
 visplane_t				*skyplane;
@@ -194,7 +206,7 @@ void R_MapSlopedPlane(int y, int x1, int x2)
 	dspan.x1 = x1;
 	dspan.x2 = x2;
 
-	spanslopefunc();
+	R_DispatchSpan(spanslopefunc);
 }
 
 
@@ -248,7 +260,7 @@ void R_MapLevelPlane(int y, int x1, int x2)
 	dspan.x1 = x1;
 	dspan.x2 = x2;
 
-	spanfunc();
+	R_DispatchSpan(spanfunc);
 }
 
 //
@@ -285,9 +297,27 @@ static visplane_t *new_visplane(unsigned hash)
 			freehead = &freetail;
 	check->next = visplanes[hash];
 	visplanes[hash] = check;
+	planescreated++;
 	return check;
 }
 
+//
+// R_ClearPlaneColumns
+//
+// [Odamex] Marks columns x1 through x2 of the visplane as empty. Only the
+// columns between minx and maxx are ever read, so rather than clearing the
+// whole width of the visplane when it is created, columns are cleared as
+// they are added to that range.
+//
+static inline void R_ClearPlaneColumns(visplane_t* pl, int x1, int x2)
+{
+	for (int x = x1; x <= x2; x++)
+		pl->top[x] = viewheight;
+
+	if (x2 >= x1)
+		planecolumnscleared += x2 - x1 + 1;
+}
+
 
 //
 // R_FindPlane
@@ -334,8 +364,6 @@ visplane_t *R_FindPlane (plane_t secplane, int picnum, int lightlevel,
 	check->minx = viewwidth;			// Was SCREENWIDTH -- killough 11/98
 	check->maxx = -1;
 
-	memcpy(check->top, viewheightarray, viewwidth * sizeof(*check->top));
-
 	return check;
 }
 
@@ -378,6 +406,16 @@ visplane_t* R_CheckPlane(visplane_t* pl, int start, int stop)
 	if (x > intrh)
 	{
 		// use the same visplane
+		if (pl->minx > pl->maxx)
+		{
+			R_ClearPlaneColumns(pl, unionl, unionh);
+		}
+		else
+		{
+			R_ClearPlaneColumns(pl, unionl, pl->minx - 1);
+			R_ClearPlaneColumns(pl, pl->maxx + 1, unionh);
+		}
+
 		pl->minx = unionl;
 		pl->maxx = unionh;
 	}
@@ -399,7 +437,8 @@ visplane_t* R_CheckPlane(visplane_t* pl, int start, int stop)
 		pl = new_pl;
 		pl->minx = start;
 		pl->maxx = stop;
-		memcpy(pl->top, viewheightarray, viewwidth * sizeof(*pl->top));
+		R_ClearPlaneColumns(pl, start, stop);
+		planesforked++;
 	}
 	return pl;
 }
@@ -585,95 +624,120 @@ void R_DrawLevelPlane(visplane_t *pl)
 }
 
 
+//
+// R_ComparePlanes
+//
+// [Odamex] Orders visplanes by flat and then by light level so that planes
+// sharing a flat and colormap are drawn one after another.
+//
+static bool R_ComparePlanes(const visplane_t* a, const visplane_t* b)
+{
+	if (a->picnum != b->picnum)
+		return a->picnum < b->picnum;
+	return a->lightlevel < b->lightlevel;
+}
+
 //
 // R_DrawPlanes
 //
 // At the end of each frame.
 //
+// [Odamex] Visplanes never overlap on the screen, so they are drawn grouped
+// by flat to keep each flat and its colormaps in the cache.
+//
 void R_DrawPlanes (void)
 {
-	visplane_t *pl;
-	int i;
+	dtime_t starttime = I_GetTime();
 
 	R_ResetDrawFuncs();
 
 	dspan.color = 3;
-	
-	for (i = 0; i < MAXVISPLANES; i++)
+
+	sortedplanes.clear();
+	for (int i = 0; i < MAXVISPLANES; i++)
 	{
-		for (pl = visplanes[i]; pl; pl = pl->next)
+		for (visplane_t* pl = visplanes[i]; pl; pl = pl->next)
 		{
-			if (pl->minx > pl->maxx)
-				continue;
+			if (pl->minx <= pl->maxx)
+				sortedplanes.push_back(pl);
+		}
+	}
 
-			// sky flat
-			if (pl->picnum == skyflatnum || pl->picnum & PL_SKYFLAT)
-			{
-				R_RenderSkyRange(pl);
-			}
-			else
+	std::sort(sortedplanes.begin(), sortedplanes.end(), R_ComparePlanes);
+
+	for (size_t i = 0; i < sortedplanes.size(); i++)
+	{
+		visplane_t* pl = sortedplanes[i];
+
+		// sky flat
+		if (pl->picnum == skyflatnum || pl->picnum & PL_SKYFLAT)
+		{
+			R_RenderSkyRange(pl);
+		}
+		else
+		{
+			// regular flat
+			int useflatnum = flattranslation[pl->picnum < numflats ? pl->picnum : 0];
+
+			dspan.color += 4;	// [RH] color if r_drawflat is 1
+			dspan.source = (byte *)W_CacheLumpNum (firstflat + useflatnum, PU_STATIC);
+									   
+			// [RH] warp a flat if desired
+			if (flatwarp[useflatnum])
 			{
-				// regular flat
-				int useflatnum = flattranslation[pl->picnum < numflats ? pl->picnum : 0];
-
-				dspan.color += 4;	// [RH] color if r_drawflat is 1
-				dspan.source = (byte *)W_CacheLumpNum (firstflat + useflatnum, PU_STATIC);
-										   
-				// [RH] warp a flat if desired
-				if (flatwarp[useflatnum])
+				if (warpedflats[useflatnum] && flatwarpedwhen[useflatnum] == level.time)
 				{
-					if (warpedflats[useflatnum] && flatwarpedwhen[useflatnum] == level.time)
+					Z_ChangeTag(dspan.source, PU_CACHE);
+					dspan.source = warpedflats[useflatnum];
+					Z_ChangeTag(dspan.source, PU_STATIC);
+				}
+				else
+				{
+					if (!warpedflats[useflatnum])
+						warpedflats[useflatnum] = (byte*)Z_Malloc(64*64, PU_STATIC, &warpedflats[useflatnum]);
+
+					static byte buffer[64];
+					int timebase = level.time*23;
+
+					flatwarpedwhen[useflatnum] = level.time;
+					byte *warped = warpedflats[useflatnum];
+
+					for (int x = 63; x >= 0; x--)
 					{
-						Z_ChangeTag(dspan.source, PU_CACHE);
-						dspan.source = warpedflats[useflatnum];
-						Z_ChangeTag(dspan.source, PU_STATIC);
+						int yt, yf = (finesine[(timebase + ((x+17) << 7))&FINEMASK]>>13) & 63;
+						byte *source = dspan.source + x;
+						byte *dest = warped + x;
+						for (yt = 64; yt; yt--, yf = (yf+1)&63, dest += 64)
+							*dest = *(source + (yf << 6));
 					}
-					else
+					timebase = level.time*32;
+					for (int y = 63; y >= 0; y--)
 					{
-						if (!warpedflats[useflatnum])
-							warpedflats[useflatnum] = (byte*)Z_Malloc(64*64, PU_STATIC, &warpedflats[useflatnum]);
-
-						static byte buffer[64];
-						int timebase = level.time*23;
-
-						flatwarpedwhen[useflatnum] = level.time;
-						byte *warped = warpedflats[useflatnum];
-
-						for (int x = 63; x >= 0; x--)
-						{
-							int yt, yf = (finesine[(timebase + ((x+17) << 7))&FINEMASK]>>13) & 63;
-							byte *source = dspan.source + x;
-							byte *dest = warped + x;
-							for (yt = 64; yt; yt--, yf = (yf+1)&63, dest += 64)
-								*dest = *(source + (yf << 6));
-						}
-						timebase = level.time*32;
-						for (int y = 63; y >= 0; y--)
-						{
-							int xt, xf = (finesine[(timebase + (y << 7))&FINEMASK]>>13) & 63;
-							byte *source = warped + (y << 6);
-							byte *dest = buffer;
-							for (xt = 64; xt; xt--, xf = (xf+1) & 63)
-								*dest++ = *(source+xf);
-							memcpy (warped + (y << 6), buffer, 64);
-						}
-						Z_ChangeTag (dspan.source, PU_CACHE);
-						dspan.source = warped;
+						int xt, xf = (finesine[(timebase + (y << 7))&FINEMASK]>>13) & 63;
+						byte *source = warped + (y << 6);
+						byte *dest = buffer;
+						for (xt = 64; xt; xt--, xf = (xf+1) & 63)
+							*dest++ = *(source+xf);
+						memcpy (warped + (y << 6), buffer, 64);
 					}
+					Z_ChangeTag (dspan.source, PU_CACHE);
+					dspan.source = warped;
 				}
-				
-				pl->top[pl->maxx+1] = viewheight;
-				pl->top[pl->minx-1] = viewheight;
-
-				if (P_IsPlaneLevel(&pl->secplane))
-					R_DrawLevelPlane(pl);
-				else
-					R_DrawSlopedPlane(pl);
-					
-				Z_ChangeTag (dspan.source, PU_CACHE);
 			}
+			
+			pl->top[pl->maxx+1] = viewheight;
+			pl->top[pl->minx-1] = viewheight;
+
+			if (P_IsPlaneLevel(&pl->secplane))
+				R_DrawLevelPlane(pl);
+			else
+				R_DrawSlopedPlane(pl);
+				
+			Z_ChangeTag (dspan.source, PU_CACHE);
 		}
 	}
+
+	planedrawtime += I_GetTime() - starttime;
 }
 
 //
@@ -771,5 +835,47 @@ BOOL R_AlignFlat (int linenum, int side, int fc)
 	return true;
 }
 
+
+//
+// benchplanes
+//
+// [Odamex] Renders the current view repeatedly and reports how many visplanes
+// were made and cleared per frame and how long drawing them took. Use
+// vid_setmode to compare different resolutions.
+//
+BEGIN_COMMAND (benchplanes)
+{
+	if (gamestate != GS_LEVEL)
+	{
+		Printf(PRINT_HIGH, "benchplanes: must be in a level\n");
+		return;
+	}
+
+	int frames = 100;
+	if (argc >= 2)
+		frames = MAX(atoi(argv[1]), 1);
+
+	planescreated = planesforked = planecolumnscleared = 0;
+	planedrawtime = 0;
+
+	I_BeginUpdate();
+
+	dtime_t start = I_GetTime();
+	for (int i = 0; i < frames; i++)
+		R_RenderPlayerView(&displayplayer());
+	dtime_t elapsed = I_GetTime() - start;
+
+	I_FinishUpdate();
+
+	Printf(PRINT_HIGH, "%dx%d view, %d frames:\n", viewwidth, viewheight, frames);
+	Printf(PRINT_HIGH, "%.1f visplanes per frame (%.1f forked), %.0f columns cleared per frame\n",
+			double(planescreated) / frames, double(planesforked) / frames,
+			double(planecolumnscleared) / frames);
+	Printf(PRINT_HIGH, "%.3f ms per frame drawing planes, %.3f ms per frame in total\n",
+			double(I_ConvertTimeToMs(planedrawtime)) / frames,
+			double(I_ConvertTimeToMs(elapsed)) / frames);
+}
+END_COMMAND (benchplanes)
+
 VERSION_CONTROL (r_plane_cpp, "$Id$")
 
@@ -227,7 +227,7 @@ static inline void R_BlastMaskedSegColumn(void (*drawfunc)())
 			dcol.source = post->data();
 
 			if (dcol.yl >= 0 && dcol.yh < viewheight && dcol.yl <= dcol.yh)
-				drawfunc();
+				R_DispatchColumn(drawfunc);
 			
 			post = post->next();
 		}
@@ -252,7 +252,7 @@ static inline void R_BlastSolidSegColumn(void (*drawfunc)())
 	dcol.texturefrac = dcol.texturemid + FixedMul((dcol.yl - centery + 1) << FRACBITS, dcol.iscale);
 
 	if (dcol.yl <= dcol.yh)
-		drawfunc();
+		R_DispatchColumn(drawfunc);
 }
 
 inline void SolidColumnBlaster()
@@ -612,7 +612,7 @@ void R_RenderMaskedSegRange(drawseg_t* ds, int x1, int x2)
 		int64_t(dcol.texturemid - texheight) * ds->scale2 > topscreenclip)
 		return;
 
-	basecolormap = frontsector->colormap->maps;	// [RH] Set basecolormap
+	basecolormap = frontsector->colormap->maps.with(0);	// [RH] Set basecolormap
 
 	// killough 4/13/98: get correct lightlevel for 2s normal textures
 	lightnum = (R_FakeFlat(frontsector, &tempsec, NULL, NULL, false)
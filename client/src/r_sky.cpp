@@ -193,7 +193,7 @@ static inline void R_BlastSkyColumn(void (*drawfunc)(void))
 	{
 		dcol.source = dcol.post->data();
 		dcol.texturefrac = dcol.texturemid + (dcol.yl - centery + 1) * dcol.iscale;
-		drawfunc();
+		R_DispatchColumn(drawfunc);
 	}
 }
 
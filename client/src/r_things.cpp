@@ -21,6 +21,8 @@
 //
 //-----------------------------------------------------------------------------
 
+#include <algorithm>
+
 #include "m_alloc.h"
 
 #include "doomdef.h"
@@ -382,7 +384,7 @@ void R_BlastSpriteColumn(void (*drawfunc)())
 		dcol.source = post->data();
 
 		if (dcol.yl >= 0 && dcol.yh < viewheight && dcol.yl <= dcol.yh)
-			drawfunc();
+			R_DispatchColumn(drawfunc);
 
 		post = post->next();
 	}
@@ -982,7 +984,7 @@ void R_DrawPlayerSprites (void)
 				|| sec->colormap->fade;
 
 	// [RH] set basecolormap
-	basecolormap = sec->colormap->maps;
+	basecolormap = sec->colormap->maps.with(0);
 
 	// get light level
 	lightnum = ((floorlight + ceilinglight) >> (LIGHTSEGSHIFT+1))
@@ -1031,17 +1033,101 @@ void R_DrawPlayerSprites (void)
 //		more vissprites that need to be sorted, the better the performance
 //		gain compared to the old function.
 //
+// [Odamex] Now uses a stable radix sort on a key made from the depth and
+//		the top of each sprite, which gives the same order as the old qsort
+//		comparison but takes linear time. The sort buffers are kept between
+//		frames and only grow along with MaxVisSprites.
+//
 
-static int				vsprcount;
-static vissprite_t**	spritesorter;
-static int				spritesorter_size = 0;
+struct spritesortitem_t
+{
+	uint64_t		key;
+	vissprite_t*	sprite;
+};
 
-static int STACK_ARGS sv_compare(const void *arg1, const void *arg2)
+static int					vsprcount;
+static vissprite_t**		spritesorter;
+static spritesortitem_t*	spritesortitems;
+static spritesortitem_t*	spritesorttemp;
+static int					spritesorter_size = 0;
+
+//
+// R_VisSpriteSortKey
+//
+// Sprites are drawn from the end of the sorted list, so the nearest sprites
+// sort first and of two sprites at the same depth, the one with the higher
+// top sorts first.
+//
+static inline uint64_t R_VisSpriteSortKey(const vissprite_t* vis)
+{
+	const uint32_t depth = uint32_t(vis->depth) ^ 0x80000000u;
+	const uint32_t top = ~(uint32_t(vis->gzt) ^ 0x80000000u);
+	return (uint64_t(depth) << 32) | top;
+}
+
+//
+// R_RadixSortVisSprites
+//
+// Sorts count items by key a byte at a time, starting with the lowest byte.
+// Bytes that are the same for every key are skipped. Returns whichever of
+// the two buffers holds the sorted items.
+//
+static spritesortitem_t* R_RadixSortVisSprites(spritesortitem_t* items, spritesortitem_t* temp, int count)
+{
+	unsigned int counts[8][256];
+	memset(counts, 0, sizeof(counts));
+
+	for (int i = 0; i < count; i++)
+	{
+		const uint64_t key = items[i].key;
+		for (int pass = 0; pass < 8; pass++)
+			counts[pass][(key >> (pass * 8)) & 0xFF]++;
+	}
+
+	for (int pass = 0; pass < 8; pass++)
+	{
+		unsigned int* passcounts = counts[pass];
+		const int shift = pass * 8;
+
+		if (passcounts[(items[0].key >> shift) & 0xFF] == (unsigned int)count)
+			continue;
+
+		unsigned int offset = 0;
+		for (int digit = 0; digit < 256; digit++)
+		{
+			const unsigned int digitcount = passcounts[digit];
+			passcounts[digit] = offset;
+			offset += digitcount;
+		}
+
+		for (int i = 0; i < count; i++)
+			temp[passcounts[(items[i].key >> shift) & 0xFF]++] = items[i];
+
+		std::swap(items, temp);
+	}
+
+	return items;
+}
+
+//
+// R_InsertionSortVisSprites
+//
+// A stable sort for the few sprites in most views, where the radix sort's
+// fixed cost would dominate.
+//
+static void R_InsertionSortVisSprites(spritesortitem_t* items, int count)
 {
-	int diff = (*(vissprite_t **)arg1)->depth - (*(vissprite_t **)arg2)->depth;
-	if (diff == 0)
-		return (*(vissprite_t **)arg2)->gzt - (*(vissprite_t **)arg1)->gzt;
-	return diff;
+	for (int i = 1; i < count; i++)
+	{
+		const spritesortitem_t item = items[i];
+		int j = i;
+		while (j > 0 && items[j - 1].key > item.key)
+		{
+			items[j] = items[j - 1];
+			j--;
+		}
+		items[j] = item;
+	}
 }
 
 void R_SortVisSprites (void)
@@ -1054,14 +1140,71 @@ void R_SortVisSprites (void)
 	if (spritesorter_size < MaxVisSprites)
 	{
 		delete [] spritesorter;
+		delete [] spritesortitems;
+		delete [] spritesorttemp;
 		spritesorter = new vissprite_t*[MaxVisSprites];
+		spritesortitems = new spritesortitem_t[MaxVisSprites];
+		spritesorttemp = new spritesortitem_t[MaxVisSprites];
 		spritesorter_size = MaxVisSprites;
 	}
 
 	for (int i = 0; i < vsprcount; i++)
-		spritesorter[i] = vissprites + i;
+	{
+		spritesortitems[i].key = R_VisSpriteSortKey(vissprites + i);
+		spritesortitems[i].sprite = vissprites + i;
+	}
+
+	const spritesortitem_t* sorted = spritesortitems;
+	if (vsprcount < 32)
+		R_InsertionSortVisSprites(spritesortitems, vsprcount);
+	else
+		sorted = R_RadixSortVisSprites(spritesortitems, spritesorttemp, vsprcount);
 
-	qsort(spritesorter, vsprcount, sizeof(vissprite_t *), sv_compare);
+	for (int i = 0; i < vsprcount; i++)
+		spritesorter[i] = sorted[i].sprite;
+}
+
+
+//
+// R_FindSolidSegScales
+//
+// [Odamex] Finds the scale of the drawseg that hides the whole of each
+// column, if any. Only one such drawseg can cover a column, since the BSP
+// traversal draws nothing more in a column once it is closed.
+//
+static fixed_t solidsegscale[MAXWIDTH];
+
+static void R_FindSolidSegScales()
+{
+	for (int x = 0; x < viewwidth; x++)
+		solidsegscale[x] = MININT;
+
+	for (const drawseg_t* ds = drawsegs; ds < ds_p; ds++)
+	{
+		if (ds->sprtopclip != viewheightarray || ds->sprbottomclip != negonearray)
+			continue;
+
+		const fixed_t scale = MIN<fixed_t>(ds->scale1, ds->scale2);
+		for (int x = ds->x1; x <= ds->x2; x++)
+			solidsegscale[x] = MAX<fixed_t>(solidsegscale[x], scale);
+	}
+}
+
+//
+// R_IsVisSpriteOccluded
+//
+// Returns true if every column of the sprite is hidden by a solid wall that
+// is nearer than any part of the sprite. R_DrawSprite would clip such a
+// sprite away entirely.
+//
+static bool R_IsVisSpriteOccluded(const vissprite_t* spr)
+{
+	for (int x = spr->x1; x <= spr->x2; x++)
+	{
+		if (solidsegscale[x] < spr->yscale)
+			return false;
+	}
+	return true;
 }
 
 
@@ -1206,8 +1349,15 @@ void R_DrawMasked (void)
 
 	R_SortVisSprites ();
 
+	if (vsprcount > 0)
+		R_FindSolidSegScales();
+
 	while (vsprcount > 0)
-		R_DrawSprite(spritesorter[--vsprcount]);
+	{
+		vissprite_t* spr = spritesorter[--vsprcount];
+		if (!R_IsVisSpriteOccluded(spr))
+			R_DrawSprite(spr);
+	}
 
 	// render any remaining masked mid textures
 
@@ -1353,7 +1503,7 @@ void R_DrawParticle(vissprite_t* vis)
 	dspan.color = vis->startfrac;
 
 	for (dspan.y = y1; dspan.y <= y2; dspan.y++)
-		R_FillTranslucentSpan();
+		R_DispatchSpan(R_FillTranslucentSpan);
 }
 
 VERSION_CONTROL (r_things_cpp, "$Id$")
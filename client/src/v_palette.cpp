@@ -26,6 +26,7 @@
 #include <math.h>
 #include <cstddef>
 #include <cassert>
+#include <vector>
 
 #include "doomstat.h"
 #include "i_system.h"
@@ -93,6 +94,195 @@ static char palette_lumpname[9];
 
 static int current_palette_num;
 
+
+// ----------------------------------------------------------------------------
+//
+// View Blending
+//
+// ----------------------------------------------------------------------------
+
+//
+// [Odamex] In 32bpp mode, the full-screen blend for damage, item pickups,
+// radiation suits and sector blends is applied to the shademap rows used
+// to render the view rather than to every pixel of the finished view.
+//
+// Blended copies of the rows are kept in an open-addressed table keyed by
+// the address of the source row. A row is only reblended when the blend
+// color changes, and the table is emptied when the source shademaps are
+// rebuilt.
+//
+
+struct blendedshaderow_t
+{
+	const argb_t*	source;
+	argb_t*			shademap;
+	unsigned int	generation;
+};
+
+static blendedshaderow_t* blendedrows = NULL;
+static size_t blendedrowsize = 0;
+static size_t numblendedrows = 0;
+
+// rows that have been allocated but are not in the table, ready for reuse
+static std::vector<argb_t*> freeblendedrows;
+
+static bool viewblending = false;
+static argb_t viewblendcolor;
+static int viewblendalpha = 0;
+static unsigned int viewblendgeneration = 0;
+
+static inline size_t V_HashShadeRow(const argb_t* source)
+{
+	// rows are 1024 bytes apart so the low bits carry nothing
+	return (size_t)((((uintptr_t)source >> 10) * 2654435761u) & (blendedrowsize - 1));
+}
+
+//
+// V_AllocShadeRow
+//
+// Returns storage for a 256 color row aligned to a cache line so that
+// the vectorized drawers can gather from it without splitting lines.
+//
+static argb_t* V_AllocShadeRow()
+{
+	if (!freeblendedrows.empty())
+	{
+		argb_t* row = freeblendedrows.back();
+		freeblendedrows.pop_back();
+		return row;
+	}
+
+	static const size_t ROWS_PER_BLOCK = 64;
+	byte* block = new byte[ROWS_PER_BLOCK * 256 * sizeof(argb_t) + 63];
+	argb_t* rows = (argb_t*)(((uintptr_t)block + 63) & ~(uintptr_t)63);
+
+	for (size_t i = 1; i < ROWS_PER_BLOCK; i++)
+		freeblendedrows.push_back(rows + 256 * i);
+	return rows;
+}
+
+static void V_InsertShadeRow(const blendedshaderow_t& entry)
+{
+	size_t i = V_HashShadeRow(entry.source);
+	while (blendedrows[i].source != NULL)
+		i = (i + 1) & (blendedrowsize - 1);
+	blendedrows[i] = entry;
+	numblendedrows++;
+}
+
+//
+// V_GrowShadeRowTable
+//
+// Doubles the size of the table once it is half full. The blended rows
+// themselves do not move, so shaderefs made earlier remain valid.
+//
+static void V_GrowShadeRowTable()
+{
+	blendedshaderow_t* oldrows = blendedrows;
+	size_t oldsize = blendedrowsize;
+
+	blendedrowsize = oldsize ? oldsize * 2 : 256;
+	blendedrows = new blendedshaderow_t[blendedrowsize];
+	memset(blendedrows, 0, blendedrowsize * sizeof(*blendedrows));
+	numblendedrows = 0;
+
+	for (size_t i = 0; i < oldsize; i++)
+	{
+		if (oldrows[i].source != NULL)
+			V_InsertShadeRow(oldrows[i]);
+	}
+
+	delete [] oldrows;
+}
+
+//
+// V_BlendShadeRow
+//
+// Returns the blended copy of a 256 color shademap row, blending it first
+// if the view blend has changed since it was last used.
+//
+static const argb_t* V_BlendShadeRow(const argb_t* source)
+{
+	if (numblendedrows * 2 >= blendedrowsize)
+		V_GrowShadeRowTable();
+
+	size_t i = V_HashShadeRow(source);
+	while (blendedrows[i].source != NULL && blendedrows[i].source != source)
+		i = (i + 1) & (blendedrowsize - 1);
+
+	blendedshaderow_t* entry = &blendedrows[i];
+	if (entry->source == NULL)
+	{
+		entry->source = source;
+		entry->shademap = V_AllocShadeRow();
+		entry->generation = viewblendgeneration - 1;
+		numblendedrows++;
+	}
+
+	if (entry->generation != viewblendgeneration)
+	{
+		for (int c = 0; c < 256; c++)
+			entry->shademap[c] = alphablend1a(source[c], viewblendcolor, viewblendalpha);
+		entry->generation = viewblendgeneration;
+	}
+
+	return entry->shademap;
+}
+
+//
+// V_BeginViewBlend
+//
+void V_BeginViewBlend(const argb_t color, const int alpha)
+{
+	if (alpha <= 0)
+		return;
+
+	if (alpha != viewblendalpha || color != viewblendcolor)
+	{
+		viewblendcolor = color;
+		viewblendalpha = alpha;
+		viewblendgeneration++;
+	}
+
+	viewblending = true;
+}
+
+//
+// V_EndViewBlend
+//
+void V_EndViewBlend()
+{
+	viewblending = false;
+}
+
+//
+// V_BlendViewColor
+//
+argb_t V_BlendViewColor(const argb_t color)
+{
+	if (!viewblending)
+		return color;
+	return alphablend1a(color, viewblendcolor, viewblendalpha);
+}
+
+//
+// V_InvalidateViewBlend
+//
+void V_InvalidateViewBlend()
+{
+	for (size_t i = 0; i < blendedrowsize; i++)
+	{
+		if (blendedrows[i].source != NULL)
+		{
+			freeblendedrows.push_back(blendedrows[i].shademap);
+			blendedrows[i].source = NULL;
+		}
+	}
+
+	numblendedrows = 0;
+}
+
+
 translationref_t::translationref_t() :
 	m_table(NULL), m_player_id(-1)
 {
@@ -149,6 +339,10 @@ shaderef_t::shaderef_t(const shademap_t* const colors, const int mapnum) :
 		else
 			m_shademap = NULL;
 
+		// [Odamex] use the blended shades while rendering the view
+		if (viewblending && m_shademap != NULL)
+			m_shademap = V_BlendShadeRow(m_shademap);
+
 		// Detect if the colormap is dynamic:
 		m_dyncolormap = NULL;
 
@@ -797,6 +991,8 @@ void BuildDefaultShademap(const palette_t* pal, shademap_t& maps)
 //
 void V_RefreshColormaps()
 {
+	V_InvalidateViewBlend();
+
 	BuildDefaultColorAndShademap(&default_palette, default_palette.maps);
 
 	NormalLight.maps = shaderef_t(&default_palette.maps, 0);
@@ -1011,6 +1207,9 @@ void BuildColoredLights(shademap_t* maps, int lr, int lg, int lb, int r, int g,
 	if (!maps)
 		return;
 
+	// [Odamex] the blended copies of the old maps are stale now
+	V_InvalidateViewBlend();
+
 	BuildLightRamp(*maps);
 
 	const argb_t* palette_colors = V_GetDefaultPalette()->basecolors;
@@ -197,6 +197,18 @@ CVAR_FUNC_IMPL(vid_vsync)
 }
 
 
+CVAR_FUNC_IMPL(vid_pipeline)
+{
+	// at most two frames can be in flight
+	float sanitized_var = clamp(var.value(), 0.0f, 2.0f);
+
+	if (var != sanitized_var)
+		var.Set(sanitized_var);
+	else if (gamestate != GS_STARTUP)
+        V_ForceVideoModeAdjustment();
+}
+
+
 CVAR_FUNC_IMPL(vid_overscan)
 {
 	if (gamestate != GS_STARTUP)
@@ -1097,9 +1097,10 @@ void STACK_ARGS D_ClearTaskSchedulers()
 // TICRATE times a second. If the framerate is uncapped, the simulation function
 // will still be called TICRATE times a second but the display function will
 // be called as often as possible. After each iteration through the loop,
-// the program yields briefly to the operating system.
+// the program yields briefly to the operating system, or calls wait_func with
+// the time of the next scheduled task if one is given.
 //
-void D_RunTics(void (*sim_func)(), void(*display_func)())
+void D_RunTics(void (*sim_func)(), void(*display_func)(), void (*wait_func)(dtime_t))
 {
 	D_InitTaskSchedulers(sim_func, display_func);
 
@@ -1123,6 +1124,12 @@ void D_RunTics(void (*sim_func)(), void(*display_func)())
 	dtime_t simulation_wake_time = simulation_scheduler->getNextTime();
 	dtime_t display_wake_time = display_scheduler->getNextTime();
 
+	if (wait_func)
+	{
+		wait_func(MIN(simulation_wake_time, display_wake_time));
+		return;
+	}
+
 	do
 	{
 		I_Yield();
@@ -79,7 +79,7 @@ extern std::vector<std::string> missingfiles, missinghashes;
 extern bool capfps;
 extern float maxfps;
 void STACK_ARGS D_ClearTaskSchedulers();
-void D_RunTics(void (*sim_func)(), void(*display_func)());
+void D_RunTics(void (*sim_func)(), void(*display_func)(), void (*wait_func)(dtime_t) = NULL);
 
 void D_AddWadCommandLineFiles(std::vector<std::string>& filenames);
 void D_AddDehCommandLineFiles(std::vector<std::string>& filenames);
@@ -0,0 +1,267 @@
+// Emacs style mode select   -*- C++ -*-
+//-----------------------------------------------------------------------------
+//
+// $Id$
+//
+// Copyright (C) 2006-2015 by The Odamex Team.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// DESCRIPTION:
+//	Reading and writing the parts of the netdemo file format that the
+//	client and server netdemo recorders have in common.
+//
+//-----------------------------------------------------------------------------
+
+#include <string.h>
+
+#include "doomtype.h"
+#include "m_swap.h"
+#include "minilzo.h"
+#include "version.h"
+#include "d_netdemo.h"
+
+//
+// D_WriteNetDemoHeader
+//
+//   Writes the header struct to the start of the netdemo file in
+//   little-endian format.  Does not close the file.
+//
+bool D_WriteNetDemoHeader(FILE *fp, const netdemo_header_t &header)
+{
+	netdemo_header_t tmpheader;
+	memcpy(&tmpheader, &header, sizeof(header));
+
+	// convert from native byte ordering to little-endian
+	tmpheader.snapshot_index_size	= LESHORT(tmpheader.snapshot_index_size);
+	tmpheader.snapshot_index_offset	= LELONG(tmpheader.snapshot_index_offset);
+	tmpheader.map_index_size		= LESHORT(tmpheader.map_index_size);
+	tmpheader.map_index_offset		= LELONG(tmpheader.map_index_offset);
+	tmpheader.snapshot_spacing		= LESHORT(tmpheader.snapshot_spacing);
+	tmpheader.starting_gametic		= LELONG(tmpheader.starting_gametic);
+	tmpheader.ending_gametic		= LELONG(tmpheader.ending_gametic);
+	tmpheader.block_index_size		= LELONG(tmpheader.block_index_size);
+	tmpheader.block_index_offset	= LELONG(tmpheader.block_index_offset);
+
+	fseek(fp, 0, SEEK_SET);
+	size_t cnt = 0;
+	cnt += sizeof(tmpheader.identifier) *
+		fwrite(&tmpheader.identifier, sizeof(tmpheader.identifier), 1, fp);
+	cnt += sizeof(tmpheader.version) *
+		fwrite(&tmpheader.version, sizeof(tmpheader.version), 1, fp);
+	cnt += sizeof(tmpheader.compression) *
+		fwrite(&tmpheader.compression, sizeof(tmpheader.compression), 1, fp);
+	cnt += sizeof(tmpheader.snapshot_index_size) *
+		fwrite(&tmpheader.snapshot_index_size, sizeof(tmpheader.snapshot_index_size), 1, fp);
+	cnt += sizeof(tmpheader.snapshot_index_offset)*
+		fwrite(&tmpheader.snapshot_index_offset, sizeof(tmpheader.snapshot_index_offset), 1, fp);
+	cnt += sizeof(tmpheader.map_index_size) *
+		fwrite(&tmpheader.map_index_size, sizeof(tmpheader.map_index_size), 1, fp);
+	cnt += sizeof(tmpheader.map_index_offset)*
+		fwrite(&tmpheader.map_index_offset, sizeof(tmpheader.map_index_offset), 1, fp);
+	cnt += sizeof(tmpheader.snapshot_spacing) *
+		fwrite(&tmpheader.snapshot_spacing, sizeof(tmpheader.snapshot_spacing), 1, fp);
+	cnt += sizeof(tmpheader.starting_gametic) *
+		fwrite(&tmpheader.starting_gametic, sizeof(tmpheader.starting_gametic), 1, fp);
+	cnt += sizeof(tmpheader.ending_gametic) *
+		fwrite(&tmpheader.ending_gametic, sizeof(tmpheader.ending_gametic), 1, fp);
+	cnt += sizeof(tmpheader.block_index_size) *
+		fwrite(&tmpheader.block_index_size, sizeof(tmpheader.block_index_size), 1, fp);
+	cnt += sizeof(tmpheader.block_index_offset) *
+		fwrite(&tmpheader.block_index_offset, sizeof(tmpheader.block_index_offset), 1, fp);
+	cnt += sizeof(tmpheader.reserved) *
+		fwrite(&tmpheader.reserved, sizeof(tmpheader.reserved), 1, fp);
+
+	return cnt >= NETDEMO_HEADER_SIZE;
+}
+
+//
+// D_ReadNetDemoHeader
+//
+//   Reads the header struct from the start of the netdemo file, converting
+//   it from little-endian format to whatever the architecture uses.  Does
+//   not close the file.
+//
+bool D_ReadNetDemoHeader(FILE *fp, netdemo_header_t &header)
+{
+	fseek(fp, 0, SEEK_SET);
+
+	size_t cnt = 0;
+	cnt += sizeof(header.identifier) *
+		fread(&header.identifier, sizeof(header.identifier), 1, fp);
+	cnt += sizeof(header.version) *
+		fread(&header.version, sizeof(header.version), 1, fp);
+	cnt += sizeof(header.compression) *
+		fread(&header.compression, sizeof(header.compression), 1, fp);
+	cnt += sizeof(header.snapshot_index_size) *
+		fread(&header.snapshot_index_size, sizeof(header.snapshot_index_size), 1, fp);
+	cnt += sizeof(header.snapshot_index_offset)*
+		fread(&header.snapshot_index_offset, sizeof(header.snapshot_index_offset), 1, fp);
+	cnt += sizeof(header.map_index_size) *
+		fread(&header.map_index_size, sizeof(header.map_index_size), 1, fp);
+	cnt += sizeof(header.map_index_offset)*
+		fread(&header.map_index_offset, sizeof(header.map_index_offset), 1, fp);
+	cnt += sizeof(header.snapshot_spacing) *
+		fread(&header.snapshot_spacing, sizeof(header.snapshot_spacing), 1, fp);
+	cnt += sizeof(header.starting_gametic) *
+		fread(&header.starting_gametic, sizeof(header.starting_gametic), 1, fp);
+	cnt += sizeof(header.ending_gametic) *
+		fread(&header.ending_gametic, sizeof(header.ending_gametic), 1, fp);
+	cnt += sizeof(header.block_index_size) *
+		fread(&header.block_index_size, sizeof(header.block_index_size), 1, fp);
+	cnt += sizeof(header.block_index_offset) *
+		fread(&header.block_index_offset, sizeof(header.block_index_offset), 1, fp);
+	cnt += sizeof(header.reserved) *
+		fread(&header.reserved, sizeof(header.reserved), 1, fp);
+
+	if (cnt < NETDEMO_HEADER_SIZE)
+		return false;
+
+	// convert from little-endian to native byte ordering
+	header.snapshot_index_size 		= LESHORT(header.snapshot_index_size);
+	header.snapshot_index_offset 	= LELONG(header.snapshot_index_offset);
+	header.map_index_size 			= LESHORT(header.map_index_size);
+	header.map_index_offset 		= LELONG(header.map_index_offset);
+	header.snapshot_spacing 		= LESHORT(header.snapshot_spacing);
+	header.starting_gametic 		= LELONG(header.starting_gametic);
+	header.ending_gametic			= LELONG(header.ending_gametic);
+	header.block_index_size			= LELONG(header.block_index_size);
+	header.block_index_offset		= LELONG(header.block_index_offset);
+
+	return true;
+}
+
+//
+// D_WriteNetDemoIndex
+//
+//   Writes an index to the netdemo file at the given offset, converting it
+//   to little-endian format.  Does not close the file.
+//
+bool D_WriteNetDemoIndex(FILE *fp, const std::vector<netdemo_index_entry_t> &index, uint32_t offset)
+{
+	fseek(fp, offset, SEEK_SET);
+
+	for (size_t i = 0; i < index.size(); i++)
+	{
+		netdemo_index_entry_t entry;
+		// convert to little-endian
+		entry.ticnum = LELONG(index[i].ticnum);
+		entry.offset = LELONG(index[i].offset);
+		
+		size_t cnt = 0;
+		cnt += sizeof(entry.ticnum) *
+			fwrite(&entry.ticnum, sizeof(entry.ticnum), 1, fp);
+		cnt += sizeof(entry.offset) *
+			fwrite(&entry.offset, sizeof(entry.offset), 1, fp);
+		
+		if (cnt < NETDEMO_INDEX_ENTRY_SIZE)
+			return false;
+	}
+
+	return true;
+}
+
+//
+// D_ReadNetDemoIndex
+//
+//   Reads an index of size entries from the netdemo file at the given
+//   offset, converting it from little-endian format.  Does not close the
+//   file.
+//
+bool D_ReadNetDemoIndex(FILE *fp, std::vector<netdemo_index_entry_t> &index, uint32_t offset, size_t size)
+{
+	if (fseek(fp, offset, SEEK_SET) != 0)
+		return false;
+
+	for (size_t i = 0; i < size; i++)
+	{
+		netdemo_index_entry_t entry;
+		
+		size_t cnt = 0;
+		cnt += sizeof(entry.ticnum) *
+			fread(&entry.ticnum, sizeof(entry.ticnum), 1, fp);
+		cnt += sizeof(entry.offset) *
+			fread(&entry.offset, sizeof(entry.offset), 1, fp);
+		
+		if (cnt < NETDEMO_INDEX_ENTRY_SIZE)
+			return false;
+
+		// convert from little-endian to native
+		entry.ticnum = LELONG(entry.ticnum);	
+		entry.offset = LELONG(entry.offset);
+
+		index.push_back(entry);
+	}
+
+	return true;
+}
+
+//
+// D_WriteNetDemoMessageHeader
+//
+//   Fills dest with the NETDEMO_MESSAGE_HEADER_SIZE bytes that precede each
+//   message: its type, length and gametic in little-endian order.
+//
+void D_WriteNetDemoMessageHeader(byte *dest, netdemo_message_t type, uint32_t length, uint32_t tic)
+{
+	length = LELONG(length);
+	tic = LELONG(tic);
+
+	dest[0] = static_cast<byte>(type);
+	memcpy(dest + 1, &length, sizeof(length));
+	memcpy(dest + 5, &tic, sizeof(tic));
+}
+
+//
+// D_WriteNetDemoBlock
+//
+//   Compresses blockbuf and writes it to the end of the netdemo file along
+//   with its block header, recording it in block_index.  blocktic is the
+//   gametic of the first message in the block.  blockbuf is emptied.
+//
+bool D_WriteNetDemoBlock(FILE *fp, std::vector<byte> &blockbuf, uint32_t blocktic,
+						 std::vector<netdemo_index_entry_t> &block_index)
+{
+	if (blockbuf.empty())
+		return true;
+
+	static lzo_align_t wrkmem[(LZO1X_1_MEM_COMPRESS + sizeof(lzo_align_t) - 1) / sizeof(lzo_align_t)];
+
+	// worst case expansion for incompressible data
+	std::vector<byte> compressed(blockbuf.size() + blockbuf.size() / 16 + 64 + 3);
+	lzo_uint compressed_len = 0;
+
+	if (lzo1x_1_compress(&blockbuf[0], blockbuf.size(), &compressed[0], &compressed_len, wrkmem) != LZO_E_OK)
+		return false;
+
+	fflush(fp);
+
+	netdemo_index_entry_t entry;
+	entry.ticnum = blocktic;
+	entry.offset = ftell(fp);
+	block_index.push_back(entry);
+
+	uint32_t blockheader[3];
+	blockheader[0] = LELONG((uint32_t)compressed_len);
+	blockheader[1] = LELONG((uint32_t)blockbuf.size());
+	blockheader[2] = LELONG(blocktic);
+
+	blockbuf.clear();
+
+	if (fwrite(blockheader, 1, NETDEMO_BLOCK_HEADER_SIZE, fp) < NETDEMO_BLOCK_HEADER_SIZE)
+		return false;
+	if (fwrite(&compressed[0], 1, compressed_len, fp) < compressed_len)
+		return false;
+
+	return true;
+}
+
+VERSION_CONTROL (d_netdemo_cpp, "$Id$")
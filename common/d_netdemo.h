@@ -0,0 +1,85 @@
+// Emacs style mode select   -*- C++ -*-
+//-----------------------------------------------------------------------------
+//
+// $Id$
+//
+// Copyright (C) 2006-2015 by The Odamex Team.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// DESCRIPTION:
+//	The netdemo file format, written by the client's netdemo recorder and
+//	by the server's.
+//
+//-----------------------------------------------------------------------------
+
+#ifndef __D_NETDEMO_H__
+#define __D_NETDEMO_H__
+
+#include "doomtype.h"
+#include <stdio.h>
+#include <vector>
+
+static const size_t NETDEMO_HEADER_SIZE = 64;
+static const size_t NETDEMO_MESSAGE_HEADER_SIZE = 9;
+static const size_t NETDEMO_INDEX_ENTRY_SIZE = 8;
+static const size_t NETDEMO_BLOCK_HEADER_SIZE = 12;
+
+static const size_t NETDEMO_BLOCK_SIZE = 65536;		// uncompressed size to start a new block at
+
+typedef enum
+{
+	NETDEMO_MSG_PACKET		= 0xAA,
+	NETDEMO_MSG_SNAPSHOT
+} netdemo_message_t;
+
+// [Odamex] Compressed netdemos store their messages in blocks of
+// LZO-compressed data, each preceded by a block header. Snapshots
+// always start a new block so that seeking to one only needs that
+// block to be decompressed.
+typedef enum
+{
+	NETDEMO_COMP_NONE		= 0,
+	NETDEMO_COMP_LZO_BLOCKS	= 1
+} netdemo_compression_t;
+
+typedef struct
+{
+	char		identifier[4];  		// "ODAD"
+	byte		version;
+	byte    	compression;    		// type of compression used
+	uint16_t	snapshot_index_size;	// number of snapshots in the index
+	uint32_t	snapshot_index_offset;	// offset from start of the file for the index
+	uint16_t	map_index_size;			// number of maps in the mapindex
+	uint32_t	map_index_offset;		// offset from start of the file for the mapindex
+	uint16_t	snapshot_spacing;		// number of gametics between indices
+	uint32_t	starting_gametic;		// the gametic the demo starts at
+	uint32_t	ending_gametic;			// the last gametic of the demo
+	uint32_t	block_index_size;		// number of compressed blocks
+	uint32_t	block_index_offset;		// offset from start of the file for the block index
+	byte		reserved[28];   		// for future use
+} netdemo_header_t;
+
+typedef struct
+{
+	uint32_t	ticnum;
+	uint32_t	offset;			// offset in the demo file
+} netdemo_index_entry_t;
+
+bool D_WriteNetDemoHeader(FILE *fp, const netdemo_header_t &header);
+bool D_ReadNetDemoHeader(FILE *fp, netdemo_header_t &header);
+bool D_WriteNetDemoIndex(FILE *fp, const std::vector<netdemo_index_entry_t> &index, uint32_t offset);
+bool D_ReadNetDemoIndex(FILE *fp, std::vector<netdemo_index_entry_t> &index, uint32_t offset, size_t size);
+void D_WriteNetDemoMessageHeader(byte *dest, netdemo_message_t type, uint32_t length, uint32_t tic);
+bool D_WriteNetDemoBlock(FILE *fp, std::vector<byte> &blockbuf, uint32_t blocktic,
+						 std::vector<netdemo_index_entry_t> &block_index);
+
+#endif
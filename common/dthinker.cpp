@@ -32,6 +32,9 @@
 #include "z_zone.h"
 #include "stats.h"
 #include "p_local.h"
+#include "m_mempool.h"
+#include "c_dispatch.h"
+#include "i_system.h"
 
 IMPLEMENT_SERIAL (DThinker, DObject)
 
@@ -272,17 +275,137 @@ void DThinker::RunThinkers ()
 	END_STAT (ThinkCycles);
 }
 
+//
+// Thinker allocation
+//
+// Thinkers (actors, sector movers, lights, etc) are allocated from a set of
+// size-class slabs so that spawning and removing them is a free list push or
+// pop rather than a walk of the zone. Each size class covers
+// SlabPool::ALIGNMENT bytes. Anything larger than the biggest size class
+// falls back to the zone.
+//
+static const size_t THINKER_MAX_SLAB_SIZE = 1024;
+static const size_t THINKER_NUM_SIZE_CLASSES = THINKER_MAX_SLAB_SIZE / SlabPool::ALIGNMENT;
+static const size_t THINKER_SLAB_INITIAL_COUNT = 256;
+
+static SlabPool* thinker_slabs[THINKER_NUM_SIZE_CLASSES];
+
+static SlabPool* GetThinkerSlab(size_t size)
+{
+	size_t sizeclass = (size - 1) / SlabPool::ALIGNMENT;
+	if (thinker_slabs[sizeclass] == NULL)
+	{
+		size_t block_size = (sizeclass + 1) * SlabPool::ALIGNMENT;
+		thinker_slabs[sizeclass] = new SlabPool(block_size, THINKER_SLAB_INITIAL_COUNT);
+	}
+	return thinker_slabs[sizeclass];
+}
+
 void *DThinker::operator new (size_t size)
 {
-	return Z_Malloc (size, PU_LEVSPEC, 0);
+	if (size == 0 || size > THINKER_MAX_SLAB_SIZE)
+		return Z_Malloc (size, PU_LEVSPEC, 0);
+	return GetThinkerSlab(size)->alloc();
 }
 
 // Deallocation is lazy -- it will not actually be freed
 // until its thinking turn comes up.
-void DThinker::operator delete (void *mem)
+//
+// DObject has a virtual destructor, so size is always the size of the
+// most-derived class and matches the size passed to operator new.
+void DThinker::operator delete (void *mem, size_t size)
+{
+	if (size == 0 || size > THINKER_MAX_SLAB_SIZE)
+		Z_Free (mem);
+	else
+		GetThinkerSlab(size)->free(mem);
+}
+
+//
+// DThinker::ResetAllocator
+//
+// Consolidates the thinker slabs between levels. A slab is only cleared if
+// every thinker allocated from it has been deleted.
+//
+void DThinker::ResetAllocator ()
+{
+	for (size_t i = 0; i < THINKER_NUM_SIZE_CLASSES; i++)
+	{
+		if (thinker_slabs[i] != NULL && thinker_slabs[i]->getStats().live == 0)
+			thinker_slabs[i]->clear();
+	}
+}
+
+static void PrintSlabStats(const char* name, const SlabPool* slab)
+{
+	const SlabPoolStats& stats = slab->getStats();
+	Printf(PRINT_HIGH, "%-12s %5u %9u %9u %6u %6u %8u\n",
+			name, (unsigned)slab->blockSize(),
+			(unsigned)stats.allocs, (unsigned)stats.frees,
+			(unsigned)stats.live, (unsigned)stats.peak,
+			(unsigned)slab->capacity());
+}
+
+BEGIN_COMMAND (slabstats)
+{
+	Printf(PRINT_HIGH, "%-12s %5s %9s %9s %6s %6s %8s\n",
+			"pool", "size", "allocs", "frees", "live", "peak", "bytes");
+
+	for (size_t i = 0; i < THINKER_NUM_SIZE_CLASSES; i++)
+	{
+		if (thinker_slabs[i] != NULL)
+			PrintSlabStats("thinkers", thinker_slabs[i]);
+	}
+
+	PrintSlabStats("secnodes", P_GetSecnodePool());
+}
+END_COMMAND (slabstats)
+
+//
+// benchslab
+//
+// Times allocating and freeing a number of AActor-sized blocks from a slab
+// compared to the zone, in the pattern seen when missiles are spawned
+// and removed.
+//
+BEGIN_COMMAND (benchslab)
 {
-	Z_Free (mem);
+	size_t count = 10000;
+	if (argc >= 2)
+		count = MAX(atoi(argv[1]), 1);
+
+	std::vector<void*> blocks(count);
+	SlabPool slab(sizeof(AActor), THINKER_SLAB_INITIAL_COUNT);
+
+	dtime_t start = I_GetTime();
+	for (int pass = 0; pass < 2; pass++)
+	{
+		for (size_t i = 0; i < count; i++)
+			blocks[i] = Z_Malloc(sizeof(AActor), PU_LEVSPEC, 0);
+		for (size_t i = 0; i < count; i += 2)
+			Z_Free(blocks[i]);
+		for (size_t i = 1; i < count; i += 2)
+			Z_Free(blocks[i]);
+	}
+	dtime_t zone_time = I_GetTime() - start;
+
+	start = I_GetTime();
+	for (int pass = 0; pass < 2; pass++)
+	{
+		for (size_t i = 0; i < count; i++)
+			blocks[i] = slab.alloc();
+		for (size_t i = 0; i < count; i += 2)
+			slab.free(blocks[i]);
+		for (size_t i = 1; i < count; i += 2)
+			slab.free(blocks[i]);
+	}
+	dtime_t slab_time = I_GetTime() - start;
+
+	Printf(PRINT_HIGH, "%u allocations of %u bytes: zone %.3fms, slab %.3fms\n",
+			(unsigned)(2 * count), (unsigned)sizeof(AActor),
+			double(zone_time) / 1e6, double(slab_time) / 1e6);
 }
+END_COMMAND (benchslab)
 
 VERSION_CONTROL (dthinker_cpp, "$Id$")
 
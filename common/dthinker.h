@@ -65,7 +65,9 @@ public:
 	virtual void RunThink () {}
 
 	void *operator new (size_t size);
-	void operator delete (void *block);
+	void operator delete (void *block, size_t size);
+
+	static void ResetAllocator ();
 
 	// Both the head and tail of the thinker list.
 	static DThinker *FirstThinker;
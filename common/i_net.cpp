@@ -56,6 +56,9 @@
 #	include <errno.h>
 #	include <unistd.h>
 #	include <sys/time.h>
+#	ifdef __linux__
+#		include <poll.h>
+#	endif
 #endif // WIN32
 
 #ifndef _WIN32
@@ -1104,6 +1107,57 @@ bool NetWaitOrTimeout(size_t ms)
 	return false;
 }
 
+//
+// NET_WaitForPacket
+//
+// [Odamex] Sleeps until a packet is waiting on the socket or until timeout
+// nanoseconds have passed. Returns true if a packet is waiting. Unlike
+// NetWaitOrTimeout, the timeout isn't rounded to whole milliseconds so
+// callers can wake precisely at a deadline.
+//
+bool NET_WaitForPacket(dtime_t timeout)
+{
+#if defined(__linux__)
+	struct pollfd pfd;
+	pfd.fd = inet_socket;
+	pfd.events = POLLIN;
+	pfd.revents = 0;
+
+	struct timespec ts;
+	ts.tv_sec = timeout / 1000000000LL;
+	ts.tv_nsec = timeout % 1000000000LL;
+
+	int ret = ppoll(&pfd, 1, &ts, NULL);
+
+	if (ret == -1 && errno != EINTR)
+		Printf(PRINT_HIGH, "ppoll returned -1: %s\n", strerror(errno));
+
+	return ret > 0;
+#else
+	// round up so that we never wake before the deadline
+	dtime_t usec = (timeout + 999LL) / 1000LL;
+	struct timeval tv;
+	tv.tv_sec = long(usec / 1000000LL);
+	tv.tv_usec = long(usec % 1000000LL);
+
+	fd_set fds;
+	FD_ZERO(&fds);
+	FD_SET(inet_socket, &fds);
+
+	int ret = select(inet_socket + 1, &fds, NULL, NULL, &tv);
+
+	#ifdef _WIN32
+		if (ret == SOCKET_ERROR)
+			Printf(PRINT_HIGH, "select returned SOCKET_ERROR: %d\n", WSAGetLastError());
+	#else
+		if (ret == -1 && errno != EINTR)
+			Printf(PRINT_HIGH, "select returned -1: %s\n", strerror(errno));
+	#endif
+
+	return ret > 0;
+#endif
+}
+
 void I_SetPort(netadr_t &addr, int port)
 {
    addr.port = htons(port);
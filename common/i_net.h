@@ -29,6 +29,7 @@
 #include "huffman.h"
 
 #include <string>
+#include <string.h>
 
 // Max packet size to send and receive, in bytes
 #define	MAX_UDP_PACKET 8192
@@ -347,17 +348,20 @@ public:
 				(data[oldpos+3]<<24);
 	}
 
+	// Returns a pointer to the string in the buffer rather than a copy
 	const char *ReadString()
 	{
 		byte *begin = data + readpos;
+		byte *end = (byte *)memchr(begin, 0, BytesLeftToRead());
 
-		while(ReadByte() > 0);
-
-		if(overflowed)
+		if(end == NULL)
 		{
+			readpos = cursize;
+			overflowed = true;
 			return "";
 		}
 
+		readpos += end - begin + 1;
 		return (const char *)begin;
 	}
 
@@ -533,6 +537,7 @@ void CloseNetwork (void);
 void InitNetCommon(void);
 void I_SetPort(netadr_t &addr, int port);
 bool NetWaitOrTimeout(size_t ms);
+bool NET_WaitForPacket(dtime_t timeout);
 
 char *NET_AdrToString (netadr_t a);
 bool NET_StringToAdr (const char *s, netadr_t *a);
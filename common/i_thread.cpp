@@ -0,0 +1,378 @@
+// Emacs style mode select   -*- C++ -*-
+//-----------------------------------------------------------------------------
+//
+// $Id$
+//
+// Copyright (C) 2006-2019 by The Odamex Team.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// DESCRIPTION:
+//	Threads, mutexes and condition variables.
+//
+//-----------------------------------------------------------------------------
+
+#include "i_thread.h"
+
+#if defined(_WIN32) && !defined(_XBOX)
+	#define ODA_THREADS_WIN32
+	#include "win32inc.h"
+	#include <process.h>
+#elif defined(UNIX) && !defined(GEKKO)
+	#define ODA_THREADS_PTHREAD
+	#include <pthread.h>
+	#include <unistd.h>
+#endif
+
+#include <cstdlib>
+
+#include "doomtype.h"
+
+
+#if defined(ODA_THREADS_PTHREAD)
+
+struct thread_s
+{
+	pthread_t		thread;
+	threadfunc_t	func;
+	void*			data;
+	int				result;
+};
+
+struct mutex_s
+{
+	pthread_mutex_t	mutex;
+};
+
+struct condvar_s
+{
+	pthread_cond_t	cond;
+};
+
+static void* ThreadEntry(void* arg)
+{
+	thread_t* thread = static_cast<thread_t*>(arg);
+	thread->result = thread->func(thread->data);
+	return NULL;
+}
+
+bool I_ThreadsAvailable()
+{
+	return true;
+}
+
+int I_GetNumCPUs()
+{
+	long count = sysconf(_SC_NPROCESSORS_ONLN);
+	return count > 0 ? (int)count : 1;
+}
+
+thread_t* I_CreateThread(threadfunc_t func, void* data)
+{
+	thread_t* thread = new thread_t;
+	thread->func = func;
+	thread->data = data;
+	thread->result = 0;
+
+	if (pthread_create(&thread->thread, NULL, ThreadEntry, thread) != 0)
+	{
+		delete thread;
+		return NULL;
+	}
+
+	return thread;
+}
+
+int I_WaitThread(thread_t* thread)
+{
+	if (thread == NULL)
+		return 0;
+
+	pthread_join(thread->thread, NULL);
+	int result = thread->result;
+	delete thread;
+	return result;
+}
+
+mutex_t* I_CreateMutex()
+{
+	mutex_t* mutex = new mutex_t;
+	pthread_mutex_init(&mutex->mutex, NULL);
+	return mutex;
+}
+
+void I_DestroyMutex(mutex_t* mutex)
+{
+	if (mutex == NULL)
+		return;
+
+	pthread_mutex_destroy(&mutex->mutex);
+	delete mutex;
+}
+
+void I_LockMutex(mutex_t* mutex)
+{
+	pthread_mutex_lock(&mutex->mutex);
+}
+
+void I_UnlockMutex(mutex_t* mutex)
+{
+	pthread_mutex_unlock(&mutex->mutex);
+}
+
+condvar_t* I_CreateCondVar()
+{
+	condvar_t* cond = new condvar_t;
+	pthread_cond_init(&cond->cond, NULL);
+	return cond;
+}
+
+void I_DestroyCondVar(condvar_t* cond)
+{
+	if (cond == NULL)
+		return;
+
+	pthread_cond_destroy(&cond->cond);
+	delete cond;
+}
+
+void I_WaitCondVar(condvar_t* cond, mutex_t* mutex)
+{
+	pthread_cond_wait(&cond->cond, &mutex->mutex);
+}
+
+void I_SignalCondVar(condvar_t* cond)
+{
+	pthread_cond_signal(&cond->cond);
+}
+
+void I_BroadcastCondVar(condvar_t* cond)
+{
+	pthread_cond_broadcast(&cond->cond);
+}
+
+#elif defined(ODA_THREADS_WIN32)
+
+// Native condition variables are only available from Vista onwards.
+#if defined(_WIN32_WINNT) && _WIN32_WINNT >= 0x0600
+	#define ODA_HAVE_WIN32_CONDVAR
+#endif
+
+struct thread_s
+{
+	HANDLE			handle;
+	threadfunc_t	func;
+	void*			data;
+	int				result;
+};
+
+struct mutex_s
+{
+	CRITICAL_SECTION	cs;
+};
+
+struct condvar_s
+{
+	#ifdef ODA_HAVE_WIN32_CONDVAR
+	CONDITION_VARIABLE	cond;
+	#endif
+};
+
+static unsigned __stdcall ThreadEntry(void* arg)
+{
+	thread_t* thread = static_cast<thread_t*>(arg);
+	thread->result = thread->func(thread->data);
+	return 0;
+}
+
+bool I_ThreadsAvailable()
+{
+	return true;
+}
+
+int I_GetNumCPUs()
+{
+	SYSTEM_INFO info;
+	GetSystemInfo(&info);
+	return info.dwNumberOfProcessors > 0 ? (int)info.dwNumberOfProcessors : 1;
+}
+
+thread_t* I_CreateThread(threadfunc_t func, void* data)
+{
+	thread_t* thread = new thread_t;
+	thread->func = func;
+	thread->data = data;
+	thread->result = 0;
+
+	thread->handle = (HANDLE)_beginthreadex(NULL, 0, ThreadEntry, thread, 0, NULL);
+	if (thread->handle == 0)
+	{
+		delete thread;
+		return NULL;
+	}
+
+	return thread;
+}
+
+int I_WaitThread(thread_t* thread)
+{
+	if (thread == NULL)
+		return 0;
+
+	WaitForSingleObject(thread->handle, INFINITE);
+	CloseHandle(thread->handle);
+	int result = thread->result;
+	delete thread;
+	return result;
+}
+
+mutex_t* I_CreateMutex()
+{
+	mutex_t* mutex = new mutex_t;
+	InitializeCriticalSection(&mutex->cs);
+	return mutex;
+}
+
+void I_DestroyMutex(mutex_t* mutex)
+{
+	if (mutex == NULL)
+		return;
+
+	DeleteCriticalSection(&mutex->cs);
+	delete mutex;
+}
+
+void I_LockMutex(mutex_t* mutex)
+{
+	EnterCriticalSection(&mutex->cs);
+}
+
+void I_UnlockMutex(mutex_t* mutex)
+{
+	LeaveCriticalSection(&mutex->cs);
+}
+
+condvar_t* I_CreateCondVar()
+{
+	condvar_t* cond = new condvar_t;
+	#ifdef ODA_HAVE_WIN32_CONDVAR
+	InitializeConditionVariable(&cond->cond);
+	#endif
+	return cond;
+}
+
+void I_DestroyCondVar(condvar_t* cond)
+{
+	delete cond;
+}
+
+// Without native condition variables, waiting degrades to briefly releasing
+// the mutex. This is a valid (if wasteful) condition variable since callers
+// must already cope with spurious wakeups.
+void I_WaitCondVar(condvar_t* cond, mutex_t* mutex)
+{
+	#ifdef ODA_HAVE_WIN32_CONDVAR
+	SleepConditionVariableCS(&cond->cond, &mutex->cs, INFINITE);
+	#else
+	LeaveCriticalSection(&mutex->cs);
+	Sleep(1);
+	EnterCriticalSection(&mutex->cs);
+	#endif
+}
+
+void I_SignalCondVar(condvar_t* cond)
+{
+	#ifdef ODA_HAVE_WIN32_CONDVAR
+	WakeConditionVariable(&cond->cond);
+	#endif
+}
+
+void I_BroadcastCondVar(condvar_t* cond)
+{
+	#ifdef ODA_HAVE_WIN32_CONDVAR
+	WakeAllConditionVariable(&cond->cond);
+	#endif
+}
+
+#else
+
+//
+// No thread support. Mutexes and condition variables are no-ops, and
+// I_CreateThread always fails so callers fall back to doing the work
+// themselves.
+//
+
+struct mutex_s { int dummy; };
+struct condvar_s { int dummy; };
+
+bool I_ThreadsAvailable()
+{
+	return false;
+}
+
+int I_GetNumCPUs()
+{
+	return 1;
+}
+
+thread_t* I_CreateThread(threadfunc_t func, void* data)
+{
+	return NULL;
+}
+
+int I_WaitThread(thread_t* thread)
+{
+	return 0;
+}
+
+mutex_t* I_CreateMutex()
+{
+	return new mutex_t;
+}
+
+void I_DestroyMutex(mutex_t* mutex)
+{
+	delete mutex;
+}
+
+void I_LockMutex(mutex_t* mutex)
+{
+}
+
+void I_UnlockMutex(mutex_t* mutex)
+{
+}
+
+condvar_t* I_CreateCondVar()
+{
+	return new condvar_t;
+}
+
+void I_DestroyCondVar(condvar_t* cond)
+{
+	delete cond;
+}
+
+void I_WaitCondVar(condvar_t* cond, mutex_t* mutex)
+{
+}
+
+void I_SignalCondVar(condvar_t* cond)
+{
+}
+
+void I_BroadcastCondVar(condvar_t* cond)
+{
+}
+
+#endif
+
+VERSION_CONTROL (i_thread_cpp, "$Id$")
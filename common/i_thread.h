@@ -0,0 +1,88 @@
+// Emacs style mode select   -*- C++ -*-
+//-----------------------------------------------------------------------------
+//
+// $Id$
+//
+// Copyright (C) 2006-2019 by The Odamex Team.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// DESCRIPTION:
+//	Threads, mutexes and condition variables.
+//	Uses pthreads on Unix-likes and the Win32 API on Windows. On platforms
+//	without thread support, I_ThreadsAvailable returns false and callers
+//	are expected to do their work on the calling thread instead.
+//
+//-----------------------------------------------------------------------------
+
+#ifndef __I_THREAD_H__
+#define __I_THREAD_H__
+
+#include <cstddef>
+
+struct thread_s;
+struct mutex_s;
+struct condvar_s;
+
+typedef struct thread_s thread_t;
+typedef struct mutex_s mutex_t;
+typedef struct condvar_s condvar_t;
+
+typedef int (*threadfunc_t)(void* data);
+
+bool I_ThreadsAvailable();
+int I_GetNumCPUs();
+
+// Starts running func(data) on a new thread. Returns NULL on failure.
+thread_t* I_CreateThread(threadfunc_t func, void* data);
+// Waits for the thread to finish, frees it, and returns func's result.
+int I_WaitThread(thread_t* thread);
+
+mutex_t* I_CreateMutex();
+void I_DestroyMutex(mutex_t* mutex);
+void I_LockMutex(mutex_t* mutex);
+void I_UnlockMutex(mutex_t* mutex);
+
+// Condition variables may wake spuriously, so always wait in a loop that
+// checks the condition being waited for.
+condvar_t* I_CreateCondVar();
+void I_DestroyCondVar(condvar_t* cond);
+void I_WaitCondVar(condvar_t* cond, mutex_t* mutex);
+void I_SignalCondVar(condvar_t* cond);
+void I_BroadcastCondVar(condvar_t* cond);
+
+
+//
+// OScopedLock
+//
+// Holds a mutex for the lifetime of the object.
+//
+class OScopedLock
+{
+public:
+	OScopedLock(mutex_t* mutex) : mMutex(mutex)
+	{
+		I_LockMutex(mMutex);
+	}
+
+	~OScopedLock()
+	{
+		I_UnlockMutex(mMutex);
+	}
+
+private:
+	OScopedLock(const OScopedLock&);
+	OScopedLock& operator=(const OScopedLock&);
+
+	mutex_t*	mMutex;
+};
+
+#endif	// __I_THREAD_H__
@@ -22,6 +22,11 @@
 //	the intial memory pool is exhausted, additional pools are allocated. These
 //	are consolodated into one large pool the next time clear() is called.
 //
+//	SlabPool builds on Pool to hand out fixed-size blocks that can be
+//	returned individually. Freed blocks are kept on a free list and reused
+//	before any new memory is taken from the underlying Pool. Calling clear()
+//	discards every block at once (eg, when the level changes).
+//
 //    
 //-----------------------------------------------------------------------------
 
@@ -57,15 +62,29 @@ public:
 
 		size_t new_size = 0;
 		if (block_size != NULL)
-			new_size = block_size[num_blocks - 1];
+			new_size = block_size[num_blocks - 1] / sizeof(T);
 		free_data();
 		resize(new_size);
 	}
 
+	// Returns the total number of bytes held by the pool.
+	size_t capacity() const
+	{
+		size_t total = 0;
+		for (size_t i = 0; i < num_blocks; i++)
+			total += block_size[i];
+		return total;
+	}
+
+	size_t numBlocks() const
+	{
+		return num_blocks;
+	}
+
 	T* alloc(size_t count = 1)
 	{
 		while (free_block + count * sizeof(T) > data_block[num_blocks - 1] + block_size[num_blocks - 1])
-			resize(2 * block_size[num_blocks - 1]);
+			resize(2 * block_size[num_blocks - 1] / sizeof(T));
 
 		T* ptr = reinterpret_cast<T*>(free_block);
 		free_block += count * sizeof(T);
@@ -122,4 +141,116 @@ private:
 	byte*		free_block;
 };
 
+
+//
+// SlabPoolStats
+//
+// Allocation counters kept by each SlabPool.
+//
+struct SlabPoolStats
+{
+	SlabPoolStats() :
+		allocs(0), frees(0), live(0), peak(0), resets(0)
+	{ }
+
+	size_t	allocs;		// number of blocks handed out since startup
+	size_t	frees;		// number of blocks returned since startup
+	size_t	live;		// number of blocks currently in use
+	size_t	peak;		// highest value of live since the last reset
+	size_t	resets;		// number of times the pool has been cleared
+};
+
+
+//
+// SlabPool
+//
+// A free list of fixed-size blocks carved out of a Pool. The block size is
+// chosen at construction and is rounded up so that every block is suitably
+// aligned and large enough to hold the free list link.
+//
+class SlabPool
+{
+public:
+	SlabPool(size_t size, size_t initial_max_count) :
+		block_size(align(size)),
+		pool(align(size) * initial_max_count), free_list(NULL)
+	{ }
+
+	size_t blockSize() const
+	{
+		return block_size;
+	}
+
+	void* alloc()
+	{
+		void* ptr;
+		if (free_list != NULL)
+		{
+			ptr = free_list;
+			free_list = free_list->next;
+		}
+		else
+		{
+			ptr = pool.alloc(block_size);
+		}
+
+		stats.allocs++;
+		if (++stats.live > stats.peak)
+			stats.peak = stats.live;
+		return ptr;
+	}
+
+	void free(void* ptr)
+	{
+		if (ptr == NULL)
+			return;
+
+		FreeBlock* block = static_cast<FreeBlock*>(ptr);
+		block->next = free_list;
+		free_list = block;
+
+		stats.frees++;
+		stats.live--;
+	}
+
+	// Discards every block, including those still in use.
+	void clear()
+	{
+		pool.clear();
+		free_list = NULL;
+		stats.live = stats.peak = 0;
+		stats.resets++;
+	}
+
+	const SlabPoolStats& getStats() const
+	{
+		return stats;
+	}
+
+	size_t capacity() const
+	{
+		return pool.capacity();
+	}
+
+	static const size_t ALIGNMENT = 16;
+
+private:
+	static size_t align(size_t size)
+	{
+		if (size < sizeof(void*))
+			size = sizeof(void*);
+		return (size + ALIGNMENT - 1) & ~(ALIGNMENT - 1);
+	}
+
+	struct FreeBlock
+	{
+		FreeBlock*	next;
+	};
+
+	size_t			block_size;
+	Pool<byte>		pool;
+	FreeBlock*		free_list;
+	SlabPoolStats	stats;
+};
+
 #endif // __M_MEMPOOL__
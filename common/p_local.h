@@ -211,6 +211,8 @@ angle_t P_PointToAngle(fixed_t xo, fixed_t yo, fixed_t x, fixed_t y);
 // P_MAP
 //
 
+class SlabPool;
+
 // If "floatok" true, move would be ok
 // if within "tmfloorz - tmceilingz".
 extern BOOL				floatok;
@@ -289,6 +291,8 @@ void	P_RadiusAttack (AActor *spot, AActor *source, int damage, int distance, boo
 
 void	P_DelSeclist(msecnode_t *);							// phares 3/16/98
 void	P_CreateSecNodeList(AActor*,fixed_t,fixed_t);		// phares 3/14/98
+void	P_ClearSecnodes();
+const SlabPool* P_GetSecnodePool();
 int		P_GetMoveFactor(const AActor *mo, int *frictionp);	// phares  3/6/98
 int		P_GetFriction(const AActor *mo, int *frictionfactor);
 BOOL	Check_Sides(AActor *, int, int);					// phares
@@ -40,6 +40,7 @@
 #include "r_state.h"
 
 #include "z_zone.h"
+#include "m_mempool.h"
 #include "p_unlag.h"
 #include "m_vectors.h"
 #include <math.h>
@@ -3067,35 +3068,38 @@ bool P_ChangeSector (sector_t *sector, bool crunch)
 // phares 3/21/98
 //
 // Maintain a freelist of msecnode_t's to reduce memory allocs and frees.
+//
+// [Odamex] The nodes live in a slab that is cleared by P_ClearSecnodes
+// when the level changes.
 
-msecnode_t *headsecnode = NULL;
+static SlabPool secnode_pool(sizeof(msecnode_t), 1024);
 
 // P_GetSecnode() retrieves a node from the freelist. The calling routine
 // should make sure it sets all fields properly.
 
 msecnode_t *P_GetSecnode()
 {
-	msecnode_t *node;
-
-	if (headsecnode)
-	{
-		node = headsecnode;
-		headsecnode = headsecnode->m_snext;
-	}
-	else
-		node = (msecnode_t *)Z_Malloc (sizeof(*node), PU_LEVEL, NULL);
-	return node;
+	return static_cast<msecnode_t*>(secnode_pool.alloc());
 }
 
 // P_PutSecnode() returns a node to the freelist.
 
 void P_PutSecnode (msecnode_t *node)
 {
-	if (!node)
-		return;
+	secnode_pool.free(node);
+}
 
-	node->m_snext = headsecnode;
-	headsecnode = node;
+// P_ClearSecnodes() discards every node at once. Any actor still holding
+// a touching_sectorlist must have it set to NULL first.
+
+void P_ClearSecnodes()
+{
+	secnode_pool.clear();
+}
+
+const SlabPool* P_GetSecnodePool()
+{
+	return &secnode_pool;
 }
 
 // phares 3/16/98
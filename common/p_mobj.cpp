@@ -38,6 +38,8 @@
 #include "p_mobj.h"
 #include "p_ctf.h"
 #include "gi.h"
+#include "c_dispatch.h"
+#include "i_net.h"
 
 #define WATER_SINK_FACTOR		3
 #define WATER_SINK_SMALL_FACTOR	4
@@ -78,8 +80,15 @@ int             iquetail;
 NetIDHandler ServerNetID;
 
 // denis - fast netid lookup
-typedef std::map<size_t, AActor::AActorPtr> netid_map_t;
-netid_map_t actor_by_netid;
+// [Odamex] Netids are handed out densely by NetIDHandler, so actors are found
+// by indexing a table of weak pointers rather than searching a map. A slot is
+// zeroed when its actor is deleted and is only trusted if the actor still
+// carries the netid being looked up, so a stale slot for a reassigned netid
+// never resolves to the wrong actor.
+typedef std::vector<AActor::AActorPtr> netid_table_t;
+static netid_table_t actor_by_netid;
+
+static const size_t NETID_TABLE_CHUNK = 512;
 
 IMPLEMENT_SERIAL(AActor, DThinker)
 
@@ -252,7 +261,7 @@ AActor::AActor (fixed_t ix, fixed_t iy, fixed_t iz, mobjtype_t itype) :
 	rndindex = M_Random();
 
     if (multiplayer && serverside)
-        netid = ServerNetID.ObtainNetID();
+        P_SetThingId(this, ServerNetID.ObtainNetID());
 
 	if (sv_skill != sk_nightmare)
 		reactiontime = info->reactiontime;
@@ -338,12 +347,15 @@ void P_ClearAllNetIds()
 //
 AActor* P_FindThingById(size_t id)
 {
-	netid_map_t::iterator i = actor_by_netid.find(id);
+	size_t slot = id & MAX_NETID;
+	if (slot == 0 || slot >= actor_by_netid.size())
+		return AActor::AActorPtr();
 
-	if(i == actor_by_netid.end())
+	AActor* mo = actor_by_netid[slot];
+	if (mo == NULL || mo->netid != (int)id)
 		return AActor::AActorPtr();
-	else
-		return i->second;
+
+	return mo;
 }
 
 //
@@ -352,10 +364,84 @@ AActor* P_FindThingById(size_t id)
 void P_SetThingId(AActor *mo, size_t newnetid)
 {
 	mo->netid = newnetid;
-	actor_by_netid[newnetid] = mo->ptr();
+
+	size_t slot = newnetid & MAX_NETID;
+	if (slot == 0)
+		return;
+
+	if (slot >= actor_by_netid.size())
+	{
+		size_t newsize = (slot / NETID_TABLE_CHUNK + 1) * NETID_TABLE_CHUNK;
+		actor_by_netid.resize(MIN(newsize, (size_t)MAX_NETID + 1));
+	}
+
+	actor_by_netid[slot] = mo->ptr();
 }
 
 
+//
+// benchnetid
+//
+// Measures how quickly actor references can be parsed out of a message,
+// the way CL_MoveMobj and friends resolve the netids they are sent. The
+// same lookups are also timed against a std::map for comparison.
+//
+BEGIN_COMMAND (benchnetid)
+{
+	size_t count = 1000000;
+	if (argc >= 2)
+		count = MAX(atoi(argv[1]), 1);
+
+	std::vector<int> netids;
+	std::map<size_t, AActor*> netid_map;
+
+	AActor* mo;
+	TThinkerIterator<AActor> iterator;
+	while ((mo = iterator.Next()))
+	{
+		if (mo->netid && P_FindThingById(mo->netid) == mo)
+		{
+			netids.push_back(mo->netid);
+			netid_map[mo->netid] = mo;
+		}
+	}
+
+	if (netids.empty())
+	{
+		Printf(PRINT_HIGH, "benchnetid: no actors with netids in the level\n");
+		return;
+	}
+
+	buf_t buf(count * 2 + 1);
+	for (size_t i = 0; i < count; i++)
+		buf.WriteShort(netids[M_Random() % netids.size()]);
+
+	size_t found = 0;
+	dtime_t start = I_GetTime();
+	buf.readpos = 0;
+	for (size_t i = 0; i < count; i++)
+	{
+		if (P_FindThingById(buf.ReadShort()))
+			found++;
+	}
+	dtime_t table_time = I_GetTime() - start;
+
+	start = I_GetTime();
+	buf.readpos = 0;
+	for (size_t i = 0; i < count; i++)
+	{
+		if (netid_map.find(buf.ReadShort()) != netid_map.end())
+			found++;
+	}
+	dtime_t map_time = I_GetTime() - start;
+
+	Printf(PRINT_HIGH, "%u lookups over %u actors: table %.3fms (%.1fM/s), map %.3fms (%.1fM/s)\n",
+			(unsigned)count, (unsigned)netids.size(),
+			double(table_time) / 1e6, double(count) * 1e3 / double(MAX(table_time, (dtime_t)1)),
+			double(map_time) / 1e6, double(count) * 1e3 / double(MAX(map_time, (dtime_t)1)));
+}
+END_COMMAND (benchnetid)
+
 //
 // P_ClearId
 //
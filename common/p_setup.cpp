@@ -157,7 +157,7 @@ void P_LoadVertexes (int lump)
 	vertexes = (vertex_t *)Z_Malloc (numvertexes*sizeof(vertex_t), PU_LEVEL, 0);
 
 	// Load data into cache.
-	data = (byte *)W_CacheLumpNum (lump, PU_STATIC);
+	data = (byte *)W_MapLumpNum (lump);
 
 	// Copy and convert vertex coordinates,
 	// internal representation as fixed.
@@ -168,7 +168,7 @@ void P_LoadVertexes (int lump)
 	}
 
 	// Free buffer memory.
-	Z_Free (data);
+	W_UnmapLumpNum (lump);
 }
 
 
@@ -186,7 +186,7 @@ void P_LoadSegs (int lump)
 	numsegs = W_LumpLength (lump) / sizeof(mapseg_t);
 	segs = (seg_t *)Z_Malloc (numsegs*sizeof(seg_t), PU_LEVEL, 0);
 	memset (segs, 0, numsegs*sizeof(seg_t));
-	data = (byte *)W_CacheLumpNum (lump, PU_STATIC);
+	data = (byte *)W_MapLumpNum (lump);
 
 	for (i = 0; i < numsegs; i++)
 	{
@@ -253,7 +253,7 @@ void P_LoadSegs (int lump)
 		li->length = FLOAT2FIXED(sqrt(dx * dx + dy* dy));
 	}
 
-	Z_Free (data);
+	W_UnmapLumpNum (lump);
 }
 
 
@@ -267,7 +267,7 @@ void P_LoadSubsectors (int lump)
 
 	numsubsectors = W_LumpLength (lump) / sizeof(mapsubsector_t);
 	subsectors = (subsector_t *)Z_Malloc (numsubsectors*sizeof(subsector_t),PU_LEVEL,0);
-	data = (byte *)W_CacheLumpNum (lump,PU_STATIC);
+	data = (byte *)W_MapLumpNum (lump);
 
 	memset (subsectors, 0, numsubsectors*sizeof(subsector_t));
 
@@ -277,7 +277,7 @@ void P_LoadSubsectors (int lump)
 		subsectors[i].firstline = (unsigned short)LESHORT(((mapsubsector_t *)data)[i].firstseg);
 	}
 
-	Z_Free (data);
+	W_UnmapLumpNum (lump);
 }
 
 
@@ -302,7 +302,7 @@ void P_LoadSectors (int lump)
 	sectors = new sector_t[numsectors];
 	memset(sectors, 0, sizeof(sector_t)*numsectors);
 
-	data = (byte *)W_CacheLumpNum (lump, PU_STATIC);
+	data = (byte *)W_MapLumpNum (lump);
 
 	if (level.flags & LEVEL_SNDSEQTOTALCTRL)
 		defSeqType = 0;
@@ -380,7 +380,7 @@ void P_LoadSectors (int lump)
 		ss->movefactor = ORIG_FRICTION_FACTOR;
 	}
 
-	Z_Free (data);
+	W_UnmapLumpNum (lump);
 }
 
 
@@ -398,7 +398,7 @@ void P_LoadNodes (int lump)
 
 	numnodes = W_LumpLength (lump) / sizeof(mapnode_t);
 	nodes = (node_t *)Z_Malloc (numnodes*sizeof(node_t), PU_LEVEL, 0);
-	data = (byte *)W_CacheLumpNum (lump, PU_STATIC);
+	data = (byte *)W_MapLumpNum (lump);
 
 	mn = (mapnode_t *)data;
 	no = nodes;
@@ -426,7 +426,7 @@ void P_LoadNodes (int lump)
 		}
 	}
 
-	Z_Free (data);
+	W_UnmapLumpNum (lump);
 }
 
 //
@@ -571,7 +571,7 @@ bool P_LoadXNOD(int lump)
 void P_LoadThings (int lump)
 {
 	mapthing2_t mt2;		// [RH] for translation
-	byte *data = (byte *)W_CacheLumpNum (lump, PU_STATIC);
+	byte *data = (byte *)W_MapLumpNum (lump);
 	mapthing_t *mt = (mapthing_t *)data;
 	mapthing_t *lastmt = (mapthing_t *)(data + W_LumpLength (lump));
 
@@ -605,7 +605,7 @@ void P_LoadThings (int lump)
 		P_SpawnMapThing (&mt2, 0);
 	}
 
-	Z_Free (data);
+	W_UnmapLumpNum (lump);
 }
 
 // [RH]
@@ -768,7 +768,7 @@ void P_LoadLineDefs (int lump)
 	numlines = W_LumpLength (lump) / sizeof(maplinedef_t);
 	lines = (line_t *)Z_Malloc (numlines*sizeof(line_t), PU_LEVEL, 0);
 	memset (lines, 0, numlines*sizeof(line_t));
-	data = (byte *)W_CacheLumpNum (lump, PU_STATIC);
+	data = (byte *)W_MapLumpNum (lump);
 
 	ld = lines;
 	for (i=0 ; i<numlines ; i++, ld++)
@@ -804,7 +804,7 @@ void P_LoadLineDefs (int lump)
 		P_AdjustLine (ld);
 	}
 
-	Z_Free (data);
+	W_UnmapLumpNum (lump);
 }
 
 // [RH] Same as P_LoadLineDefs() except it uses Hexen-style LineDefs.
@@ -818,7 +818,7 @@ void P_LoadLineDefs2 (int lump)
 	numlines = W_LumpLength (lump) / sizeof(maplinedef2_t);
 	lines = (line_t *)Z_Malloc (numlines*sizeof(line_t), PU_LEVEL,0 );
 	memset (lines, 0, numlines*sizeof(line_t));
-	data = (byte *)W_CacheLumpNum (lump, PU_STATIC);
+	data = (byte *)W_MapLumpNum (lump);
 
 	mld = (maplinedef2_t *)data;
 	ld = lines;
@@ -857,7 +857,7 @@ void P_LoadLineDefs2 (int lump)
 		P_AdjustLine (ld);
 	}
 
-	Z_Free (data);
+	W_UnmapLumpNum (lump);
 }
 
 //
@@ -979,7 +979,7 @@ static void SetTextureNoErr (short *texture, unsigned int *color, char *name)
 
 void P_LoadSideDefs2 (int lump)
 {
-	byte* data = (byte*)W_CacheLumpNum(lump, PU_STATIC);
+	byte* data = (byte*)W_MapLumpNum(lump);
 
 	for (int i = 0; i < numsides; i++)
 	{
@@ -1049,7 +1049,7 @@ void P_LoadSideDefs2 (int lump)
 			break;
 		}
 	}
-	Z_Free (data);
+	W_UnmapLumpNum (lump);
 }
 
 
@@ -1685,6 +1685,8 @@ void P_SetupLevel (char *lumpname, int position)
 	shootthing = NULL;
 
 	DThinker::DestroyAllThinkers ();
+	DThinker::ResetAllocator ();
+	P_ClearSecnodes ();
 	Z_FreeTags (PU_LEVEL, PU_PURGELEVEL-1);
 	NormalLight.next = NULL;	// [RH] Z_FreeTags frees all the custom colormaps
 
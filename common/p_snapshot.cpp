@@ -0,0 +1,234 @@
+// Emacs style mode select   -*- C++ -*-
+//-----------------------------------------------------------------------------
+//
+// $Id$
+//
+// Copyright (C) 2006-2015 by The Odamex Team.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// DESCRIPTION:
+//	Snapshots of actor positions for interpolating sparse server updates
+//
+//-----------------------------------------------------------------------------
+
+#include "doomdef.h"
+#include "m_vectors.h"
+#include "p_snapshot.h"
+
+// An actor that covers more ground than this per tic between two updates
+// was teleported or respawned and its movement should not be smoothed
+static const fixed_t MAX_ACTOR_SPEED = 64 * FRACUNIT;
+
+// ============================================================================
+//
+// ActorSnapshotManager implementation
+//
+// ============================================================================
+
+ActorSnapshotManager::ActorSnapshotManager() :
+	mMostRecent(-1)
+{
+}
+
+bool ActorSnapshotManager::empty() const
+{
+	return !mValidSnapshot(mMostRecent);
+}
+
+void ActorSnapshotManager::clearSnapshots()
+{
+	for (int i = 0; i < NUM_SNAPSHOTS; i++)
+		mSnaps[i] = ActorSnapshot();
+
+	mMostRecent = -1;
+}
+
+//
+// ActorSnapshotManager::mValidSnapshot
+//
+// Returns true if the snapshot for the given time is within the window
+// of the container and has not been overwritten by a newer snapshot.
+//
+bool ActorSnapshotManager::mValidSnapshot(int time) const
+{
+	if (time < 0 || time > mMostRecent || mMostRecent - time >= NUM_SNAPSHOTS)
+		return false;
+
+	const ActorSnapshot &snap = mSnaps[time % NUM_SNAPSHOTS];
+	return snap.isValid() && snap.getTime() == time;
+}
+
+//
+// ActorSnapshotManager::mFindValidSnapshot
+//
+// Returns the time of the first valid snapshot found searching from
+// starttime towards endtime, or -1 if there are none.
+//
+int ActorSnapshotManager::mFindValidSnapshot(int starttime, int endtime) const
+{
+	int step = starttime <= endtime ? 1 : -1;
+
+	for (int time = starttime; time != endtime + step; time += step)
+	{
+		if (mValidSnapshot(time))
+			return time;
+	}
+
+	return -1;
+}
+
+//
+// ActorSnapshotManager::addSnapshot
+//
+// Adds an authoritative snapshot to the container, merging it with any
+// snapshot already received for the same gametic.
+//
+void ActorSnapshotManager::addSnapshot(const ActorSnapshot &snap)
+{
+	int time = snap.getTime();
+	if (time < 0 || (mMostRecent >= 0 && mMostRecent - time >= NUM_SNAPSHOTS))
+		return;
+
+	if (mValidSnapshot(time))
+		mSnaps[time % NUM_SNAPSHOTS].merge(snap);
+	else
+		mSnaps[time % NUM_SNAPSHOTS] = snap;
+
+	if (time > mMostRecent)
+		mMostRecent = time;
+
+	ActorSnapshot &newsnap = mSnaps[time % NUM_SNAPSHOTS];
+
+	// The actor's movement is continuous if it could have plausibly moved
+	// from its previous position to its new one
+	bool continuous = false;
+
+	int prevtime = mFindValidSnapshot(time - 1, time - NUM_SNAPSHOTS + 1);
+	if (prevtime != -1)
+	{
+		const ActorSnapshot &prevsnap = mSnaps[prevtime % NUM_SNAPSHOTS];
+
+		v3fixed_t delta;
+		M_SetVec3Fixed(&delta, newsnap.getX() - prevsnap.getX(),
+							   newsnap.getY() - prevsnap.getY(),
+							   newsnap.getZ() - prevsnap.getZ());
+
+		continuous = M_LengthVec3Fixed(&delta) <= MAX_ACTOR_SPEED * (time - prevtime);
+	}
+
+	newsnap.setContinuous(continuous);
+}
+
+//
+// ActorSnapshotManager::mInterpolateSnapshots
+//
+// Returns a snapshot between the two snapshots bracketing time.
+//
+ActorSnapshot ActorSnapshotManager::mInterpolateSnapshots(int from, int to, int time) const
+{
+	const ActorSnapshot &fromsnap = mSnaps[from % NUM_SNAPSHOTS];
+	const ActorSnapshot &tosnap = mSnaps[to % NUM_SNAPSHOTS];
+
+	if (!tosnap.isContinuous())
+		return fromsnap;
+
+	float amount = float(time - from) / float(to - from);
+
+	ActorSnapshot newsnap = P_LerpActorPosition(fromsnap, tosnap, amount);
+	newsnap.setTime(time);
+	newsnap.setAuthoritative(false);
+	newsnap.setContinuous(true);
+	newsnap.setInterpolated(true);
+	newsnap.setExtrapolated(false);
+
+	return newsnap;
+}
+
+//
+// ActorSnapshotManager::mExtrapolateSnapshot
+//
+// Returns a snapshot that continues the actor's movement past the most
+// recent snapshot.  Missiles and other actors with momentum are moved along
+// their momentum.  Walking monsters have no momentum, so their velocity is
+// estimated from their previous update.  They are only moved until their
+// next update is due, since the server stops sending updates for monsters
+// that have stopped moving; after that, they are held at their most recent
+// position so they aren't left at an overshot position.
+//
+ActorSnapshot ActorSnapshotManager::mExtrapolateSnapshot(int from, int time) const
+{
+	const ActorSnapshot &snap = mSnaps[from % NUM_SNAPSHOTS];
+	ActorSnapshot newsnap(snap);
+
+	if (snap.getMomX() || snap.getMomY() || snap.getMomZ())
+	{
+		newsnap = P_ExtrapolateActorPosition(snap, float(time - from));
+	}
+	else if (snap.isContinuous())
+	{
+		int prevtime = mFindValidSnapshot(from - 1, from - NUM_SNAPSHOTS + 1);
+		if (prevtime != -1)
+		{
+			const ActorSnapshot &prevsnap = mSnaps[prevtime % NUM_SNAPSHOTS];
+
+			int interval = from - prevtime;
+			int amount = time - from;
+
+			if (amount <= interval)
+			{
+				newsnap.setX(snap.getX() + (snap.getX() - prevsnap.getX()) / interval * amount);
+				newsnap.setY(snap.getY() + (snap.getY() - prevsnap.getY()) / interval * amount);
+				newsnap.setZ(snap.getZ() + (snap.getZ() - prevsnap.getZ()) / interval * amount);
+			}
+		}
+	}
+
+	newsnap.setTime(time);
+	newsnap.setAuthoritative(false);
+	newsnap.setContinuous(true);
+	newsnap.setInterpolated(false);
+	newsnap.setExtrapolated(true);
+
+	return newsnap;
+}
+
+//
+// ActorSnapshotManager::getSnapshot
+//
+// Returns the snapshot for the given time, interpolating between the
+// snapshots on either side of it or extrapolating from the most recent
+// snapshot.  An invalid snapshot is returned if nothing is known about
+// the actor at that time.
+//
+ActorSnapshot ActorSnapshotManager::getSnapshot(int time) const
+{
+	if (empty() || time < 0 || time - mMostRecent >= NUM_SNAPSHOTS)
+		return ActorSnapshot();
+
+	if (mValidSnapshot(time))
+		return mSnaps[time % NUM_SNAPSHOTS];
+
+	int prevtime = mFindValidSnapshot(MIN(time, mMostRecent), time - NUM_SNAPSHOTS + 1);
+	if (prevtime == -1)
+		return ActorSnapshot();
+
+	if (time < mMostRecent)
+	{
+		int nexttime = mFindValidSnapshot(time + 1, mMostRecent);
+		if (nexttime != -1)
+			return mInterpolateSnapshots(prevtime, nexttime, time);
+	}
+
+	return mExtrapolateSnapshot(prevtime, time);
+}
+
+VERSION_CONTROL (p_snapshot_cpp, "$Id$")
@@ -263,6 +263,36 @@ private:
 };
 
 
+// ============================================================================
+//
+// ActorSnapshotManager Interface
+//
+// ============================================================================
+
+class ActorSnapshotManager
+{
+public:
+	ActorSnapshotManager();
+
+	bool empty() const;
+	void clearSnapshots();
+
+	int getMostRecentTime() const { return mMostRecent; }
+
+	void addSnapshot(const ActorSnapshot &snap);
+	ActorSnapshot getSnapshot(int time) const;
+
+private:
+	bool mValidSnapshot(int time) const;
+	int mFindValidSnapshot(int starttime, int endtime) const;
+	ActorSnapshot mInterpolateSnapshots(int from, int to, int time) const;
+	ActorSnapshot mExtrapolateSnapshot(int from, int time) const;
+
+	ActorSnapshot	mSnaps[NUM_SNAPSHOTS];
+	int				mMostRecent;
+};
+
+
 // ============================================================================
 //
 // PlayerSnapshot Interface
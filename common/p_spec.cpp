@@ -647,6 +647,38 @@ void P_InitPicAnims (void)
 }
 
 
+//
+// P_MarkAnimatedPics
+//
+// [Odamex] If any frame of an animation is marked in texturehits or
+// flathits, marks every frame of that animation so that the whole
+// animation gets precached.
+//
+void P_MarkAnimatedPics(byte* texturehits, byte* flathits)
+{
+	for (anim_t* anim = anims; anim < lastanim; anim++)
+	{
+		byte* hits = anim->istexture ? texturehits : flathits;
+		bool used = false;
+
+		for (int i = 0; i < anim->numframes && !used; i++)
+		{
+			int pic = anim->uniqueframes ? anim->framepic[i] : anim->basepic + i;
+			used = hits[pic] != 0;
+		}
+
+		if (!used)
+			continue;
+
+		for (int i = 0; i < anim->numframes; i++)
+		{
+			int pic = anim->uniqueframes ? anim->framepic[i] : anim->basepic + i;
+			hits[pic] = 1;
+		}
+	}
+}
+
+
 //
 // UTILITIES
 //
@@ -178,6 +178,9 @@ BOOL	CheckIfExitIsGood (AActor *self);
 // at game start
 void	P_InitPicAnims (void);
 
+// [Odamex] when precaching
+void	P_MarkAnimatedPics (byte* texturehits, byte* flathits);
+
 // at map load
 void	P_SpawnSpecials (void);
 
@@ -430,6 +433,8 @@ void	P_ChangeSwitchTexture (line_t *line, int useAgain);
 
 void	P_InitSwitchList ();
 
+void	P_MarkSwitchTextures (byte* texturehits);
+
 void	P_ProcessSwitchDef ();
 
 bool	P_GetButtonInfo (line_t *line, unsigned &state, unsigned &time);
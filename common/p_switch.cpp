@@ -124,6 +124,21 @@ void P_InitSwitchList(void)
 	Z_Free (alphSwitchList);
 }
 
+//
+// P_MarkSwitchTextures
+//
+// [Odamex] Marks the other texture of each switch whose on or off texture
+// is marked in texturehits, so that pressing a switch does not load it.
+//
+void P_MarkSwitchTextures(byte* texturehits)
+{
+	for (int i = 0; i < numswitches; i++)
+	{
+		if (texturehits[switchlist[i*2]] || texturehits[switchlist[i*2+1]])
+			texturehits[switchlist[i*2]] = texturehits[switchlist[i*2+1]] = 1;
+	}
+}
+
 //
 // Start a button counting down till it turns off.
 // [RH] Rewritten to remove MAXBUTTONS limit and use temporary soundorgs.
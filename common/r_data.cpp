@@ -49,6 +49,7 @@
 #include <cstddef>
 
 #include <algorithm>
+#include <vector>
 
 //
 // Graphics.
@@ -567,6 +568,11 @@ void R_InitTextures (void)
 	{
 		delete[] texturecolumnlump[i];
 		delete[] texturecolumnofs[i];
+
+		// [Odamex] composites point back into texturecomposite, so free
+		// them before it goes away
+		if (texturecomposite[i])
+			Z_Free(texturecomposite[i]);
 	}
 
 	// denis - fix memory leaks
@@ -673,7 +679,7 @@ void R_InitTextures (void)
 
 	for (i = numtextures - 1; i >= 0; i--)
 	{
-		j = 0; //W_LumpNameHash (textures[i]->name) % (unsigned) numtextures;
+		j = W_LumpKeyHash (W_LumpNameKey (textures[i]->name)) % (unsigned) numtextures;
 		textures[i]->next = textures[j]->index;
 		textures[j]->index = i;
 	}
@@ -792,6 +798,9 @@ void R_ForceDefaultColormap(const char* name)
 
 	fakecmaps[0].name = StdStringToUpper(name, 8); 	// denis - todo - string limit?
 	fakecmaps[0].blend_color = argb_t(0, 255, 255, 255);
+
+	// blended rows are cached by colormap row and are now stale
+	V_InvalidateViewBlend();
 }
 
 void R_SetDefaultColormap(const char* name)
@@ -1022,7 +1031,7 @@ int R_CheckTextureNumForName (const char *name)
 	strncpy ((char *)uname, name, 9); // denis - todo - string limit?
 	std::transform(uname, uname + sizeof(uname), uname, toupper);
 
-	i = textures[/*W_LumpNameHash (uname) % (unsigned) numtextures*/0]->index; // denis - todo - replace with map<>
+	i = textures[W_LumpKeyHash (W_LumpNameKey ((char *)uname)) % (unsigned) numtextures]->index;
 
 	while (i != -1) {
 		if (!strncmp (textures[i]->name, (char *)uname, 8))
@@ -1067,39 +1076,36 @@ int R_TextureNumForName (const char *name)
 // Preloads all relevant graphics for the level.
 //
 // [RH] Rewrote this using Lee Killough's code in BOOM as an example.
-
+//
+// [Odamex] Also loads every frame of animated flats and textures and both
+// textures of each switch, and builds the composites of multipatch textures
+// up front. Composites are PU_STATIC, so once built they stay resident
+// rather than being built the first time they are drawn.
+//
+// [Odamex] The lumps are first handed to W_PrefetchLumps so that they are
+// read from disk in the background. During demo playback the graphics are
+// not loaded up front, but they are still prefetched.
+//
 void R_PrecacheLevel (void)
 {
-	byte *hitlist;
 	int i;
 
-	if (demoplayback)
-		return;
+	byte* flathits = new byte[numflats];
+	byte* texturehits = new byte[numtextures];
+	byte* spritehits = new byte[numsprites];
 
-	{
-		int size = (numflats > numsprites) ? numflats : numsprites;
-
-		hitlist = new byte[(numtextures > size) ? numtextures : size];
-	}
-
-	// Precache flats.
-	memset (hitlist, 0, numflats);
+	memset(flathits, 0, numflats);
+	memset(texturehits, 0, numtextures);
+	memset(spritehits, 0, numsprites);
 
 	for (i = numsectors - 1; i >= 0; i--)
-		hitlist[sectors[i].floorpic] = hitlist[sectors[i].ceilingpic] = 1;
-
-	for (i = numflats - 1; i >= 0; i--)
-		if (hitlist[i])
-			W_CacheLumpNum (firstflat + i, PU_CACHE);
-
-	// Precache textures.
-	memset (hitlist, 0, numtextures);
+		flathits[sectors[i].floorpic] = flathits[sectors[i].ceilingpic] = 1;
 
 	for (i = numsides - 1; i >= 0; i--)
 	{
-		hitlist[sides[i].toptexture] =
-			hitlist[sides[i].midtexture] =
-			hitlist[sides[i].bottomtexture] = 1;
+		texturehits[sides[i].toptexture] =
+			texturehits[sides[i].midtexture] =
+			texturehits[sides[i].bottomtexture] = 1;
 	}
 
 	// Sky texture is always present.
@@ -1112,39 +1118,121 @@ void R_PrecacheLevel (void)
 	// [RH] Possibly two sky textures now.
 	// [ML] 5/11/06 - Not anymore!
 
-	hitlist[sky1texture] = 1;
-	hitlist[sky2texture] = 1;
+	texturehits[sky1texture] = 1;
+	texturehits[sky2texture] = 1;
+
+	P_MarkAnimatedPics(texturehits, flathits);
+	P_MarkSwitchTextures(texturehits);
+
+	{
+		AActor *actor;
+		TThinkerIterator<AActor> iterator;
+
+		while ( (actor = iterator.Next ()) )
+			spritehits[actor->sprite] = 1;
+	}
+
+	// Read the lumps in the background in the order they will be used.
+	std::vector<unsigned int> lumps;
+
+	for (i = numflats - 1; i >= 0; i--)
+	{
+		if (flathits[i])
+			lumps.push_back(firstflat + i);
+	}
 
 	for (i = numtextures - 1; i >= 0; i--)
 	{
-		if (hitlist[i])
+		if (texturehits[i])
 		{
-			int j;
-			texture_t *texture = textures[i];
+			for (int j = textures[i]->patchcount - 1; j >= 0; j--)
+				lumps.push_back(textures[i]->patches[j].patch);
+		}
+	}
 
-			for (j = texture->patchcount - 1; j > 0; j--)
-				W_CachePatch(texture->patches[j].patch, PU_CACHE);
+	for (i = numsprites - 1; i >= 0; i--)
+	{
+		if (!spritehits[i])
+			continue;
+
+		for (int j = 0; j < sprites[i].numframes; j++)
+		{
+			for (int r = 0; r < 8; r++)
+			{
+				if (sprites[i].spriteframes[j].lump[r] != -1)
+					lumps.push_back(sprites[i].spriteframes[j].lump[r]);
+			}
 		}
 	}
 
-	// Precache sprites.
-	memset (hitlist, 0, numsprites);
+	W_PrefetchLumps(lumps);
 
+	if (demoplayback)
 	{
-		AActor *actor;
-		TThinkerIterator<AActor> iterator;
+		delete[] flathits;
+		delete[] texturehits;
+		delete[] spritehits;
+		return;
+	}
 
-		while ( (actor = iterator.Next ()) )
-			hitlist[actor->sprite] = 1;
+	size_t flatbytes = 0, texturebytes = 0;
+	int flatcount = 0, texturecount = 0, spritecount = 0;
+
+	// Precache flats.
+	for (i = numflats - 1; i >= 0; i--)
+	{
+		if (flathits[i])
+		{
+			W_CacheLumpNum(firstflat + i, PU_CACHE);
+			flatbytes += W_LumpLength(firstflat + i);
+			flatcount++;
+		}
 	}
 
+	// Precache textures.
+	for (i = numtextures - 1; i >= 0; i--)
+	{
+		if (!texturehits[i])
+			continue;
+
+		texture_t* texture = textures[i];
+
+		if (texturecompositesize[i] > 0)
+		{
+			if (!texturecomposite[i])
+				R_GenerateComposite(i);
+
+			texturebytes += texturecompositesize[i];
+		}
+		else
+		{
+			for (int j = texture->patchcount - 1; j >= 0; j--)
+			{
+				W_CachePatch(texture->patches[j].patch, PU_CACHE);
+				texturebytes += W_LumpLength(texture->patches[j].patch);
+			}
+		}
+
+		texturecount++;
+	}
+
+	// Precache sprites.
 	for (i = numsprites - 1; i >= 0; i--)
 	{
-		if (hitlist[i])
+		if (spritehits[i])
+		{
 			R_CacheSprite (sprites + i);
+			spritecount++;
+		}
 	}
 
-	delete[] hitlist;
+	DPrintf("R_PrecacheLevel: %d flats (%u KB), %d textures (%u KB), %d sprites\n",
+			flatcount, (unsigned int)(flatbytes >> 10),
+			texturecount, (unsigned int)(texturebytes >> 10), spritecount);
+
+	delete[] flathits;
+	delete[] texturehits;
+	delete[] spritehits;
 }
 
 // Utility function,
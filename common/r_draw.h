@@ -142,6 +142,7 @@ void	R_DrawTranslucentColumnD (void);
 void	R_DrawTranslatedColumnD (void);
 
 void	R_DrawTlatedLucentColumnP (void);
+void	R_DrawTlatedLucentColumnD (void);
 #define R_DrawTlatedLucentColumn R_DrawTlatedLucentColumnP
 void	R_StretchColumnP (void);
 #define R_StretchColumn R_StretchColumnP
@@ -151,9 +152,11 @@ void	R_FillColumnP (void);
 void	R_BlankSpan (void);
 void	R_FillSpanP (void);
 void	R_FillSpanD (void);
+void	R_FillTranslucentSpanP (void);
 
 void R_DrawSpanD_c(void);
 void R_DrawSlopeSpanD_c(void);
+void R_FillTranslucentSpanD_c(void);
 
 #define SPANJUMP 16
 #define INTERPSTEP (0.0625f)
@@ -161,11 +164,24 @@ void R_DrawSlopeSpanD_c(void);
 class IWindowSurface;
 
 void r_dimpatchD_c(IWindowSurface* surface, argb_t color, int alpha, int x1, int y1, int w, int h);
+void r_blitrowPD_c(argb_t* dest, const palindex_t* source, const argb_t* palette, int count, fixed_t xstep);
+void r_blitrowDD_c(argb_t* dest, const argb_t* source, int count, fixed_t xstep);
 
 #ifdef __SSE2__
 void R_DrawSpanD_SSE2(void);
 void R_DrawSlopeSpanD_SSE2(void);
 void r_dimpatchD_SSE2(IWindowSurface*, argb_t color, int alpha, int x1, int y1, int w, int h);
+void r_blitrowPD_SSE2(argb_t* dest, const palindex_t* source, const argb_t* palette, int count, fixed_t xstep);
+void r_blitrowDD_SSE2(argb_t* dest, const argb_t* source, int count, fixed_t xstep);
+#endif
+
+#ifdef ODA_HAVE_AVX2
+void R_DrawSpanD_AVX2(void);
+void R_DrawSlopeSpanD_AVX2(void);
+void R_FillTranslucentSpanD_AVX2(void);
+void r_dimpatchD_AVX2(IWindowSurface*, argb_t color, int alpha, int x1, int y1, int w, int h);
+void r_blitrowPD_AVX2(argb_t* dest, const palindex_t* source, const argb_t* palette, int count, fixed_t xstep);
+void r_blitrowDD_AVX2(argb_t* dest, const argb_t* source, int count, fixed_t xstep);
 #endif
 
 #ifdef __MMX__
@@ -183,7 +199,96 @@ void r_dimpatchD_ALTIVEC(IWindowSurface*, argb_t color, int alpha, int x1, int y
 // Vectorizable function pointers:
 extern void (*R_DrawSpanD)(void);
 extern void (*R_DrawSlopeSpanD)(void);
+extern void (*R_FillTranslucentSpanD)(void);
 extern void (*r_dimpatchD)(IWindowSurface* surface, argb_t color, int alpha, int x1, int y1, int w, int h);
+extern void (*r_blitrowPD)(argb_t* dest, const palindex_t* source, const argb_t* palette, int count, fixed_t xstep);
+extern void (*r_blitrowDD)(argb_t* dest, const argb_t* source, int count, fixed_t xstep);
+
+// [Odamex] Versions of the drawers above that take their state as a parameter
+// instead of reading dcol or dspan, so that they can be run by the drawing
+// threads. Drawers that rely on any other global state have no such version.
+typedef void (*drawcolumnfunc_t)(const drawcolumn_t& drawcolumn);
+typedef void (*drawspanfunc_t)(const drawspan_t& drawspan);
+
+void	R_FillColumnP (const drawcolumn_t& drawcolumn);
+void	R_DrawColumnP (const drawcolumn_t& drawcolumn);
+void	R_DrawTranslucentColumnP (const drawcolumn_t& drawcolumn);
+void	R_DrawTranslatedColumnP (const drawcolumn_t& drawcolumn);
+void	R_DrawTlatedLucentColumnP (const drawcolumn_t& drawcolumn);
+void	R_FillSpanP (const drawspan_t& drawspan);
+void	R_FillTranslucentSpanP (const drawspan_t& drawspan);
+void	R_DrawSpanP (const drawspan_t& drawspan);
+
+void	R_DrawColumnD (const drawcolumn_t& drawcolumn);
+void	R_DrawTranslucentColumnD (const drawcolumn_t& drawcolumn);
+void	R_DrawTranslatedColumnD (const drawcolumn_t& drawcolumn);
+void	R_DrawTlatedLucentColumnD (const drawcolumn_t& drawcolumn);
+void	R_FillTranslucentSpanD_c (const drawspan_t& drawspan);
+void	R_DrawSpanD_c (const drawspan_t& drawspan);
+
+#ifdef __SSE2__
+void	R_DrawSpanD_SSE2 (const drawspan_t& drawspan);
+#endif
+
+#ifdef ODA_HAVE_AVX2
+void	R_FillTranslucentSpanD_AVX2 (const drawspan_t& drawspan);
+void	R_DrawSpanD_AVX2 (const drawspan_t& drawspan);
+#endif
+
+// [Odamex] Drawers for four adjacent columns at once, used when the queued
+// columns allow it. The columns must use textures with power-of-2 heights.
+typedef void (*drawcolumnquadfunc_t)(const drawcolumn_t* const* columns);
+
+drawcolumnquadfunc_t R_GetColumnQuadDrawer (drawcolumnfunc_t func);
+bool	R_DrawColumnQuadEnds (const drawcolumn_t* const* columns, drawcolumnfunc_t func, int& top, int& bottom);
+
+void	R_DrawColumnQuadP (const drawcolumn_t* const* columns);
+void	R_DrawTranslucentColumnQuadP (const drawcolumn_t* const* columns);
+void	R_DrawTranslatedColumnQuadP (const drawcolumn_t* const* columns);
+void	R_DrawTlatedLucentColumnQuadP (const drawcolumn_t* const* columns);
+void	R_DrawColumnQuadD_c (const drawcolumn_t* const* columns);
+void	R_DrawTranslucentColumnQuadD_c (const drawcolumn_t* const* columns);
+void	R_DrawTranslatedColumnQuadD (const drawcolumn_t* const* columns);
+void	R_DrawTlatedLucentColumnQuadD (const drawcolumn_t* const* columns);
+
+#ifdef __SSE2__
+void	R_DrawColumnQuadD_SSE2 (const drawcolumn_t* const* columns);
+void	R_DrawTranslucentColumnQuadD_SSE2 (const drawcolumn_t* const* columns);
+#endif
+
+extern drawcolumnquadfunc_t R_DrawColumnQuadD;
+extern drawcolumnquadfunc_t R_DrawTranslucentColumnQuadD;
+
+// [Odamex] Multithreaded drawing
+//
+// While r_drawthreads is greater than one, the columns and spans drawn by
+// R_RenderPlayerView are queued and then drawn by several threads, each
+// taking a vertical strip of the view window.
+extern bool r_deferdrawing;
+
+void R_InitDrawThreads ();
+void R_ShutdownDrawThreads ();
+void R_BeginDrawQueue ();
+void R_EndDrawQueue ();
+void R_FlushDrawQueue ();
+void R_QueueColumn (void (*drawfunc)());
+void R_QueueSpan (void (*drawfunc)());
+
+inline void R_DispatchColumn (void (*drawfunc)())
+{
+	if (r_deferdrawing)
+		R_QueueColumn(drawfunc);
+	else
+		drawfunc();
+}
+
+inline void R_DispatchSpan (void (*drawfunc)())
+{
+	if (r_deferdrawing)
+		R_QueueSpan(drawfunc);
+	else
+		drawfunc();
+}
 
 extern byte*			translationtables;
 extern argb_t           translationRGB[MAXPLAYERS+1][16];
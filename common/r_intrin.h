@@ -58,4 +58,13 @@
 	#endif
 #endif
 
+// [Odamex] AVX2 drawers are compiled for every x86 target and only used when
+// the CPU supports AVX2, so this does not depend on __AVX2__.
+#if defined(__i386__) || defined(__x86_64__) || defined(_M_IX86) || defined(_M_X64)
+	#if (defined(_MSC_VER) && _MSC_VER >= 1700) || defined(__clang__) || \
+		(defined(__GNUC__) && (__GNUC__ > 4 || (__GNUC__ == 4 && __GNUC_MINOR__ >= 9)))
+		#define ODA_HAVE_AVX2
+	#endif
+#endif
+
 #endif
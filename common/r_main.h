@@ -267,7 +267,7 @@ inline argb_t shaderef_t::tlate(const translationref_t &translation, const byte
 	unsigned int b = (trancolor.getb() * lightcolor.getb() * (NUMCOLORMAPS - m_mapnum) / 255
 					+ fadecolor.getb() * m_mapnum + NUMCOLORMAPS / 2) / NUMCOLORMAPS;
 
-	return argb_t(gammatable[r], gammatable[g], gammatable[b]);
+	return V_BlendViewColor(argb_t(gammatable[r], gammatable[g], gammatable[b]));
 }
 
 
@@ -1386,6 +1386,8 @@ static void Res_PNGCleanup(png_struct** png_ptr, png_info** info_ptr, byte** lum
 void TextureManager::cachePNGTexture(texhandle_t handle)
 {
 #ifdef CLIENT_APP
+	dtime_t starttime = I_GetTime();
+
 	png_struct* png_ptr = NULL;
 	png_info* info_ptr = NULL;
 	byte* lumpdata = NULL;
@@ -1473,6 +1475,14 @@ void TextureManager::cachePNGTexture(texhandle_t handle)
 	// read the image and store in temp_image
 	const png_size_t row_size = png_get_rowbytes(png_ptr, info_ptr);
 
+	// [Odamex] V_BestColor searches the whole palette, so remember the
+	// colors matched recently. Keys have the alpha bits set so that 0 can
+	// mark an empty slot.
+	static const unsigned int BESTCOLOR_CACHE_SIZE = 4096;
+	uint32_t bestcolorkeys[BESTCOLOR_CACHE_SIZE];
+	palindex_t bestcolorvalues[BESTCOLOR_CACHE_SIZE];
+	memset(bestcolorkeys, 0, sizeof(bestcolorkeys));
+
 	row_data = new png_byte[row_size];
 	for (unsigned int y = 0; y < height; y++)
 	{
@@ -1487,7 +1497,19 @@ void TextureManager::cachePNGTexture(texhandle_t handle)
 
 			*mask = color.geta() != 0;
 			if (*mask)
-				*dest = V_BestColor(V_GetDefaultPalette()->basecolors, color);
+			{
+				uint32_t key = 0xFF000000u | (row_data[(x << 2) + 0] << 16) |
+						(row_data[(x << 2) + 1] << 8) | row_data[(x << 2) + 2];
+				unsigned int slot = ((key * 2654435761u) >> 20) & (BESTCOLOR_CACHE_SIZE - 1);
+
+				if (bestcolorkeys[slot] != key)
+				{
+					bestcolorkeys[slot] = key;
+					bestcolorvalues[slot] = V_BestColor(V_GetDefaultPalette()->basecolors, color);
+				}
+
+				*dest = bestcolorvalues[slot];
+			}
 
 			dest += height;
 			mask += height;
@@ -1498,6 +1520,9 @@ void TextureManager::cachePNGTexture(texhandle_t handle)
 
 	Res_PNGCleanup(&png_ptr, &info_ptr, &lumpdata, &row_data, &mfp);
 
+	DPrintf("Decoded PNG %s (%ux%u) in %.2f ms\n", lumpname, (unsigned int)width,
+			(unsigned int)height, double(I_GetTime() - starttime) / 1000000.0);
+
 #endif	// CLIENT_APP
 }
 
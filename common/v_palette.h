@@ -121,6 +121,22 @@ void V_DoPaletteEffects();
 
 void V_ResetPalette();
 
+// V_BeginViewBlend()
+//
+// [Odamex] In 32bpp mode, applies the given full-screen blend to the shades
+// returned by every shaderef_t made until V_EndViewBlend() is called. This
+// lets the player's view be rendered already blended.
+void V_BeginViewBlend(const argb_t color, const int alpha);
+void V_EndViewBlend();
+
+// Applies the active view blend to a color that was not looked up from a
+// shademap.
+argb_t V_BlendViewColor(const argb_t color);
+
+// Discards the blended shademaps after the shademaps they were made from
+// have been rebuilt or freed.
+void V_InvalidateViewBlend();
+
 // Colorspace conversion RGB <-> HSV
 fahsv_t V_RGBtoHSV(const fargb_t &color);
 fargb_t V_HSVtoRGB(const fahsv_t &color);
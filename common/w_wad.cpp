@@ -26,6 +26,7 @@
 #include <ctype.h>
 #include <cstring>
 #include <unistd.h>
+#include <sys/mman.h>
 #ifndef O_BINARY
 #define O_BINARY		0
 #endif
@@ -33,6 +34,7 @@
 
 #ifdef _WIN32
 #include <io.h>
+#include "win32inc.h"
 #else
 #define strcmpi	strcasecmp
 #endif
@@ -50,6 +52,8 @@
 #include "cmdlib.h"
 #include "m_argv.h"
 #include "md5.h"
+#include "c_dispatch.h"
+#include "i_thread.h"
 
 #include "w_wad.h"
 
@@ -60,6 +64,8 @@
 #include <vector>
 #include <iostream>
 #include <iomanip>
+#include <fstream>
+#include <map>
 
 
 //
@@ -75,51 +81,351 @@ void**			lumpcache;
 static unsigned	stdisk_lumpnum;
 
 //
-// W_LumpNameHash
+// [Odamex] WAD files are memory-mapped where the platform allows it so that
+// lumps can be read without seeking, and read-only consumers can use the lump
+// data in place through W_MapLumpNum. Each lump's mapped field points into
+// the mapping of the file it came from.
 //
-// Hash function used for lump names. Must be mod'ed with table size.
-// Can be used for any 8-character names.
-// by Lee Killough
+struct wadmapping_t
+{
+	FILE*		handle;
+	byte*		base;
+	size_t		length;
+};
+
+static std::vector<wadmapping_t> wadmappings;
+
+// [Odamex] The file each open handle was opened from, for W_ReopenFiles
+struct wadhandle_t
+{
+	FILE*		handle;
+	std::string	filename;
+};
+
+static std::vector<wadhandle_t> wadhandles;
+
 //
-// [SL] taken from prboom-plus
+// W_MapFile
 //
-unsigned int W_LumpNameHash(const char *s)
+// Maps an entire file into memory. Returns NULL if the platform cannot map
+// the file or -nommap was given, in which case lumps are read with stdio.
+//
+static byte* W_MapFile(FILE* handle, size_t length)
 {
-	unsigned int hash;
+	if (length == 0 || Args.CheckParm("-nommap"))
+		return NULL;
+
+	byte* base = NULL;
+
+	#if defined(UNIX)
+	void* ptr = mmap(NULL, length, PROT_READ, MAP_PRIVATE, fileno(handle), 0);
+	if (ptr == MAP_FAILED)
+		return NULL;
+	base = (byte*)ptr;
+	#elif defined(_WIN32) && !defined(_XBOX)
+	HANDLE file = (HANDLE)_get_osfhandle(_fileno(handle));
+	HANDLE filemap = CreateFileMapping(file, NULL, PAGE_READONLY, 0, 0, NULL);
+	if (filemap == NULL)
+		return NULL;
+
+	// the view keeps the mapping object alive after its handle is closed
+	base = (byte*)MapViewOfFile(filemap, FILE_MAP_READ, 0, 0, 0);
+	CloseHandle(filemap);
+	if (base == NULL)
+		return NULL;
+	#else
+	return NULL;
+	#endif
+
+	wadmapping_t mapping;
+	mapping.handle = handle;
+	mapping.base = base;
+	mapping.length = length;
+	wadmappings.push_back(mapping);
+
+	return base;
+}
 
-	(void)((hash =         toupper(s[0]), s[1]) &&
-			(hash = hash*3+toupper(s[1]), s[2]) &&
-			(hash = hash*2+toupper(s[2]), s[3]) &&
-			(hash = hash*2+toupper(s[3]), s[4]) &&
-			(hash = hash*2+toupper(s[4]), s[5]) &&
-			(hash = hash*2+toupper(s[5]), s[6]) &&
-			(hash = hash*2+toupper(s[6]),
-			 hash = hash*2+toupper(s[7]))
-         );
-	return hash;
+//
+// Lump prefetching
+//
+// [Odamex] W_PrefetchLumps reads the pages of memory-mapped lumps on a
+// background thread, so the disk reads happen before the lumps are first
+// used rather than stalling the game when they are. Lumps from files that
+// could not be mapped are skipped, since reading them means seeking a
+// FILE handle shared with the main thread.
+//
+struct prefetchjob_t
+{
+	std::vector<const byte*>	data;
+	std::vector<size_t>			lengths;
+	mutex_t*					mutex;
+	bool						cancel;
+	size_t						bytes;
+	dtime_t						elapsed;
+};
+
+static prefetchjob_t* prefetchjob = NULL;
+static thread_t* prefetchthread = NULL;
+
+static int W_PrefetchWorker(void* data)
+{
+	prefetchjob_t* job = static_cast<prefetchjob_t*>(data);
+	dtime_t start = I_GetTime();
+	size_t bytes = 0;
+
+	// the sum keeps the reads from being optimized away
+	volatile byte sum = 0;
+
+	for (size_t i = 0; i < job->data.size(); i++)
+	{
+		{
+			OScopedLock lock(job->mutex);
+			if (job->cancel)
+				break;
+		}
+
+		const byte* lump = job->data[i];
+		size_t length = job->lengths[i];
+
+		#if defined(UNIX) && defined(MADV_WILLNEED)
+		uintptr_t page = (uintptr_t)lump & ~(uintptr_t)4095;
+		madvise((void*)page, length + ((uintptr_t)lump - page), MADV_WILLNEED);
+		#endif
+
+		byte total = 0;
+		for (size_t ofs = 0; ofs < length; ofs += 4096)
+			total += lump[ofs];
+		sum += total + lump[length - 1];
+
+		bytes += length;
+	}
+
+	OScopedLock lock(job->mutex);
+	job->bytes = bytes;
+	job->elapsed = I_GetTime() - start;
+
+	return 0;
+}
+
+//
+// W_StopPrefetch
+//
+// Cancels any prefetch that is still running and waits for it to stop.
+//
+static void W_StopPrefetch()
+{
+	if (prefetchjob == NULL)
+		return;
+
+	{
+		OScopedLock lock(prefetchjob->mutex);
+		prefetchjob->cancel = true;
+	}
+
+	I_WaitThread(prefetchthread);
+	I_DestroyMutex(prefetchjob->mutex);
+	delete prefetchjob;
+
+	prefetchjob = NULL;
+	prefetchthread = NULL;
+}
+
+//
+// W_PrefetchLumps
+//
+// Starts reading the given lumps in the background, replacing any earlier
+// prefetch. Lumps that are already cached are skipped.
+//
+void W_PrefetchLumps(const std::vector<unsigned int>& lumps)
+{
+	W_StopPrefetch();
+
+	if (!I_ThreadsAvailable())
+		return;
+
+	prefetchjob_t* job = new prefetchjob_t;
+	job->cancel = false;
+	job->bytes = 0;
+	job->elapsed = 0;
+
+	for (size_t i = 0; i < lumps.size(); i++)
+	{
+		unsigned int lump = lumps[i];
+		if (lump >= numlumps || lumpcache[lump] != NULL)
+			continue;
+
+		if (lumpinfo[lump].mapped == NULL || lumpinfo[lump].size <= 0)
+			continue;
+
+		job->data.push_back(lumpinfo[lump].mapped);
+		job->lengths.push_back(lumpinfo[lump].size);
+	}
+
+	if (job->data.empty())
+	{
+		delete job;
+		return;
+	}
+
+	job->mutex = I_CreateMutex();
+
+	thread_t* thread = I_CreateThread(W_PrefetchWorker, job);
+	if (thread == NULL)
+	{
+		I_DestroyMutex(job->mutex);
+		delete job;
+		return;
+	}
+
+	prefetchjob = job;
+	prefetchthread = thread;
+}
+
+//
+// W_UnmapFiles
+//
+static void W_UnmapFiles()
+{
+	W_StopPrefetch();
+
+	for (size_t i = 0; i < wadmappings.size(); i++)
+	{
+		#if defined(UNIX)
+		munmap(wadmappings[i].base, wadmappings[i].length);
+		#elif defined(_WIN32) && !defined(_XBOX)
+		UnmapViewOfFile(wadmappings[i].base);
+		#endif
+	}
+
+	wadmappings.clear();
+}
+
+//
+// Lump name lookup
+//
+// [Odamex] Lump names are packed into 64-bit integers holding the upper-cased
+// name, so comparing two names is a single integer compare. W_HashLumps
+// builds an open-addressed table keyed by name and namespace that holds the
+// last lump of each name, observing pwad ordering rules, so a lookup is
+// normally a single probe. The table is kept at most half full.
+//
+struct lumptableentry_t
+{
+	uint64_t	key;
+	int			namespc;
+	int			lump;		// -1 if the slot is empty
+};
+
+static std::vector<lumptableentry_t> lumptable;
+static size_t lumptablemask;
+
+// incremented every time the lump directory is rebuilt, to invalidate
+// the lump numbers remembered by LumpName
+static unsigned int lumpgeneration = 1;
+
+//
+// W_LumpNameKey
+//
+// Packs up to 8 characters of a lump name into an integer, upper-casing
+// them in the process.
+//
+uint64_t W_LumpNameKey(const char *name)
+{
+	uint64_t key = 0;
+	for (int i = 0; i < 8 && name[i]; i++)
+		key |= (uint64_t)(byte)toupper(name[i]) << (i * 8);
+	return key;
+}
+
+//
+// W_LumpKeyHash
+//
+// Hash function for packed lump names. Must be masked or mod'ed with the
+// table size.
+//
+unsigned int W_LumpKeyHash(uint64_t key)
+{
+	key ^= key >> 33;
+	key *= 0xFF51AFD7ED558CCDULL;
+	key ^= key >> 33;
+	return (unsigned int)key;
+}
+
+static inline size_t W_LumpTableSlot(uint64_t key, int namespc)
+{
+	return (W_LumpKeyHash(key) + namespc * 0x9E3779B9u) & lumptablemask;
+}
+
+static int W_LookupLump(uint64_t key, int namespc)
+{
+	if (lumptable.empty())
+		return -1;
+
+	for (size_t slot = W_LumpTableSlot(key, namespc); ; slot = (slot + 1) & lumptablemask)
+	{
+		const lumptableentry_t& entry = lumptable[slot];
+		if (entry.lump == -1)
+			return -1;
+		if (entry.key == key && entry.namespc == namespc)
+			return entry.lump;
+	}
 }
 
 //
 // W_HashLumps
 //
 // killough 1/31/98: Initialize lump hash table
-// [SL] taken from prboom-plus
 //
 void W_HashLumps(void)
 {
-	for (unsigned int i = 0; i < numlumps; i++)
-		lumpinfo[i].index = -1;			// mark slots empty
+	size_t size = 16;
+	while (size < numlumps * 2)
+		size <<= 1;
 
-	// Insert nodes to the beginning of each chain, in first-to-last
-	// lump order, so that the last lump of a given name appears first
-	// in any chain, observing pwad ordering rules. killough
+	lumptableentry_t empty;
+	empty.key = 0;
+	empty.namespc = 0;
+	empty.lump = -1;
 
+	lumptable.assign(size, empty);
+	lumptablemask = size - 1;
+
+	// Insert lumps in first-to-last order, replacing any earlier lump of the
+	// same name and namespace, so that the last one wins.
 	for (unsigned int i = 0; i < numlumps; i++)
 	{
-		unsigned int j = W_LumpNameHash(lumpinfo[i].name) % (unsigned int)numlumps;
-		lumpinfo[i].next = lumpinfo[j].index;     // Prepend to list
-		lumpinfo[j].index = i;
+		uint64_t key = W_LumpNameKey(lumpinfo[i].name);
+		int namespc = lumpinfo[i].namespc;
+
+		size_t slot = W_LumpTableSlot(key, namespc);
+		while (lumptable[slot].lump != -1 &&
+				(lumptable[slot].key != key || lumptable[slot].namespc != namespc))
+			slot = (slot + 1) & lumptablemask;
+
+		lumptable[slot].key = key;
+		lumptable[slot].namespc = namespc;
+		lumptable[slot].lump = i;
+	}
+
+	lumpgeneration++;
+}
+
+//
+// LumpName
+//
+LumpName::LumpName(const char* name, int namespc) :
+	mKey(W_LumpNameKey(name)), mNamespace(namespc), mLumpNum(-1), mGeneration(0)
+{ }
+
+int LumpName::getNum() const
+{
+	if (mGeneration != lumpgeneration)
+	{
+		mLumpNum = W_LookupLump(mKey, mNamespace);
+		mGeneration = lumpgeneration;
 	}
+	return mLumpNum;
 }
 
 
@@ -139,10 +445,154 @@ void uppercopy (char *to, const char *from)
 }
 
 
+//
+// WAD hash cache
+//
+// [Odamex] Hashing every WAD at startup gets slow with large PWADs, so MD5
+// sums are remembered in a cache file in the user's directory. An entry is
+// only trusted if the file's size, modification time and inode still match.
+// Hashes that are missing from the cache are computed in parallel by
+// W_HashFiles.
+//
+struct wadhashentry_t
+{
+	unsigned long long	size;
+	long long			mtime;
+	unsigned long long	inode;
+	std::string			md5;
+};
+
+typedef std::map<std::string, wadhashentry_t> wadhashcache_t;
+static wadhashcache_t wadhashcache;
+static bool wadhashcache_loaded = false;
+
+static std::string W_HashCacheFileName()
+{
+	return I_GetUserFileName("wadhashes.cache");
+}
+
+static void W_ReadHashCache(wadhashcache_t& cache)
+{
+	std::ifstream cachefile(W_HashCacheFileName().c_str());
+	std::string line;
+	while (std::getline(cachefile, line))
+	{
+		std::istringstream linestream(line);
+		wadhashentry_t entry;
+		std::string path;
+
+		if (!(linestream >> entry.md5 >> entry.size >> entry.mtime >> entry.inode))
+			continue;
+
+		std::getline(linestream, path);
+		if (path.length() < 2 || entry.md5.length() != 32)
+			continue;
+
+		cache[path.substr(1)] = entry;
+	}
+}
+
+static void W_LoadHashCache()
+{
+	if (wadhashcache_loaded)
+		return;
+	wadhashcache_loaded = true;
+
+	W_ReadHashCache(wadhashcache);
+}
+
+//
+// W_SaveHashCache
+//
+// Called after entries have been added to the cache. Several server
+// instances can share the cache file, so entries saved by the others since
+// it was loaded are merged in, and the file is replaced by renaming a
+// finished temporary file over it so that it is never seen half-written.
+//
+static void W_SaveHashCache()
+{
+	wadhashcache_t saved;
+	W_ReadHashCache(saved);
+
+	for (wadhashcache_t::const_iterator it = saved.begin(); it != saved.end(); ++it)
+		wadhashcache.insert(*it);
+
+	std::string filename = W_HashCacheFileName();
+	std::ostringstream tempname;
+	tempname << filename << ".tmp";
+	#ifdef UNIX
+	tempname << "." << getpid();
+	#endif
+
+	{
+		std::ofstream cachefile(tempname.str().c_str(), std::ios::out | std::ios::trunc);
+		if (!cachefile)
+			return;
+
+		for (wadhashcache_t::const_iterator it = wadhashcache.begin(); it != wadhashcache.end(); ++it)
+		{
+			cachefile << it->second.md5 << " " << it->second.size << " " << it->second.mtime
+			          << " " << it->second.inode << " " << it->first << "\n";
+		}
+
+		if (!cachefile.flush())
+		{
+			cachefile.close();
+			remove(tempname.str().c_str());
+			return;
+		}
+	}
+
+	#ifdef _WIN32
+	// rename doesn't replace an existing file on Windows
+	remove(filename.c_str());
+	#endif
+
+	if (rename(tempname.str().c_str(), filename.c_str()) != 0)
+		remove(tempname.str().c_str());
+}
+
+//
+// W_StatHashEntry
+//
+// Fills in the size, modification time and inode of a file.
+// Returns false if the file doesn't exist.
+//
+static bool W_StatHashEntry(const std::string& filename, wadhashentry_t& entry)
+{
+	struct stat info;
+	if (stat(filename.c_str(), &info) != 0)
+		return false;
+
+	entry.size = info.st_size;
+	entry.mtime = info.st_mtime;
+	entry.inode = info.st_ino;
+	return true;
+}
+
+static const wadhashentry_t* W_LookupHashCache(const std::string& filename, const wadhashentry_t& current)
+{
+	wadhashcache_t::const_iterator it = wadhashcache.find(filename);
+	if (it == wadhashcache.end())
+		return NULL;
+
+	const wadhashentry_t& entry = it->second;
+	if (entry.size != current.size || entry.mtime != current.mtime || entry.inode != current.inode)
+		return NULL;
+
+	return &entry;
+}
+
+//
+// W_ComputeMD5
+//
 // denis - Standard MD5SUM
-std::string W_MD5(std::string filename)
+//
+// Hashes the file from a memory mapping where possible, otherwise with large
+// buffered reads. Safe to call from worker threads.
+//
+static std::string W_ComputeMD5(const std::string& filename)
 {
-	const int file_chunk_size = 8192;
 	FILE *fp = fopen(filename.c_str(), "rb");
 
 	if(!fp)
@@ -151,11 +601,42 @@ std::string W_MD5(std::string filename)
 	md5_state_t state;
 	md5_init(&state);
 
-	unsigned n = 0;
-	unsigned char buf[file_chunk_size];
+	bool hashed = false;
+
+	#ifdef UNIX
+	struct stat info;
+	if (fstat(fileno(fp), &info) == 0 && info.st_size > 0)
+	{
+		size_t length = info.st_size;
+		void* data = mmap(NULL, length, PROT_READ, MAP_PRIVATE, fileno(fp), 0);
+		if (data != MAP_FAILED)
+		{
+			#ifdef MADV_SEQUENTIAL
+			madvise(data, length, MADV_SEQUENTIAL);
+			#endif
+
+			// md5_append takes an int length, so feed it in large chunks
+			const size_t chunk_size = 1 << 24;
+			for (size_t pos = 0; pos < length; pos += chunk_size)
+				md5_append(&state, (unsigned char *)data + pos, MIN(chunk_size, length - pos));
 
-	while((n = fread(buf, 1, sizeof(buf), fp)))
-		md5_append(&state, (unsigned char *)buf, n);
+			munmap(data, length);
+			hashed = true;
+		}
+	}
+	#endif
+
+	if (!hashed)
+	{
+		const size_t file_chunk_size = 1 << 20;
+		unsigned char* buf = new unsigned char[file_chunk_size];
+
+		size_t n = 0;
+		while((n = fread(buf, 1, file_chunk_size, fp)))
+			md5_append(&state, buf, n);
+
+		delete [] buf;
+	}
 
 	md5_byte_t digest[16];
 	md5_finish(&state, digest);
@@ -170,6 +651,143 @@ std::string W_MD5(std::string filename)
 	return hash.str();
 }
 
+//
+// W_MD5
+//
+// Returns the MD5 sum of a file, using the hash cache if the file hasn't
+// changed since it was last hashed.
+//
+std::string W_MD5(std::string filename)
+{
+	W_LoadHashCache();
+
+	// cache entries are keyed by the same path W_HashFiles uses
+	FixPathSeparator(filename);
+
+	wadhashentry_t entry;
+	if (!W_StatHashEntry(filename, entry))
+		return "";
+
+	const wadhashentry_t* cached = W_LookupHashCache(filename, entry);
+	if (cached)
+		return cached->md5;
+
+	entry.md5 = W_ComputeMD5(filename);
+	if (!entry.md5.empty())
+	{
+		wadhashcache[filename] = entry;
+		W_SaveHashCache();
+	}
+
+	return entry.md5;
+}
+
+//
+// W_HashFiles
+//
+// Makes sure the hashes of the given files are in the hash cache, hashing
+// any that are missing on worker threads, one per CPU.
+//
+struct hashjobs_t
+{
+	std::vector<std::string>	filenames;
+	std::vector<std::string>	hashes;
+	size_t						next;
+	mutex_t*					mutex;
+};
+
+static int W_HashWorker(void* data)
+{
+	hashjobs_t* jobs = static_cast<hashjobs_t*>(data);
+
+	while (true)
+	{
+		size_t job;
+		{
+			OScopedLock lock(jobs->mutex);
+			if (jobs->next >= jobs->filenames.size())
+				break;
+			job = jobs->next++;
+		}
+
+		jobs->hashes[job] = W_ComputeMD5(jobs->filenames[job]);
+	}
+
+	return 0;
+}
+
+void W_HashFiles(const std::vector<std::string>& filenames)
+{
+	W_LoadHashCache();
+
+	dtime_t start = I_GetTime();
+
+	hashjobs_t jobs;
+	std::vector<wadhashentry_t> entries;
+	unsigned long long bytes = 0;
+
+	for (size_t i = 0; i < filenames.size(); i++)
+	{
+		std::string filename(filenames[i]);
+		FixPathSeparator(filename);
+
+		wadhashentry_t entry;
+		if (!W_StatHashEntry(filename, entry) || W_LookupHashCache(filename, entry))
+			continue;
+
+		if (std::find(jobs.filenames.begin(), jobs.filenames.end(), filename) != jobs.filenames.end())
+			continue;
+
+		jobs.filenames.push_back(filename);
+		entries.push_back(entry);
+		bytes += entry.size;
+	}
+
+	if (jobs.filenames.empty())
+		return;
+
+	jobs.hashes.resize(jobs.filenames.size());
+	jobs.next = 0;
+	jobs.mutex = I_CreateMutex();
+
+	std::vector<thread_t*> threads;
+	size_t numthreads = MIN((size_t)I_GetNumCPUs(), jobs.filenames.size());
+	for (size_t i = 1; i < numthreads; i++)
+	{
+		thread_t* thread = I_CreateThread(W_HashWorker, &jobs);
+		if (thread)
+			threads.push_back(thread);
+	}
+
+	// the main thread works through the queue too, and finishes it alone
+	// if no threads could be started
+	W_HashWorker(&jobs);
+
+	for (size_t i = 0; i < threads.size(); i++)
+		I_WaitThread(threads[i]);
+
+	I_DestroyMutex(jobs.mutex);
+
+	bool added = false;
+	for (size_t i = 0; i < jobs.filenames.size(); i++)
+	{
+		if (jobs.hashes[i].empty())
+			continue;
+
+		entries[i].md5 = jobs.hashes[i];
+		wadhashcache[jobs.filenames[i]] = entries[i];
+		added = true;
+	}
+
+	if (added)
+		W_SaveHashCache();
+
+	dtime_t elapsed = I_GetTime() - start;
+	Printf(PRINT_HIGH, "W_HashFiles: hashed %u files (%.1f MB) in %u ms using %u threads\n",
+			(unsigned)jobs.filenames.size(), double(bytes) / (1024.0 * 1024.0),
+			(unsigned)I_ConvertTimeToMs(elapsed), (unsigned)threads.size() + 1);
+}
+
 
 //
 // LUMP BASED ROUTINES.
@@ -179,9 +797,11 @@ std::string W_MD5(std::string filename)
 // W_AddLumps
 //
 // Adds lumps from the array of filelump_t. If clientonly is true,
-// only certain lumps will be added.
+// only certain lumps will be added. If the file was memory-mapped, mapbase
+// points to the start of the mapping.
 //
-void W_AddLumps(FILE* handle, filelump_t* fileinfo, size_t newlumps, bool clientonly)
+void W_AddLumps(FILE* handle, const byte* mapbase, size_t maplength,
+				filelump_t* fileinfo, size_t newlumps, bool clientonly)
 {
 	lumpinfo = (lumpinfo_t*)Realloc(lumpinfo, (numlumps + newlumps) * sizeof(lumpinfo_t));
 	if (!lumpinfo)
@@ -197,6 +817,12 @@ void W_AddLumps(FILE* handle, filelump_t* fileinfo, size_t newlumps, bool client
 		lump->size = info->size;
 		strncpy(lump->name, info->name, 8);
 
+		if (mapbase && info->filepos >= 0 && info->size >= 0 &&
+			(size_t)info->filepos + (size_t)info->size <= maplength)
+			lump->mapped = mapbase + info->filepos;
+		else
+			lump->mapped = NULL;
+
 		lump++;
 		numlumps++;
 	}
@@ -279,7 +905,15 @@ std::string W_AddFile(std::string filename)
 		Printf(PRINT_HIGH, " (%d lumps)\n", header.numlumps);
 	}
 
-	W_AddLumps(handle, fileinfo, newlumps, false);
+	size_t length = M_FileLength(handle);
+	byte* mapbase = W_MapFile(handle, length);
+
+	W_AddLumps(handle, mapbase, length, fileinfo, newlumps, false);
+
+	wadhandle_t wadhandle;
+	wadhandle.handle = handle;
+	wadhandle.filename = filename;
+	wadhandles.push_back(wadhandle);
 
 	delete [] fileinfo;
 
@@ -363,6 +997,7 @@ void W_MergeLumps (const char *start, const char *end, int space)
 					newlumps++;
 					strncpy (newlumpinfos[0].name, ustart, 8);
 					newlumpinfos[0].handle = NULL;
+					newlumpinfos[0].mapped = NULL;
 					newlumpinfos[0].position =
 						newlumpinfos[0].size = 0;
 					newlumpinfos[0].namespc = ns_global;
@@ -431,6 +1066,7 @@ void W_MergeLumps (const char *start, const char *end, int space)
 
 		strncpy (lumpinfo[numlumps].name, uend, 8);
 		lumpinfo[numlumps].handle = NULL;
+		lumpinfo[numlumps].mapped = NULL;
 		lumpinfo[numlumps].position =
 			lumpinfo[numlumps].size = 0;
 		lumpinfo[numlumps].namespc = ns_global;
@@ -465,6 +1101,10 @@ std::vector<std::string> W_InitMultipleFiles (std::vector<std::string> &filename
 
 	std::vector<std::string> hashes(filenames);
 
+	// hash any files that aren't in the hash cache up front, in parallel,
+	// so that W_AddFile doesn't have to hash them one at a time
+	W_HashFiles(filenames);
+
 	// open each file once, load headers, and count lumps
 	int j = 0;
 	std::vector<std::string> loaded;
@@ -516,39 +1156,9 @@ std::vector<std::string> W_InitMultipleFiles (std::vector<std::string> &filename
 // W_CheckNumForName
 // Returns -1 if name not found.
 //
-// Rewritten by Lee Killough to use hash table for performance. Significantly
-// cuts down on time -- increases Doom performance over 300%. This is the
-// single most important optimization of the original Doom sources, because
-// lump name lookup is used so often, and the original Doom used a sequential
-// search. For large wads with > 1000 lumps this meant an average of over
-// 500 were probed during every search. Now the average is under 2 probes per
-// search. There is no significant benefit to packing the names into longwords
-// with this new hashing algorithm, because the work to do the packing is
-// just as much work as simply doing the string comparisons with the new
-// algorithm, which minimizes the expected number of comparisons to under 2.
-//
-// [SL] taken from prboom-plus
-//
 int W_CheckNumForName(const char *name, int namespc)
 {
-	// Hash function maps the name to one of possibly numlump chains.
-	// It has been tuned so that the average chain length never exceeds 2.
-
-	// proff 2001/09/07 - check numlumps==0, this happens when called before WAD loaded
-	register int i = (numlumps==0)?(-1):(lumpinfo[W_LumpNameHash(name) % numlumps].index);
-
-	// We search along the chain until end, looking for case-insensitive
-	// matches which also match a namespace tag. Separate hash tables are
-	// not used for each namespace, because the performance benefit is not
-	// worth the overhead, considering namespace collisions are rare in
-	// Doom wads.
-
-	while (i >= 0 && (strnicmp(lumpinfo[i].name, name, 8) ||
-				lumpinfo[i].namespc != namespc))
-		i = lumpinfo[i].next;
-
-	// Return the matching lump, or -1 if none found.
-	return i;
+	return W_LookupLump(W_LumpNameKey(name), namespc);
 }
 
 //
@@ -582,6 +1192,22 @@ unsigned W_LumpLength (unsigned lump)
 
 
 
+//
+// W_ReadLumpFromFile
+//
+// Reads a lump with stdio, for files that could not be mapped.
+//
+static void W_ReadLumpFromFile(unsigned int lump, void* dest)
+{
+	lumpinfo_t* l = lumpinfo + lump;
+
+	fseek (l->handle, l->position, SEEK_SET);
+	int c = fread (dest, l->size, 1, l->handle);
+
+	if (feof(l->handle))
+		I_Error ("W_ReadLump: only read %i of %i on lump %i", c, l->size, lump);
+}
+
 //
 // W_ReadLump
 // Loads the lump into the given buffer,
@@ -589,7 +1215,6 @@ unsigned W_LumpLength (unsigned lump)
 //
 void W_ReadLump(unsigned int lump, void* dest)
 {
-	int		c;
 	lumpinfo_t*	l;
 
 	if (lump >= numlumps)
@@ -600,11 +1225,10 @@ void W_ReadLump(unsigned int lump, void* dest)
 	if (lump != stdisk_lumpnum)
     	I_BeginRead();
 
-	fseek (l->handle, l->position, SEEK_SET);
-	c = fread (dest, l->size, 1, l->handle);
-
-	if (feof(l->handle))
-		I_Error ("W_ReadLump: only read %i of %i on lump %i", c, l->size, lump);
+	if (l->mapped)
+		memcpy(dest, l->mapped, l->size);
+	else
+		W_ReadLumpFromFile(lump, dest);
 
 	if (lump != stdisk_lumpnum)
     	I_EndRead();
@@ -642,7 +1266,7 @@ bool W_CheckLumpName (unsigned lump, const char *name)
 	if (lump >= numlumps)
 		return false;
 
-	return !strnicmp (lumpinfo[lump].name, name, 8);
+	return W_LumpNameKey(lumpinfo[lump].name) == W_LumpNameKey(name);
 }
 
 //
@@ -691,6 +1315,51 @@ void* W_CacheLumpNum(unsigned int lump, int tag)
 	return lumpcache[lump];
 }
 
+//
+// W_MapLumpNum
+//
+// [Odamex] Returns the lump's data for read-only use. If the lump's WAD is
+// memory-mapped and the lump is suitably aligned, this points directly into
+// the mapping and nothing is copied. Otherwise the lump is cached as with
+// W_CacheLumpNum and locked until W_UnmapLumpNum is called.
+//
+// The data is not guaranteed to be zero-terminated, so text parsers should
+// keep using W_CacheLumpNum.
+//
+static const byte* W_GetMappedLump(unsigned int lump)
+{
+	const byte* data = lumpinfo[lump].mapped;
+	if (data && ((size_t)data & 3) == 0)
+		return data;
+	return NULL;
+}
+
+const void* W_MapLumpNum(unsigned int lump)
+{
+	if (lump >= numlumps)
+		I_Error ("W_MapLumpNum: %u >= numlumps", lump);
+
+	const byte* data = W_GetMappedLump(lump);
+	if (data)
+		return data;
+
+	return W_CacheLumpNum(lump, PU_STATIC);
+}
+
+//
+// W_UnmapLumpNum
+//
+// Releases a lump obtained from W_MapLumpNum.
+//
+void W_UnmapLumpNum(unsigned int lump)
+{
+	if (lump >= numlumps)
+		I_Error ("W_UnmapLumpNum: %u >= numlumps", lump);
+
+	if (!W_GetMappedLump(lump) && lumpcache[lump])
+		Z_ChangeTag(lumpcache[lump], PU_CACHE);
+}
+
 //
 // W_CacheLumpName
 //
@@ -716,11 +1385,17 @@ patch_t* W_CachePatch(unsigned lumpnum, int tag)
 
 	if (!lumpcache[lumpnum])
 	{
-		// temporary storage of the raw patch in the old format
-		byte *rawlumpdata = new byte[W_LumpLength(lumpnum)];
+		// the raw patch in the old format, read in place from the mapped
+		// WAD if possible, otherwise into temporary storage
+		byte *rawlumpdata = NULL;
+		patch_t *rawpatch = (patch_t*)W_GetMappedLump(lumpnum);
 
-		W_ReadLump(lumpnum, rawlumpdata);
-		patch_t *rawpatch = (patch_t*)(rawlumpdata);
+		if (!rawpatch)
+		{
+			rawlumpdata = new byte[W_LumpLength(lumpnum)];
+			W_ReadLump(lumpnum, rawlumpdata);
+			rawpatch = (patch_t*)(rawlumpdata);
+		}
 
 		size_t newlumplen = R_CalculateNewPatchSize(rawpatch, W_LumpLength(lumpnum));
 
@@ -774,9 +1449,11 @@ int W_FindLump (const char *name, int lastlump)
 	if (lastlump < -1)
 		lastlump = -1;
 
+	uint64_t key = W_LumpNameKey(name);
+
 	for (int i = lastlump + 1; i < (int)numlumps; i++)
 	{
-		if (strnicmp(lumpinfo[i].name, name, 8) == 0)
+		if (W_LumpNameKey(lumpinfo[i].name) == key)
 			return i;
 	}
 
@@ -805,9 +1482,189 @@ void W_Close ()
 			fclose(lump_p->handle);
 			handles.push_back(lump_p->handle);
 		}
+		lump_p->mapped = NULL;
 		lump_p++;
 	}
+
+	wadhandles.clear();
+	W_UnmapFiles();
+}
+
+//
+// W_ReopenFiles
+//
+// [Odamex] Gives a forked process its own file handles. A forked process
+// shares the file offsets of its parent's open files, so lumps read with
+// stdio would seek each other's handles. The FILE pointers stay the same,
+// and mappings outlive the descriptors they were made from.
+//
+void W_ReopenFiles()
+{
+	for (size_t i = 0; i < wadhandles.size(); i++)
+	{
+		if (freopen(wadhandles[i].filename.c_str(), "rb", wadhandles[i].handle) == NULL)
+			I_Error("W_ReopenFiles: couldn't reopen %s", wadhandles[i].filename.c_str());
+	}
+}
+
+//
+// prefetchstats
+//
+// Reports how much the last call to W_PrefetchLumps has read so far.
+//
+BEGIN_COMMAND (prefetchstats)
+{
+	if (prefetchjob == NULL)
+	{
+		Printf(PRINT_HIGH, "No lumps have been prefetched.\n");
+		return;
+	}
+
+	size_t bytes;
+	dtime_t elapsed;
+	{
+		OScopedLock lock(prefetchjob->mutex);
+		bytes = prefetchjob->bytes;
+		elapsed = prefetchjob->elapsed;
+	}
+
+	if (elapsed == 0)
+	{
+		Printf(PRINT_HIGH, "Prefetching %u lumps...\n", (unsigned)prefetchjob->data.size());
+		return;
+	}
+
+	Printf(PRINT_HIGH, "Prefetched %u lumps (%.1f MB) in %u ms\n",
+			(unsigned)prefetchjob->data.size(), double(bytes) / (1024.0 * 1024.0),
+			(unsigned)I_ConvertTimeToMs(elapsed));
+}
+END_COMMAND (prefetchstats)
+
+//
+// benchlumps
+//
+// Times lump name lookups against the loaded directory, and against a
+// synthetic directory of the given size (65536 lumps by default).
+//
+static dtime_t W_TimeLookups(const std::vector<std::string>& names, size_t passes, size_t& found)
+{
+	dtime_t start = I_GetTime();
+	for (size_t pass = 0; pass < passes; pass++)
+	{
+		for (size_t i = 0; i < names.size(); i++)
+		{
+			if (W_CheckNumForName(names[i].c_str()) != -1)
+				found++;
+		}
+	}
+	return I_GetTime() - start;
+}
+
+BEGIN_COMMAND (benchlumps)
+{
+	size_t synthetic = 65536;
+	if (argc >= 2)
+		synthetic = MAX(atoi(argv[1]), 1);
+
+	const size_t lookups = 1000000;
+
+	// look up every lump in the real directory, plus as many misses
+	std::vector<std::string> names;
+	for (size_t i = 0; i < numlumps; i++)
+	{
+		char name[9];
+		W_GetLumpName(name, i);
+		names.push_back(name);
+
+		char miss[9];
+		sprintf(miss, "~%07X", (unsigned)i);
+		names.push_back(miss);
+	}
+
+	size_t found = 0;
+	size_t passes = MAX(lookups / MAX(names.size(), (size_t)1), (size_t)1);
+	dtime_t elapsed = W_TimeLookups(names, passes, found);
+	Printf(PRINT_HIGH, "%u lumps: %.1f ns per lookup\n", (unsigned)numlumps,
+			double(elapsed) / double(passes * names.size()));
+
+	// swap in a synthetic directory
+	lumpinfo_t* oldlumpinfo = lumpinfo;
+	size_t oldnumlumps = numlumps;
+
+	lumpinfo = new lumpinfo_t[synthetic];
+	numlumps = synthetic;
+	names.clear();
+	for (size_t i = 0; i < synthetic; i++)
+	{
+		char name[9];
+		sprintf(name, "L%07X", (unsigned)i);
+		memcpy(lumpinfo[i].name, name, 8);
+		lumpinfo[i].handle = NULL;
+		lumpinfo[i].mapped = NULL;
+		lumpinfo[i].position = lumpinfo[i].size = 0;
+		lumpinfo[i].namespc = ns_global;
+		names.push_back(name);
+	}
+
+	dtime_t start = I_GetTime();
+	W_HashLumps();
+	dtime_t build = I_GetTime() - start;
+
+	passes = MAX(lookups / synthetic, (size_t)1);
+	elapsed = W_TimeLookups(names, passes, found);
+	Printf(PRINT_HIGH, "%u lumps: built in %.3fms, %.1f ns per lookup\n", (unsigned)synthetic,
+			double(build) / 1e6, double(elapsed) / double(passes * synthetic));
+
+	delete [] lumpinfo;
+	lumpinfo = oldlumpinfo;
+	numlumps = oldnumlumps;
+	W_HashLumps();
+}
+END_COMMAND (benchlumps)
+
+//
+// benchwad
+//
+// Reads every lump of the loaded WADs with stdio and then from the mapped
+// files, to compare the cost of a level load or precache with each backend.
+//
+BEGIN_COMMAND (benchwad)
+{
+	size_t maxsize = 0, total = 0, nummapped = 0;
+	for (size_t i = 0; i < numlumps; i++)
+	{
+		maxsize = MAX(maxsize, (size_t)lumpinfo[i].size);
+		if (lumpinfo[i].handle)
+			total += lumpinfo[i].size;
+		if (lumpinfo[i].mapped)
+			nummapped++;
+	}
+
+	byte* buf = new byte[maxsize + 1];
+
+	dtime_t start = I_GetTime();
+	for (size_t i = 0; i < numlumps; i++)
+	{
+		if (lumpinfo[i].handle)
+			W_ReadLumpFromFile(i, buf);
+	}
+	dtime_t stdio_time = I_GetTime() - start;
+
+	start = I_GetTime();
+	for (size_t i = 0; i < numlumps; i++)
+	{
+		if (lumpinfo[i].mapped)
+			memcpy(buf, lumpinfo[i].mapped, lumpinfo[i].size);
+	}
+	dtime_t mapped_time = I_GetTime() - start;
+
+	delete [] buf;
+
+	Printf(PRINT_HIGH, "%u lumps (%u mapped), %u bytes: stdio %.3fms, mapped %.3fms\n",
+			(unsigned)numlumps, (unsigned)nummapped, (unsigned)total,
+			double(stdio_time) / 1e6, double(mapped_time) / 1e6);
 }
+END_COMMAND (benchwad)
 
 VERSION_CONTROL (w_wad_cpp, "$Id$")
 
@@ -70,9 +70,8 @@ typedef struct lumpinfo_s
 	int			position;
 	int			size;
 
-	// [RH] Hashing stuff
-	int			next;
-	int			index;
+	// [Odamex] lump data inside the memory-mapped WAD, or NULL
+	const byte	*mapped;
 
 	int			namespc;
 } lumpinfo_t;
@@ -85,11 +84,32 @@ typedef enum {
 	ns_colormaps,
 } namespace_t;
 
+//
+// LumpName
+//
+// [Odamex] A lump name for callers that look the same lump up repeatedly,
+// such as every frame. The lump number is remembered until the lump
+// directory is rebuilt. getNum returns -1 if there is no such lump.
+//
+class LumpName
+{
+public:
+	LumpName(const char* name, int namespc = ns_global);
+	int getNum() const;
+
+private:
+	uint64_t			mKey;
+	int					mNamespace;
+	mutable int			mLumpNum;
+	mutable unsigned	mGeneration;
+};
+
 extern	void**		lumpcache;
 extern	lumpinfo_t*	lumpinfo;
 extern	size_t	numlumps;
 
 std::string W_MD5(std::string filename);
+void W_HashFiles(const std::vector<std::string>& filenames);
 std::vector<std::string> W_InitMultipleFiles (std::vector<std::string> &filenames);
 
 int		W_CheckNumForName (const char *name, int ns = ns_global);
@@ -100,6 +120,9 @@ void		W_ReadLump (unsigned lump, void *dest);
 unsigned	W_ReadChunk (const char *file, unsigned offs, unsigned len, void *dest, unsigned &filelen);
 
 void *W_CacheLumpNum (unsigned lump, int tag);
+const void *W_MapLumpNum (unsigned lump);
+void	W_UnmapLumpNum (unsigned lump);
+void	W_PrefetchLumps (const std::vector<unsigned int>& lumps);	// [Odamex] Read lumps in the background
 void *W_CacheLumpName (const char *name, int tag);
 patch_t* W_CachePatch (unsigned lump, int tag = PU_CACHE);
 patch_t* W_CachePatch (const char *name, int tag = PU_CACHE);
@@ -107,11 +130,13 @@ patch_t* W_CachePatch (const char *name, int tag = PU_CACHE);
 void	W_Profile (const char *fname);
 
 void	W_Close ();
+void	W_ReopenFiles ();	// [Odamex] Reopen WAD files after a fork
 
 int		W_FindLump (const char *name, int lastlump);	// [RH]	Find lumps with duplication
 bool	W_CheckLumpName (unsigned lump, const char *name);	// [RH] True if lump's name == name // denis - todo - replace with map<>
 
-//unsigned W_LumpNameHash (const char *name);				// [RH] Create hash key from an 8-char name
+uint64_t	W_LumpNameKey (const char *name);		// [Odamex] Pack an 8-char name into an integer
+unsigned	W_LumpKeyHash (uint64_t key);			// Hash a packed name
 
 // [RH] Combine multiple marked ranges of lumps into one.
 void	W_MergeLumps (const char *start, const char *end, int);
@@ -32,6 +32,8 @@
 
 static bool use_zone = true;
 
+static void (*purge_callback)() = NULL;
+
 //
 // FauxZone
 //
@@ -180,6 +182,15 @@ void Z_Init(bool _use_zone)
 }
 
 
+//
+// Z_SetPurgeCallback
+//
+void Z_SetPurgeCallback(void (*callback)())
+{
+	purge_callback = callback;
+}
+
+
 //
 // Z_Free2
 //
@@ -301,6 +312,9 @@ void* Z_Malloc2(size_t size, int tag, void* user, const char* file, int line)
 			}
 			else
 			{
+				if (purge_callback)
+					purge_callback();
+
 				// free the rover block (adding the size to base)
 				
 				// the rover can be the base block
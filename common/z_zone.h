@@ -52,6 +52,11 @@ void	Z_DumpHeap (int lowtag, int hightag);
 void	Z_CheckHeap (void);
 size_t 	Z_FreeMemory (void);
 
+// [Odamex] Called before any purgable block is thrown out to make room for
+// a new allocation. Lets code that holds on to purgable memory beyond the
+// call that cached it (such as deferred drawing) finish using it first.
+void	Z_SetPurgeCallback (void (*callback)());
+
 // Don't use these, use the macros instead!
 void*   Z_Malloc2 (size_t size, int tag, void *user, const char *file, int line);
 void    Z_Free2 (void *ptr, const char *file, int line);
@@ -38,6 +38,7 @@
 #include <string.h>
 
 #include <stdint.h>
+#include <time.h>
 
 #ifdef UNIX
 #include <netinet/in.h>
@@ -52,13 +53,27 @@
 #endif
 
 #include "i_net.h"
+// hashtable.h derives its iterators from std::iterator, which is
+// deprecated in C++17
+#if defined(__GNUC__)
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wdeprecated-declarations"
+#endif
+#include "hashtable.h"
+#if defined(__GNUC__)
+#pragma GCC diagnostic pop
+#endif
 
 using namespace std;
 
 #define MAX_SERVERS					1024
 #define MAX_SERVERS_PER_IP			64
+
+// server_index can't grow past 65536 buckets and is kept under 75% full
+#define MAX_BENCH_SERVERS			49152
 #define MAX_SERVER_AGE				5000
 #define MAX_UNVERIFIED_SERVER_AGE	1000
+#define PING_BATCH_SIZE				16
 
 #define LOGFILE "master_log.txt"
 
@@ -90,38 +105,92 @@ typedef struct server
 list<SServer> servers;
 list<SServer>::iterator ping_itr = servers.begin(); // this iterator must be updated when servers is changed
 
-bool ipReachedLimit(netadr_t addr)
+int maxservers = MAX_SERVERS;
+bool quiet = false;
+
+// servers indexed by address and the number of verified servers at each IP,
+// so that a packet doesn't require a search of every server
+OHashTable<uint64_t, list<SServer>::iterator> server_index;
+OHashTable<uint32_t, int> verified_per_ip;
+
+// the reply to clients requesting the server list is only rebuilt when the
+// verified servers change, and the server list file is only rewritten when
+// any server's info changes. It is limited to the master's own
+// MAX_UDP_PACKET from master/i_net.h, not the game's larger one.
+buf_t serverlist_message(MAX_UDP_PACKET);
+bool serverlist_changed = true;
+bool serverinfo_changed = true;
+
+uint32_t ipKey(const netadr_t &addr)
 {
-	list<SServer>::iterator itr;
-	int verifiedservers = 0;
+	return ((uint32_t)addr.ip[0] << 24) | (addr.ip[1] << 16) | (addr.ip[2] << 8) | addr.ip[3];
+}
 
-	// count verified servers
-	for (itr = servers.begin(); itr != servers.end(); ++itr)
-		if ((*itr).verified && memcmp(&(*itr).addr.ip, &addr.ip, 4) == 0)
-			verifiedservers++;
+uint64_t addrKey(const netadr_t &addr)
+{
+	return ((uint64_t)ipKey(addr) << 16) | addr.port;
+}
+
+list<SServer>::iterator findServer(const netadr_t &addr)
+{
+	OHashTable<uint64_t, list<SServer>::iterator>::iterator itr = server_index.find(addrKey(addr));
+
+	if (itr == server_index.end())
+		return servers.end();
+
+	return itr->second;
+}
+
+void setVerified(SServer &s)
+{
+	if (s.verified)
+		return;
+
+	s.verified = true;
+	verified_per_ip[ipKey(s.addr)]++;
+	serverlist_changed = true;
+}
+
+list<SServer>::iterator removeServer(list<SServer>::iterator itr)
+{
+	if ((*itr).verified)
+	{
+		uint32_t ip = ipKey((*itr).addr);
+		if (--verified_per_ip[ip] <= 0)
+			verified_per_ip.erase(ip);
+
+		serverlist_changed = true;
+	}
+
+	serverinfo_changed = true;
+
+	if (ping_itr == itr)
+		++ping_itr;
+
+	server_index.erase(addrKey((*itr).addr));
+	return servers.erase(itr);
+}
 
-	return verifiedservers >= MAX_SERVERS_PER_IP;
+bool ipReachedLimit(netadr_t addr)
+{
+	OHashTable<uint32_t, int>::iterator itr = verified_per_ip.find(ipKey(addr));
+
+	return itr != verified_per_ip.end() && itr->second >= MAX_SERVERS_PER_IP;
 }
 
 void addServer(netadr_t addr)
 {
-	list<SServer>::iterator itr;
+	list<SServer>::iterator itr = findServer(addr);
 	SServer temp;
 
-	for (itr = servers.begin(); itr != servers.end(); ++itr)
+	if (itr != servers.end())
 	{
-		if (memcmp(&(*itr).addr.ip, &addr.ip, 4) == 0)
-		{
-			if ((*itr).addr.port == addr.port)
-			{
-				(*itr).age = 0;
-				(*itr).pinged = false;
-				return;
-			}
-		}
+		(*itr).age = 0;
+		(*itr).pinged = false;
+		return;
 	}
 
-	if (servers.size() < MAX_SERVERS)
+	if ((int)servers.size() < maxservers)
 	{
 		if(ipReachedLimit(addr))
 			return;
@@ -129,6 +198,10 @@ void addServer(netadr_t addr)
 		memcpy(&temp.addr, &addr, sizeof(addr));
 		temp.age = 0;
 		servers.push_back(temp);
+		server_index[addrKey(addr)] = --servers.end();
+
+		if (quiet)
+			return;
 
 		printf("Added new server: %s, %d total\n", NET_AdrToString(temp.addr), (int)servers.size());
 		FILE *fp = fopen(LOGFILE, "a");
@@ -143,41 +216,38 @@ void addServer(netadr_t addr)
 		return;
 	}
 
-	printf("Failed to add server: %s, no slots left\n", NET_AdrToString(addr));
+	if (!quiet)
+		printf("Failed to add server: %s, no slots left\n", NET_AdrToString(addr));
 }
 
 void addServerInfo(netadr_t addr)
 {
-	list<SServer>::iterator itr;
+	list<SServer>::iterator itr = findServer(addr);
 	size_t i;
 
-	for (itr = servers.begin(); itr != servers.end(); ++itr)
+	if (itr != servers.end())
 	{
-		if (memcmp(&(*itr).addr.ip, &addr.ip, 4) != 0)
-			continue;
-
-		if ((*itr).addr.port != addr.port)
-			continue;
-
 		SServer &s = *itr;
 
 		if(!s.key_sent)
-			continue;
+			return;
 
 		net_message.ReadLong();
 
 		// check key against one we issued
 		if((unsigned)net_message.ReadLong() != s.key_sent)
-			continue;
+			return;
 
 		// do not allow too many servers
 		if(ipReachedLimit((*itr).addr))
-			continue;
+			return;
 
-		printf("Server info, IP = %s\n", NET_AdrToString(addr));
+		if (!quiet)
+			printf("Server info, IP = %s\n", NET_AdrToString(addr));
 
-		s.verified = true;
+		setVerified(s);
 		s.age = 0;
+		serverinfo_changed = true;
 
 		s.hostname = net_message.ReadString();
 		s.players = net_message.ReadByte();
@@ -198,25 +268,23 @@ void addServerInfo(netadr_t addr)
 		s.teamplay = net_message.ReadByte();
 		s.ctfmode = net_message.ReadByte();
 
-		byte playercount = net_message.ReadByte();
+		int playercount = net_message.ReadByte();
+		if(playercount < 0)
+			playercount = 0;
 
 		s.playernames.resize(playercount);
 		s.playerfrags.resize(playercount);
 		s.playerpings.resize(playercount);
 		s.playerteams.resize(playercount);
 
-		for(i = 0; i < playercount; i++)
+		for(i = 0; i < s.playernames.size(); i++)
 		{
 			s.playernames[i] = net_message.ReadString();
 			s.playerfrags[i] = net_message.ReadShort();
 			s.playerpings[i] = net_message.ReadLong();
 			s.playerteams[i] = net_message.ReadByte();
 		}
-
-		break;
 	}
-
-	return;
 }
 
 void ageServers(void)
@@ -233,11 +301,11 @@ void ageServers(void)
 		{
 			if ((*itr).age > MAX_SERVER_AGE)
 			{
-				printf("Remote server timed out: %s, ", NET_AdrToString((*itr).addr));
-				if(ping_itr == itr)
-					++ping_itr;
-				itr = servers.erase(itr);
-				printf("%d total\n", (int)servers.size());
+				if (!quiet)
+					printf("Remote server timed out: %s, ", NET_AdrToString((*itr).addr));
+				itr = removeServer(itr);
+				if (!quiet)
+					printf("%d total\n", (int)servers.size());
 			}
 			else
 				++itr;
@@ -246,11 +314,11 @@ void ageServers(void)
 		{
 			if ((*itr).age > MAX_UNVERIFIED_SERVER_AGE)
 			{
-				printf("Remote server timed out: %s, ", NET_AdrToString((*itr).addr));
-				if(ping_itr == itr)
-					++ping_itr;
-				itr = servers.erase(itr);
-				printf("%d total\n", (int)servers.size());
+				if (!quiet)
+					printf("Remote server timed out: %s, ", NET_AdrToString((*itr).addr));
+				itr = removeServer(itr);
+				if (!quiet)
+					printf("%d total\n", (int)servers.size());
 			}
 			else
 				++itr;
@@ -261,6 +329,10 @@ void ageServers(void)
 void dumpServersToFile(const char *file = "./latest")
 {
 	static bool file_error = false;
+
+	if (!serverinfo_changed)
+		return;
+
 	FILE *fp = fopen(file, "w");
 
 	if(!fp)
@@ -315,9 +387,11 @@ void dumpServersToFile(const char *file = "./latest")
 	}
 
     fclose(fp);
+
+	serverinfo_changed = false;
 }
 
-void writeServerData(void)
+void writeServerData(buf_t &buf)
 {
 	list<SServer>::iterator itr;
 	size_t num_verified = 0;
@@ -327,7 +401,7 @@ void writeServerData(void)
 		if((*itr).verified)
 			num_verified++;
 
-	message.WriteShort(num_verified);
+	buf.WriteShort(num_verified);
 
 	for (itr = servers.begin(); itr != servers.end(); ++itr)
 	{
@@ -335,11 +409,25 @@ void writeServerData(void)
 			continue;
 
 		for (int i = 0; i < 4; ++i)
-			message.WriteByte((*itr).addr.ip[i]);
-		message.WriteShort(htons((*itr).addr.port));
+			buf.WriteByte((*itr).addr.ip[i]);
+		buf.WriteShort(htons((*itr).addr.port));
 	}
 }
 
+buf_t &getServerList(void)
+{
+	if (serverlist_changed)
+	{
+		serverlist_message.clear();
+		serverlist_message.WriteLong(LAUNCHER_CHALLENGE);
+		writeServerData(serverlist_message);
+
+		serverlist_changed = false;
+	}
+
+	return serverlist_message;
+}
+
 void daemon_init(void)
 {
 #ifdef UNIX
@@ -381,9 +469,177 @@ void pingServer(SServer &s)
 	s.pinged = true;
 }
 
-int main()
+void pingServers(void)
+{
+	size_t count = servers.size() < PING_BATCH_SIZE ? servers.size() : PING_BATCH_SIZE;
+
+	for (size_t i = 0; i < count; i++)
+	{
+		if (ping_itr == servers.end())
+			ping_itr = servers.begin();
+
+		pingServer(*(ping_itr++));
+	}
+}
+
+//
+// Load generator
+//
+// Registers, verifies and updates thousands of simulated servers, answers
+// requests from simulated clients and then times out every server, without
+// using the network.
+//
+
+double benchTime(void)
+{
+	return 1000.0 * clock() / CLOCKS_PER_SEC;
+}
+
+void benchReport(const char *phase, int ops, double start)
+{
+	double ms = benchTime() - start;
+	printf("%-12s %8d ops %10.2f ms %12.0f ops/s\n", phase, ops, ms, ms > 0.0 ? ops * 1000.0 / ms : 0.0);
+}
+
+netadr_t benchAddress(int num)
+{
+	netadr_t addr;
+	memset(&addr, 0, sizeof(addr));
+
+	// 16 servers per IP to stay below MAX_SERVERS_PER_IP
+	int ip = num / 16;
+	addr.ip[0] = 10;
+	addr.ip[1] = (ip >> 16) & 0xFF;
+	addr.ip[2] = (ip >> 8) & 0xFF;
+	addr.ip[3] = ip & 0xFF;
+	addr.port = htons(10666 + num % 16);
+
+	return addr;
+}
+
+void benchServerInfo(unsigned int key, int num)
+{
+	char name[32];
+	sprintf(name, "Benchmark Server %d", num);
+
+	net_message.clear();
+	net_message.WriteLong(0);
+	net_message.WriteLong(key);
+	net_message.WriteString(name);
+	net_message.WriteByte(4);
+	net_message.WriteByte(16);
+	net_message.WriteString("MAP01");
+	net_message.WriteByte(1);
+	net_message.WriteString("bench.wad");
+	net_message.WriteByte(1);
+	net_message.WriteByte(3);
+	net_message.WriteByte(0);
+	net_message.WriteByte(0);
+	net_message.WriteByte(4);
+
+	for (int i = 0; i < 4; i++)
+	{
+		net_message.WriteString("Player");
+		net_message.WriteShort(i);
+		net_message.WriteLong(50 + i);
+		net_message.WriteByte(0);
+	}
+}
+
+void runBenchmark(int numservers, int numclients)
+{
+	if (numservers > MAX_BENCH_SERVERS)
+	{
+		printf("Limiting the benchmark to %d servers\n", MAX_BENCH_SERVERS);
+		numservers = MAX_BENCH_SERVERS;
+	}
+
+	quiet = true;
+	maxservers = numservers;
+
+	printf("Odamex Master benchmark: %d servers, %d clients\n", numservers, numclients);
+
+	double start = benchTime();
+	for (int i = 0; i < numservers; i++)
+		addServer(benchAddress(i));
+	benchReport("register", numservers, start);
+
+	start = benchTime();
+	for (int i = 0; i < numservers; i++)
+	{
+		netadr_t addr = benchAddress(i);
+		list<SServer>::iterator itr = findServer(addr);
+		if (itr == servers.end())
+			continue;
+
+		(*itr).key_sent = i + 1;
+		(*itr).pinged = true;
+
+		benchServerInfo(i + 1, i);
+		addServerInfo(addr);
+	}
+	benchReport("verify", numservers, start);
+
+	start = benchTime();
+	for (int i = 0; i < numservers; i++)
+		addServer(benchAddress(i));
+	benchReport("heartbeat", numservers, start);
+
+	start = benchTime();
+	for (int i = 0; i < numservers; i++)
+	{
+		benchServerInfo(i + 1, i);
+		addServerInfo(benchAddress(i));
+	}
+	benchReport("update", numservers, start);
+
+	size_t replybytes = 0;
+	int overflowed = 0;
+	start = benchTime();
+	for (int i = 0; i < numclients; i++)
+	{
+		// a server changes its info every 100 client requests
+		if (i % 100 == 0)
+			serverlist_changed = true;
+
+		buf_t &reply = getServerList();
+		replybytes += reply.cursize;
+		if (reply.overflowed)
+			overflowed++;
+	}
+	benchReport("clients", numclients, start);
+
+	if (overflowed)
+		printf("%d server lists were too large for one %d byte packet and were truncated\n",
+			overflowed, MAX_UDP_PACKET);
+
+	int verified = 0;
+	for (list<SServer>::iterator itr = servers.begin(); itr != servers.end(); ++itr)
+		if ((*itr).verified)
+			verified++;
+
+	start = benchTime();
+	for (int i = 0; i <= MAX_SERVER_AGE; i++)
+		ageServers();
+	benchReport("age", (MAX_SERVER_AGE + 1) * numservers, start);
+
+	printf("%d servers verified, %d bytes sent to clients, %d servers left\n",
+		verified, (int)replybytes, (int)servers.size());
+}
+
+int main(int argc, char **argv)
 {
 	int challenge;
+
+	if (argc > 1 && strcmp(argv[1], "-bench") == 0)
+	{
+		int numservers = argc > 2 ? atoi(argv[2]) : 4096;
+		int numclients = argc > 3 ? atoi(argv[3]) : 100000;
+
+		runBenchmark(numservers, numclients);
+		return 0;
+	}
+
 	localport = MASTERPORT;
 	InitNetCommon();
 
@@ -426,10 +682,8 @@ int main()
 				else
 				{
 					printf("Client request IP = %s\n", NET_AdrToString(net_from));
-					message.clear();
-					message.WriteLong(LAUNCHER_CHALLENGE);
-					writeServerData();
-					NET_SendPacket(message.cursize, message.data, net_from);
+					buf_t &reply = getServerList();
+					NET_SendPacket(reply.cursize, reply.data, net_from);
 				}
 			    break;
 			default:
@@ -446,12 +700,7 @@ int main()
 		if(!(counter%100))
 		{
 			dumpServersToFile();
-
-			if (ping_itr == servers.end())
-				ping_itr = servers.begin();
-
-			if(ping_itr != servers.end())
-				pingServer(*(ping_itr++));
+			pingServers();
 		}
 
 		counter++;
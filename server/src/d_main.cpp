@@ -120,7 +120,7 @@ void D_DoomLoop (void)
 	{
 		try
 		{
-			D_RunTics(SV_RunTics, SV_DisplayTics);
+			D_RunTics(SV_RunTics, SV_DisplayTics, SV_WaitForTics);
 		}
 		catch (CRecoverableError &error)
 		{
@@ -294,6 +294,10 @@ void D_DoomMain()
 	D_Init();
 	atterm(D_Shutdown);
 
+	// [Odamex] Split into multiple game instances now that the WADs and
+	// tables they share have been loaded.
+	SV_ForkInstances();
+
 	Printf(PRINT_HIGH, "SV_InitNetwork: Checking network game status.\n");
 	SV_InitNetwork();
 
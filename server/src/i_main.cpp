@@ -221,8 +221,18 @@ void daemon_init(void)
 	if (forkargs)
 		pidfile = string(forkargs);
 
-    if(!pidfile.size() || pidfile[0] == '-')
-    	pidfile = "doomsv.pid";
+	if (!pidfile.size() || pidfile[0] == '-')
+	{
+		pidfile = "doomsv.pid";
+	}
+
+	// [Odamex] each -instances game instance writes its own pidfile
+	if (SV_GetInstanceNumber() > 0)
+	{
+		char suffix[16];
+		sprintf(suffix, ".%d", SV_GetInstanceNumber());
+		pidfile += suffix;
+	}
 
     pid = getpid();
     fpid = fopen(pidfile.c_str(), "w");
@@ -0,0 +1,384 @@
+// Emacs style mode select   -*- C++ -*-
+//-----------------------------------------------------------------------------
+//
+// $Id$
+//
+// Copyright (C) 2006-2015 by The Odamex Team.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// DESCRIPTION:
+//  Serverside netdemo recording.  The server records the messages it
+//  sends to a spectator slot that is never connected to the network.
+//
+//  The recorder is a spectator that is aware of every actor, is sent the
+//  position of every player each tic and the status bar state of every
+//  player, so the demo can be watched from any player's point of view by
+//  cycling through players with spynext/spyprev during playback.  The
+//  demos use the client's netdemo format and are played back with netplay.
+//
+//-----------------------------------------------------------------------------
+
+#include <time.h>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "doomtype.h"
+#include "doomstat.h"
+#include "d_player.h"
+#include "d_main.h"
+#include "d_netdemo.h"
+#include "g_game.h"
+#include "g_level.h"
+#include "i_net.h"
+#include "i_system.h"
+#include "c_console.h"
+#include "c_dispatch.h"
+#include "m_fileio.h"
+#include "m_swap.h"
+#include "md5.h"
+#include "p_unlag.h"
+#include "version.h"
+#include "sv_main.h"
+#include "sv_sqpold.h"
+#include "sv_demo.h"
+
+Players::iterator SV_GetFreeClient(void);
+
+static FILE*			demofp = NULL;
+static std::string		demofilename;
+static byte				recorder_id = 0;
+static uint32_t			starting_gametic;
+
+// messages sent to the recorder during the current tic
+static std::vector<byte> ticbuf;
+
+// uncompressed contents of the block being written
+static std::vector<byte> blockbuf;
+static uint32_t			blocktic;
+static std::vector<netdemo_index_entry_t> block_index;
+
+//
+// SV_WriteNetDemoHeader
+//
+// Writes the netdemo header to the start of the file.  There are no
+// snapshots or map index entries in serverside netdemos since they are
+// made from the client's copy of the world, so those indices are empty
+// and start where the block index does.
+//
+static bool SV_WriteNetDemoHeader(uint32_t ending_gametic, uint32_t index_offset)
+{
+	netdemo_header_t header;
+	memset(&header, 0, sizeof(header));
+
+	memcpy(header.identifier, "ODAD", 4);
+	header.version = NETDEMOVER;
+	header.compression = NETDEMO_COMP_LZO_BLOCKS;
+	header.snapshot_index_offset = index_offset;
+	header.map_index_offset = index_offset;
+	header.starting_gametic = starting_gametic;
+	header.ending_gametic = ending_gametic;
+	header.block_index_size = block_index.size();
+	header.block_index_offset = index_offset;
+
+	return D_WriteNetDemoHeader(demofp, header);
+}
+
+//
+// SV_WriteNetDemoChunk
+//
+// Adds a message to the current block.  The client reads one message for
+// each tic during playback, so everything sent to the recorder during a
+// tic is written as a single message.
+//
+static bool SV_WriteNetDemoChunk(const byte *data, size_t size)
+{
+	byte msgheader[NETDEMO_MESSAGE_HEADER_SIZE];
+	D_WriteNetDemoMessageHeader(msgheader, NETDEMO_MSG_PACKET, size, gametic);
+
+	if (blockbuf.empty())
+		blocktic = gametic;
+
+	blockbuf.insert(blockbuf.end(), msgheader, msgheader + sizeof(msgheader));
+	blockbuf.insert(blockbuf.end(), data, data + size);
+
+	if (blockbuf.size() >= NETDEMO_BLOCK_SIZE)
+		return D_WriteNetDemoBlock(demofp, blockbuf, blocktic, block_index);
+
+	return true;
+}
+
+//
+// SV_IsRecordingNetDemo
+//
+bool SV_IsRecordingNetDemo()
+{
+	return demofp != NULL;
+}
+
+//
+// SV_IsNetDemoRecorder
+//
+// Returns true if player is the spectator slot a netdemo is recorded from.
+//
+bool SV_IsNetDemoRecorder(const player_t &player)
+{
+	return recorder_id != 0 && player.id == recorder_id;
+}
+
+//
+// SV_WriteNetDemoPacket
+//
+// Takes the place of sending a packet to the recorder.  The reliable and
+// unreliable messages are added to the messages for this tic.  Packets are
+// captured by the client after their header has been read, so only the
+// first packet of the connection sequence has its sequence number written.
+//
+bool SV_WriteNetDemoPacket(player_t &player)
+{
+	client_t *cl = &player.client;
+
+	if (cl->sequence++ == 0)
+	{
+		byte sequence[4] = { 0, 0, 0, 0 };
+		ticbuf.insert(ticbuf.end(), sequence, sequence + sizeof(sequence));
+	}
+
+	ticbuf.insert(ticbuf.end(), cl->reliablebuf.data, cl->reliablebuf.data + cl->reliablebuf.cursize);
+	ticbuf.insert(ticbuf.end(), cl->netbuf.data, cl->netbuf.data + cl->netbuf.cursize);
+
+	SZ_Clear(&cl->netbuf);
+	SZ_Clear(&cl->reliablebuf);
+
+	return true;
+}
+
+//
+// SV_NetDemoTicker
+//
+// Writes the messages sent to the recorder this tic.  Called once per tic
+// after the packets for the tic have been sent.
+//
+void SV_NetDemoTicker()
+{
+	if (!SV_IsRecordingNetDemo())
+		return;
+
+	player_t &recorder = idplayer(recorder_id);
+	if (validplayer(recorder))
+		recorder.client.last_received = gametic;	// never time out
+
+	if (!SV_WriteNetDemoChunk(ticbuf.empty() ? NULL : &ticbuf[0], ticbuf.size()))
+	{
+		Printf(PRINT_HIGH, "Unable to write netdemo %s.\n", demofilename.c_str());
+		SV_StopNetDemo();
+		return;
+	}
+
+	ticbuf.clear();
+}
+
+//
+// SV_StartNetDemo
+//
+// Creates the netdemo file and connects the recorder to the game as a
+// spectator, going through the same sequence a connecting client would so
+// that the demo starts with the launcher reply and connection sequence.
+//
+bool SV_StartNetDemo(const std::string &filename)
+{
+	if (SV_IsRecordingNetDemo())
+	{
+		Printf(PRINT_HIGH, "Already recording netdemo %s.\n", demofilename.c_str());
+		return false;
+	}
+
+	if (gamestate != GS_LEVEL && gamestate != GS_INTERMISSION)
+	{
+		Printf(PRINT_HIGH, "Cannot record a netdemo until a map has been loaded.\n");
+		return false;
+	}
+
+	demofp = fopen(filename.c_str(), "wb");
+	if (!demofp)
+	{
+		Printf(PRINT_HIGH, "Unable to create netdemo file %s.\n", filename.c_str());
+		return false;
+	}
+
+	demofilename = filename;
+	starting_gametic = gametic;
+	ticbuf.clear();
+	blockbuf.clear();
+	block_index.clear();
+
+	// Note: The header is not finalized at this point.  Write it anyway to
+	// reserve space in the output file for it and overwrite it later.
+	Players::iterator it = players.end();
+	if (SV_WriteNetDemoHeader(gametic, NETDEMO_HEADER_SIZE))
+		it = SV_GetFreeClient();
+
+	if (it == players.end())
+	{
+		Printf(PRINT_HIGH, "Unable to record netdemo %s (server full).\n", filename.c_str());
+		fclose(demofp);
+		demofp = NULL;
+		remove(filename.c_str());
+		return false;
+	}
+
+	// The launcher's query reply is the first message of every netdemo
+	static buf_t tempbuf(MAX_UDP_PACKET);
+	SZ_Clear(&tempbuf);
+	MSG_WriteLong(&tempbuf, CHALLENGE);
+	MSG_WriteLong(&tempbuf, 0);		// token
+	SV_WriteServerInfo(&tempbuf);
+	SV_WriteNetDemoChunk(tempbuf.data, tempbuf.cursize);
+
+	player_t* player = &(*it);
+	client_t* cl = &(player->client);
+
+	recorder_id = player->id;
+
+	memset(&cl->address, 0, sizeof(cl->address));
+	cl->last_received = gametic;
+	cl->reliable_bps = 0;
+	cl->unreliable_bps = 0;
+	cl->lastcmdtic = 0;
+	cl->lastclientcmdtic = 0;
+	cl->allow_rcon = false;
+	cl->displaydisconnect = false;
+	cl->version = VERSION;
+	cl->majorversion = GAMEVER / 256;
+	cl->minorversion = GAMEVER % 256;
+
+	std::stringstream ss;
+	ss << time(NULL) << level.time << VERSION << filename;
+	cl->digest = MD5SUM(ss.str());
+
+	SZ_Clear(&cl->netbuf);
+	SZ_Clear(&cl->reliablebuf);
+	SZ_Clear(&cl->relpackets);
+	cl->sequence = 0;
+	cl->last_sequence = -1;
+	cl->packetnum = 0;
+
+	player->JoinTime = time(NULL);
+	player->userinfo.netname = "NETDEMO";
+	player->userinfo.update_rate = 1;		// every player's position each tic
+
+	Unlag::getInstance().registerPlayer(player->id);
+
+	SV_SendConsolePlayer(*player);
+	SV_JoinClient(*player, true);
+
+	SV_BroadcastPrintf(PRINT_HIGH, "The server is recording a netdemo.\n");
+	Printf(PRINT_HIGH, "Recording netdemo %s.\n", filename.c_str());
+
+	return true;
+}
+
+//
+// SV_FinishNetDemo
+//
+// Writes the remaining messages, the end-of-demo marker, the block index
+// and the final header and closes the file.  Called when the recorder is
+// disconnected, however that happens.
+//
+void SV_FinishNetDemo()
+{
+	if (!SV_IsRecordingNetDemo())
+		return;
+
+	recorder_id = 0;
+
+	if (!ticbuf.empty())
+		SV_WriteNetDemoChunk(&ticbuf[0], ticbuf.size());
+	ticbuf.clear();
+
+	byte marker = svc_netdemostop;
+	SV_WriteNetDemoChunk(&marker, sizeof(marker));
+
+	bool ok = D_WriteNetDemoBlock(demofp, blockbuf, blocktic, block_index);
+
+	fflush(demofp);
+	uint32_t index_offset = ftell(demofp);
+
+	ok = ok && D_WriteNetDemoIndex(demofp, block_index, index_offset);
+	ok = ok && SV_WriteNetDemoHeader(gametic, index_offset);
+
+	fclose(demofp);
+	demofp = NULL;
+
+	if (ok)
+		Printf(PRINT_HIGH, "Netdemo %s recorded (%u blocks, %u KB).\n", demofilename.c_str(),
+				(unsigned)block_index.size(), index_offset / 1024);
+	else
+		Printf(PRINT_HIGH, "Unable to write netdemo %s.\n", demofilename.c_str());
+
+	block_index.clear();
+}
+
+//
+// SV_StopNetDemo
+//
+// Disconnects the recorder, which finishes the netdemo.
+//
+void SV_StopNetDemo()
+{
+	if (!SV_IsRecordingNetDemo())
+		return;
+
+	player_t &recorder = idplayer(recorder_id);
+	if (validplayer(recorder))
+		SV_DropClient(recorder);
+	else
+		SV_FinishNetDemo();
+
+	SV_BroadcastPrintf(PRINT_HIGH, "The server has stopped recording a netdemo.\n");
+}
+
+BEGIN_COMMAND (netrecord)
+{
+	std::string filename;
+
+	if (argc > 1)
+	{
+		filename = argv[1];
+	}
+	else
+	{
+		char timestr[32];
+		time_t now = time(NULL);
+		strftime(timestr, sizeof(timestr), "%Y%m%d_%H%M%S", localtime(&now));
+
+		filename = std::string("odasrv_") + timestr + "_" + level.mapname;
+	}
+
+	M_AppendExtension(filename, ".odd");
+	SV_StartNetDemo(filename);
+}
+END_COMMAND (netrecord)
+
+BEGIN_COMMAND (stopnetdemo)
+{
+	if (!SV_IsRecordingNetDemo())
+	{
+		Printf(PRINT_HIGH, "Not recording a netdemo.\n");
+		return;
+	}
+
+	SV_StopNetDemo();
+}
+END_COMMAND (stopnetdemo)
+
+VERSION_CONTROL (sv_demo_cpp, "$Id$")
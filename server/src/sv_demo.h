@@ -0,0 +1,40 @@
+// Emacs style mode select   -*- C++ -*-
+//-----------------------------------------------------------------------------
+//
+// $Id$
+//
+// Copyright (C) 2006-2015 by The Odamex Team.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// DESCRIPTION:
+//  Serverside netdemo recording.  The server records the messages it
+//  sends to a spectator slot that is never connected to the network.
+//
+//-----------------------------------------------------------------------------
+
+#ifndef __SV_DEMO_H__
+#define __SV_DEMO_H__
+
+#include <string>
+
+#include "d_player.h"
+
+bool SV_StartNetDemo(const std::string &filename);
+void SV_StopNetDemo();
+void SV_FinishNetDemo();
+void SV_NetDemoTicker();
+
+bool SV_IsRecordingNetDemo();
+bool SV_IsNetDemoRecorder(const player_t &player);
+bool SV_WriteNetDemoPacket(player_t &player);
+
+#endif
@@ -30,6 +30,11 @@
 #ifdef UNIX
 #include <unistd.h>
 #include <sys/time.h>
+#include <sys/types.h>
+#include <signal.h>
+#endif
+#ifdef __linux__
+#include <sys/prctl.h>
 #endif
 
 #include "doomtype.h"
@@ -64,6 +69,7 @@
 #include "sv_maplist.h"
 #include "g_warmup.h"
 #include "sv_banlist.h"
+#include "sv_demo.h"
 #include "d_main.h"
 
 #include <algorithm>
@@ -442,6 +448,92 @@ BEGIN_COMMAND (exit)
 END_COMMAND (exit)
 
 
+// [Odamex] Offset added to the port for instances started by -instances.
+static int instance_number = 0;
+
+//
+// SV_GetInstanceNumber
+//
+// Returns which of the -instances game instances this process is.
+//
+int SV_GetInstanceNumber()
+{
+	return instance_number;
+}
+
+//
+// SV_ForkInstances
+//
+// [Odamex] With -instances N, the server forks into N independent game
+// instances once the WADs have been loaded and the game tables built. Each
+// instance listens on its own port (the base port plus its instance number)
+// and has its own players, level and thinkers, while the WAD directory,
+// mapped lumps, texture definitions and state/mobjinfo tables are shared
+// copy-on-write with the other instances instead of being loaded by each.
+//
+void SV_ForkInstances()
+{
+	const char* v = Args.CheckValue("-instances");
+	if (!v)
+		return;
+
+	int count = atoi(v);
+	if (count <= 1)
+		return;
+
+#ifdef UNIX
+	// flush so the children don't repeat buffered output
+	fflush(stdout);
+	if (LOG.is_open())
+		LOG.flush();
+
+	for (int i = 1; i < count; i++)
+	{
+		pid_t pid = fork();
+		if (pid == -1)
+		{
+			Printf(PRINT_HIGH, "SV_ForkInstances: unable to start instance %d: %s\n", i, strerror(errno));
+			break;
+		}
+
+		if (pid == 0)
+		{
+			#ifdef __linux__
+			// stop with the first instance unless it is about to daemonize
+			if (!Args.CheckParm("-fork"))
+				prctl(PR_SET_PDEATHSIG, SIGTERM);
+			#endif
+
+			instance_number = i;
+
+			// WADs that could not be mapped are read through FILE handles
+			// whose file offsets are shared with the other instances
+			W_ReopenFiles();
+
+			// give each instance its own log
+			if (LOG.is_open())
+			{
+				static std::string logfile;
+				std::ostringstream name;
+				name << "odasrv-" << i << ".log";
+				logfile = name.str();
+
+				LOG.close();
+				LOG_FILE = logfile.c_str();
+				LOG.open(LOG_FILE, std::ios::app);
+			}
+
+			Printf(PRINT_HIGH, "SV_ForkInstances: running as instance %d of %d\n", i, count);
+			return;
+		}
+	}
+
+	Printf(PRINT_HIGH, "SV_ForkInstances: running as instance 0 of %d\n", count);
+#else
+	Printf(PRINT_HIGH, "SV_ForkInstances: -instances is only supported on Unix\n");
+#endif
+}
+
 //
 // SV_InitNetwork
 //
@@ -458,6 +550,8 @@ void SV_InitNetwork (void)
 	else
 	   localport = SERVERPORT;
 
+	localport += instance_number;
+
 	// set up a socket and net_message buffer
 	InitNetCommon();
 
@@ -1852,13 +1946,80 @@ bool SV_CheckClientVersion(client_t *cl, Players::iterator it)
 
 
 
+void G_DoReborn (player_t &playernum);
+
+//
+// SV_SendConsolePlayer
+//
+// Tells a connecting client which player it is and sends it the server's
+// settings.
+//
+void SV_SendConsolePlayer(player_t &player)
+{
+	client_t *cl = &player.client;
+
+	// send consoleplayer number
+	MSG_WriteMarker(&cl->reliablebuf, svc_consoleplayer);
+	MSG_WriteByte(&cl->reliablebuf, player.id);
+	MSG_WriteString(&cl->reliablebuf, cl->digest.c_str());
+	SV_SendPacket(player);
+
+	// [Toke] send server settings
+	SV_SendServerSettings(player);
+}
+
+//
+// SV_JoinClient
+//
+// Brings a client that has been sent its console player into the game.
+// The other clients are told about it, and it is sent the map and a full
+// update and spawned, as a spectator if spectator is true.
+//
+void SV_JoinClient(player_t &player, bool spectator)
+{
+	client_t *cl = &player.client;
+
+	SV_BroadcastUserInfo(player);
+	player.playerstate = PST_REBORN;
+
+	player.fragcount = 0;
+	player.killcount = 0;
+	player.points = 0;
+
+	if (spectator)
+	{
+		player.spectator = true;
+		for (Players::iterator pit = players.begin(); pit != players.end(); ++pit)
+		{
+			MSG_WriteMarker(&pit->client.reliablebuf, svc_spectate);
+			MSG_WriteByte(&pit->client.reliablebuf, player.id);
+			MSG_WriteByte(&pit->client.reliablebuf, true);
+		}
+	}
+
+	// send a map name
+	SV_SendLoadMap(wadfiles, patchfiles, level.mapname, &player);
+
+	// [SL] 2011-12-07 - Force the player to jump to intermission if not in a level
+	if (gamestate == GS_INTERMISSION)
+		MSG_WriteMarker(&cl->reliablebuf, svc_exitlevel);
+
+	G_DoReborn(player);
+	SV_ClientFullUpdate(player);
+
+	// tell others clients about it
+	for (Players::iterator pit = players.begin(); pit != players.end(); ++pit)
+	{
+		MSG_WriteMarker(&pit->client.reliablebuf, svc_connectclient);
+		MSG_WriteByte(&pit->client.reliablebuf, player.id);
+	}
+}
+
 //
 //	SV_ConnectClient
 //
 //	Called when a client connects
 //
-void G_DoReborn (player_t &playernum);
-
 void SV_ConnectClient()
 {
 	int challenge = MSG_ReadLong();
@@ -1977,14 +2138,7 @@ void SV_ConnectClient()
 		return;
 	}
 
-	// send consoleplayer number
-	MSG_WriteMarker(&cl->reliablebuf, svc_consoleplayer);
-	MSG_WriteByte(&cl->reliablebuf, player->id);
-	MSG_WriteString(&cl->reliablebuf, cl->digest.c_str());
-	SV_SendPacket(*player);
-
-	// [Toke] send server settings
-	SV_SendServerSettings(*player);
+	SV_SendConsolePlayer(*player);
 
 	cl->displaydisconnect = true;
 
@@ -2028,43 +2182,10 @@ void SV_ConnectClient()
 		return;
 	}
 
-	SV_BroadcastUserInfo(*player);
-	player->playerstate = PST_REBORN;
-
-	player->fragcount = 0;
-	player->killcount = 0;
-	player->points = 0;
-
-	if (!step_mode)
-	{
-		player->spectator = true;
-		for (Players::iterator pit = players.begin(); pit != players.end(); ++pit)
-		{
-			MSG_WriteMarker(&pit->client.reliablebuf, svc_spectate);
-			MSG_WriteByte(&pit->client.reliablebuf, player->id);
-			MSG_WriteByte(&pit->client.reliablebuf, true);
-		}
-	}
-
-	// send a map name
-	SV_SendLoadMap(wadfiles, patchfiles, level.mapname, player);
-
-	// [SL] 2011-12-07 - Force the player to jump to intermission if not in a level
-	if (gamestate == GS_INTERMISSION)
-		MSG_WriteMarker(&cl->reliablebuf, svc_exitlevel);
-
-	G_DoReborn(*player);
-	SV_ClientFullUpdate(*player);
+	SV_JoinClient(*player, !step_mode);
 
 	SV_BroadcastPrintf(PRINT_HIGH, "%s has connected.\n", player->userinfo.netname.c_str());
 
-	// tell others clients about it
-	for (Players::iterator pit = players.begin(); pit != players.end(); ++pit)
-	{
-		MSG_WriteMarker(&pit->client.reliablebuf, svc_connectclient);
-		MSG_WriteByte(&pit->client.reliablebuf, player->id);
-	}
-
 	SV_MidPrint((char*)sv_motd.cstring(), player, 6);
 }
 
@@ -2136,6 +2257,9 @@ void SV_DisconnectClient(player_t &who)
 							who.userinfo.netname.c_str(), status.c_str());
 	}
 
+	if (SV_IsNetDemoRecorder(who))
+		SV_FinishNetDemo();
+
 	who.playerstate = PST_DISCONNECT;
 }
 
@@ -2171,6 +2295,7 @@ void SV_SendDisconnectSignal()
 			it->mo->Destroy();
 	}
 
+	SV_FinishNetDemo();
 	players.clear();
 }
 
@@ -2190,6 +2315,7 @@ void SV_SendReconnectSignal()
 			it->mo->Destroy();
 	}
 
+	SV_FinishNetDemo();
 	players.clear();
 }
 
@@ -3336,10 +3462,22 @@ void SV_WriteCommands(void)
 			}
 		}
 
-		// [SL] Send client info about player he is spying on
-		player_t *target = &idplayer(it->spying);
-		if (validplayer(*target) && &(*it) != target && P_CanSpy(*it, *target))
-			SV_SendPlayerStateUpdate(&(it->client), target);
+		if (SV_IsNetDemoRecorder(*it))
+		{
+			// [Odamex] netdemos can be viewed from any player's perspective
+			for (Players::iterator pit = players.begin();pit != players.end();++pit)
+			{
+				if (pit->ingame() && !pit->spectator)
+					SV_SendPlayerStateUpdate(cl, &*pit);
+			}
+		}
+		else
+		{
+			// [SL] Send client info about player he is spying on
+			player_t *target = &idplayer(it->spying);
+			if (validplayer(*target) && &(*it) != target && P_CanSpy(*it, *target))
+				SV_SendPlayerStateUpdate(&(it->client), target);
+		}
 
 		SV_UpdateHiddenMobj();
 
@@ -4539,6 +4677,7 @@ void SV_StepTics(QWORD count)
 
 		SV_WriteCommands();
 		SV_SendPackets();
+		SV_NetDemoTicker();
 		SV_ClearClientsBPS();
 		SV_CheckTimeouts();
 
@@ -4634,6 +4773,76 @@ void SV_RunTics()
 }
 
 
+//
+// SV_WaitForTics
+//
+// [Odamex] Sleeps until wake_time, waking whenever a packet arrives so that
+// client ticcmds are queued as soon as they are received rather than at the
+// start of the next tic. Tracks how much of the time the server spends idle,
+// how often it wakes and how late it wakes for each tic.
+//
+static dtime_t loop_stats_start = 0;
+static dtime_t loop_idle_time = 0;
+static unsigned int loop_wakeups = 0;
+static unsigned int loop_tics = 0;
+static dtime_t loop_jitter_total = 0;
+static dtime_t loop_jitter_max = 0;
+
+void SV_WaitForTics(dtime_t wake_time)
+{
+	dtime_t now = I_GetTime();
+	if (loop_stats_start == 0)
+		loop_stats_start = now;
+
+	while (now < wake_time)
+	{
+		bool packet_waiting = NET_WaitForPacket(wake_time - now);
+
+		dtime_t after = I_GetTime();
+		loop_idle_time += after - now;
+		loop_wakeups++;
+		now = after;
+
+		if (packet_waiting)
+		{
+			SV_GetPackets();
+			now = I_GetTime();
+		}
+	}
+
+	dtime_t jitter = now - wake_time;
+	loop_jitter_total += jitter;
+	loop_jitter_max = MAX(loop_jitter_max, jitter);
+	loop_tics++;
+}
+
+BEGIN_COMMAND(sv_loopstats)
+{
+	dtime_t elapsed = I_GetTime() - loop_stats_start;
+	if (loop_stats_start == 0 || elapsed == 0 || loop_tics == 0)
+	{
+		Printf(PRINT_HIGH, "No tics have been run yet.\n");
+		return;
+	}
+
+	double seconds = double(elapsed) / 1e9;
+	Printf(PRINT_HIGH, "Over the last %.1f seconds:\n", seconds);
+	Printf(PRINT_HIGH, "  idle:       %5.1f%%\n", 100.0 * double(loop_idle_time) / double(elapsed));
+	Printf(PRINT_HIGH, "  wakeups:    %5.1f/sec\n", double(loop_wakeups) / seconds);
+	Printf(PRINT_HIGH, "  tic jitter: %.3f ms avg, %.3f ms max\n",
+			double(loop_jitter_total) / double(loop_tics) / 1e6, double(loop_jitter_max) / 1e6);
+
+	// start a new sampling period
+	loop_stats_start = I_GetTime();
+	loop_idle_time = 0;
+	loop_wakeups = 0;
+	loop_tics = 0;
+	loop_jitter_total = 0;
+	loop_jitter_max = 0;
+}
+END_COMMAND(sv_loopstats)
+
+
 BEGIN_COMMAND(step)
 {
         QWORD newtics = argc > 1 ? atoi(argv[1]) : 1;
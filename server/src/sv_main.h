@@ -49,6 +49,8 @@ public:
 
 extern client_c clients;
 
+void SV_ForkInstances();
+int SV_GetInstanceNumber();
 void SV_InitNetwork (void);
 void SV_SendDisconnectSignal();
 void SV_SendReconnectSignal();
@@ -64,12 +66,15 @@ void STACK_ARGS SV_SpectatorPrintf (int level, const char *fmt, ...);
 void STACK_ARGS SV_PlayerPrintf (int level, int who, const char *fmt, ...);
 void SV_CheckTimeouts (void);
 void SV_ConnectClient(void);
+void SV_SendConsolePlayer(player_t &player);
+void SV_JoinClient(player_t &player, bool spectator);
 void SV_WriteCommands(void);
 void SV_ClearClientsBPS(void);
 bool SV_SendPacket(player_t &pl);
 void SV_AcknowledgePacket(player_t &player);
 void SV_DisplayTics();
 void SV_RunTics();
+void SV_WaitForTics(dtime_t wake_time);
 void SV_ParseCommands(player_t &player);
 short SV_FindClientByAddr(void);
 void SV_UpdateFrags (player_t &player);
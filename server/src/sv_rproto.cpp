@@ -29,6 +29,7 @@
 #include "doomstat.h"
 #include "p_local.h"
 #include "sv_main.h"
+#include "sv_demo.h"
 #include "huffman.h"
 #include "i_net.h"
 
@@ -107,6 +108,10 @@ bool SV_SendPacket(player_t &pl)
 		if (cl->netbuf.overflowed)
 			SZ_Clear(&cl->netbuf);
 
+	// [Odamex] the netdemo recorder's packets are written to the netdemo
+	if (SV_IsNetDemoRecorder(pl))
+		return SV_WriteNetDemoPacket(pl);
+
 	// [SL] 2012-05-04 - Don't send empty packets - they still have overhead
 	if (cl->reliablebuf.cursize + cl->netbuf.cursize == 0)
 		return true;
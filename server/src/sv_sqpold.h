@@ -26,6 +26,7 @@
 #ifndef __SV_SQPOLD_H__
 #define __SV_SQPOLD_H__
 
+void SV_WriteServerInfo(buf_t *buf);
 void SV_SendServerInfo ();
 bool SV_IsValidToken(DWORD token);
 
@@ -49,6 +49,8 @@ void RefreshPalettes (void) {}
 
 void V_RefreshColormaps() {}
 
+void V_InvalidateViewBlend() {}
+
 CVAR_FUNC_IMPL (sv_allowwidescreen) {}
 
 VERSION_CONTROL (sv_stubs_cpp, "$Id$")
@@ -25,6 +25,7 @@
 #include "d_player.h"
 #include "g_warmup.h"
 #include "sv_main.h"
+#include "sv_demo.h"
 #include "sv_maplist.h"
 #include "sv_pickup.h"
 #include "sv_vote.h"
@@ -862,6 +863,9 @@ bool Vote::init(const std::vector<std::string> &args, const player_t &player)
 		if (!sv_vote_specvote && it->spectator)
 			continue;
 
+		if (SV_IsNetDemoRecorder(*it))
+			continue;
+
 		if (it->id == this->caller_id)
 			this->tally[this->caller_id] = VOTE_YES;
 		else